@@ -1,8 +1,10 @@
 from __future__ import annotations
 
+import json
 from pathlib import Path
 import re
-from typing import Dict, List, Optional, Set, Tuple
+import struct
+from typing import Callable, Dict, List, Optional, Set, Tuple
 
 from result import Err, Ok, Result
 from armv8suite.data.cpu_state import CPU_State
@@ -124,6 +126,18 @@ class ParseErrors:
     class CPU_NZMem(ParseError):
         def __init__(self, msg: str):
             super().__init__(msg)
+
+    class BinHeader(ParseError):
+        def __init__(self, msg: str):
+            super().__init__(f"Invalid binary dump header: {msg}")
+
+    class BinRun(ParseError):
+        def __init__(self, offset: int, msg: str):
+            super().__init__(f"Invalid binary dump memory run at offset {offset}: {msg}")
+
+    class Json(ParseError):
+        def __init__(self, msg: str):
+            super().__init__(f"Invalid JSON dump: {msg}")
             
             
 def parse_PState(line: str, line_num: int) -> Result[PState, LineParseError]:
@@ -289,4 +303,122 @@ class Parser():
 def parse_out_file(actState: Path) -> Result[CPU_State, List[ParseError]]:
     p = Parser()
     return p.parse_out_file(actState)
-    
\ No newline at end of file
+
+
+# `emulate --dump-format=bin`: magic, version, X00..X30, PC, NZCV (with bit 31 set if a budget
+# ran out, which PState.from_bits() ignores), then memory runs of
+# (address, word count, words) until the end of the file. All values are little-endian.
+DUMP_BIN_MAGIC = b"A8SD"
+DUMP_BIN_VERSION = 1
+_BIN_HEADER = struct.Struct(f"<4sI{NUM_G_REGS}QQI")
+_BIN_RUN = struct.Struct("<II")
+_BIN_WORD = 4
+
+
+def parse_bin_file(actState: Path) -> Result[CPU_State, List[ParseError]]:
+    """Parses a binary state dump to a CPU_State object"""
+    data = actState.read_bytes()
+    if len(data) < _BIN_HEADER.size:
+        return Err([ParseErrors.BinHeader(f"{len(data)} bytes, expected {_BIN_HEADER.size}")])
+    magic, version, *values = _BIN_HEADER.unpack_from(data)
+    if magic != DUMP_BIN_MAGIC:
+        return Err([ParseErrors.BinHeader(f"magic {magic!r}, expected {DUMP_BIN_MAGIC!r}")])
+    if version != DUMP_BIN_VERSION:
+        return Err([ParseErrors.BinHeader(f"version {version}, expected {DUMP_BIN_VERSION}")])
+    *reg_values, pc, nzcv = values
+    regs: Dict[Reg, int] = {Reg(i): val for i, val in enumerate(reg_values)}
+    regs[Reg.PC] = pc
+
+    nzmem: Dict[int, int] = {}
+    errs: List[ParseError] = []
+    offset = _BIN_HEADER.size
+    while offset < len(data):
+        if offset + _BIN_RUN.size > len(data):
+            errs.append(ParseErrors.BinRun(offset, "truncated run header"))
+            break
+        addr, count = _BIN_RUN.unpack_from(data, offset)
+        start = offset + _BIN_RUN.size
+        end = start + count * _BIN_WORD
+        if end > len(data):
+            errs.append(ParseErrors.BinRun(offset, f"{count} words at 0x{addr:08x} are truncated"))
+            break
+        if addr % _BIN_WORD != 0:
+            errs.append(ParseErrors.BinRun(offset, f"address 0x{addr:08x} is not a multiple of 4"))
+        for i, (word,) in enumerate(struct.iter_unpack("<I", data[start:end])):
+            if addr + i * _BIN_WORD in nzmem:
+                errs.append(ParseErrors.BinRun(offset, f"duplicate address 0x{addr + i * _BIN_WORD:08x}"))
+            nzmem[addr + i * _BIN_WORD] = word
+        offset = end
+
+    if errs:
+        return Err(errs)
+    return Ok(CPU_State(regs, PState.from_bits(nzcv), nzmem))
+
+
+def _parse_json_hex(value: object, bitwidth: int) -> Optional[int]:
+    """Parses a hex string of at most `bitwidth` bits, None if invalid"""
+    if not isinstance(value, str):
+        return None
+    try:
+        x = int(value, 16)
+    except ValueError:
+        return None
+    return x if 0 <= x < 2**bitwidth else None
+
+
+def parse_json_file(actState: Path) -> Result[CPU_State, List[ParseError]]:
+    """Parses a JSON state dump to a CPU_State object"""
+    try:
+        dump = json.loads(actState.read_text())
+    except ValueError as e:
+        return Err([ParseErrors.Json(str(e))])
+    if not isinstance(dump, dict):
+        return Err([ParseErrors.Json("top level is not an object")])
+
+    def section(key: str) -> Dict[str, object]:
+        value = dump.get(key, {})
+        if not isinstance(value, dict):
+            errs.append(ParseErrors.Json(f"'{key}' is not an object"))
+            return {}
+        return value
+
+    errs: List[ParseError] = []
+    regs: Dict[Reg, int] = {}
+    for name, val in section("registers").items():
+        x = _parse_json_hex(val, 64)
+        if name not in Reg.__members__ or x is None:
+            errs.append(ParseErrors.Json(f"invalid register '{name}': {val!r}"))
+            continue
+        regs[Reg[name]] = x
+    if set(regs.keys()) != set(Reg):
+        errs.append(ParseErrors.CPURegs(set(regs.keys())))
+
+    flags = dump.get("pstate")
+    pstate: Optional[PState] = None
+    if not isinstance(flags, dict) or set(flags.keys()) != set("NZCV"):
+        errs.append(ParseErrors.CPU_PStateNotFound())
+    elif not all(isinstance(flag, bool) for flag in flags.values()):
+        errs.append(ParseErrors.Json(f"PState flags must be booleans: {flags}"))
+    else:
+        pstate = PState(flags["N"], flags["Z"], flags["C"], flags["V"])
+
+    nzmem: Dict[int, int] = {}
+    for addr_str, val in section("memory").items():
+        addr, x = _parse_json_hex(addr_str, 64), _parse_json_hex(val, 32)
+        if addr is None or x is None or addr % _BIN_WORD != 0:
+            errs.append(ParseErrors.Json(f"invalid memory entry '{addr_str}': {val!r}"))
+            continue
+        nzmem[addr] = x
+
+    if errs:
+        return Err(errs)
+    assert pstate is not None
+    return Ok(CPU_State(regs, pstate, nzmem))
+
+
+# Readers for each `emulate --dump-format`
+STATE_PARSERS: Dict[str, Callable[[Path], Result[CPU_State, List[ParseError]]]] = {
+    "text": parse_out_file,
+    "bin": parse_bin_file,
+    "json": parse_json_file,
+}
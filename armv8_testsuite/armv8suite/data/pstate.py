@@ -39,3 +39,8 @@ class PState:
         return PState(*(check_char(c, i) for i, c in enumerate("nzcv")))
 
 
+
+    @staticmethod
+    def from_bits(bits: int) -> PState:
+        """ Inverse of `_to_bits`, N in bit 3 down to V in bit 0 """
+        return PState(*(bool(bits >> shift & 1) for shift in (3, 2, 1, 0)))
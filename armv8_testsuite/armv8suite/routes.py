@@ -18,6 +18,7 @@ OUT_EMULATE_ALL = f'{OUT_JSON_DIR}/emulator_all.json'
 OUT_ALL = f'{OUT_JSON_DIR}/results.json'
 ASSEMBLER_PATH = './solution/assemble'
 EMULATOR_PATH = './solution/emulate'
+LIBRARY_PATH = './solution/libarmv8.so'
 
 
 OS_EXEC_FMT_ERRNO = 8
@@ -64,6 +65,8 @@ def parse_config(js: Path, ignore_assembler: bool, ignore_emulator: bool) -> Dic
         if not ignore_emulator and "emulator" in paths:
             res["emulator"] = paths["emulator"]
             ensure_executable(Path(res["emulator"]), "emulator")
+        if "library" in paths:
+            res["library"] = paths["library"]
             
     return res
 
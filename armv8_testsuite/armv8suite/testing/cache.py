@@ -0,0 +1,111 @@
+"""
+Content-hash cache of test results.
+
+Each assembler and emulator result is keyed on a hash of the test source, its
+expected results and the binaries under test. Tests whose key is unchanged
+since the last run are not run again, their result is read back from the
+test's result json instead.
+"""
+from __future__ import annotations
+
+import hashlib
+import json
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+from armv8suite.data.result import AssemblerResult, EmulatorResult, Test, TestResult, TestType
+from armv8suite.testing.config import RunnerConfig
+
+CACHE_FILE = "cache.json"
+
+
+def _digest_file(path: Optional[Path]) -> str:
+    if path is None or not path.exists():
+        return ""
+    h = hashlib.sha256()
+    with open(path, "rb") as f:
+        for block in iter(lambda: f.read(1 << 16), b""):
+            h.update(block)
+    return h.hexdigest()
+
+
+class ResultCache:
+    """Cache of the results of a test directory, stored in `actdir`"""
+
+    def __init__(self, cfg: RunnerConfig) -> None:
+        self._cfg = cfg
+        self._path: Path = cfg.actdir / CACHE_FILE
+        self._keys: Dict[str, Dict[str, str]] = {}
+        try:
+            with open(self._path, "r") as f:
+                self._keys = json.load(f)
+        except (OSError, ValueError):
+            self._keys = {}
+
+        # The binaries under test are hashed once per run, not once per test
+        native = _digest_file(cfg.library) if cfg.use_native else "process"
+        self._tools: Dict[TestType, str] = {
+            TestType.ASSEMBLER: _digest_file(cfg.assembler) + native,
+            TestType.EMULATOR: _digest_file(cfg.emulator) + native + cfg.dump_format,
+        }
+
+    def _key(self, test: Test, source: bytes, ttype: TestType) -> str:
+        h = hashlib.sha256()
+        h.update(ttype.value.encode())
+        h.update(self._tools[ttype].encode())
+        h.update(source)
+        h.update(_digest_file(test._exp_bin).encode())
+        if ttype is TestType.EMULATOR:
+            h.update(_digest_file(test._exp_out).encode())
+        return h.hexdigest()
+
+    def _needed(self, source: bytes) -> List[TestType]:
+        """Which results a run of the test produces"""
+        needed = []
+        if not self._cfg.emulator_only:
+            needed.append(TestType.ASSEMBLER)
+        is_runnable = b"RUNNABLE: False" not in source.split(b"\n", 1)[0]
+        if is_runnable and not self._cfg.assembler_only:
+            needed.append(TestType.EMULATOR)
+        return needed
+
+    def keys(self, test: Test) -> Dict[str, str]:
+        """The cache keys of the results a run of `test` produces"""
+        source = test._path.read_bytes()
+        return {
+            ttype.key_name(): self._key(test, source, ttype) for ttype in self._needed(source)
+        }
+
+    def lookup(
+        self, test: Test, keys: Dict[str, str]
+    ) -> Optional[Tuple[Optional[AssemblerResult], Optional[EmulatorResult]]]:
+        """Returns the cached results of `test`, or None if any of them is stale"""
+        cached = self._keys.get(test.name, {})
+        if any(cached.get(name) != key for name, key in keys.items()):
+            return None
+        # The outputs of the last run are kept alongside the results
+        if TestType.ASSEMBLER.key_name() in keys and not test._act_bin.exists():
+            return None
+        if TestType.EMULATOR.key_name() in keys and not test._act_out.exists():
+            return None
+        try:
+            with open(test._act_json, "r") as f:
+                js = json.load(f)
+            results: Dict[str, TestResult] = {
+                name: TestResult.from_dict_tp(js, test, TestType.from_str(name)) for name in keys
+            }
+        except Exception:
+            return None
+        return (
+            results.get(TestType.ASSEMBLER.key_name()),  # type: ignore
+            results.get(TestType.EMULATOR.key_name()),  # type: ignore
+        )
+
+    def store_keys(self, name: str, keys: Dict[str, str]) -> None:
+        """Record the keys of the results now stored in the result json of test `name`"""
+        self._keys[name] = keys
+
+    def save(self) -> None:
+        self._path.parent.mkdir(parents=True, exist_ok=True)
+        with open(self._path, "w") as f:
+            json.dump(self._keys, f, indent=4)
@@ -7,11 +7,13 @@ import subprocess
 import os
 import multiprocessing as mp
 from pathlib import Path
-from typing import List, Tuple
+from typing import Dict, List, Tuple
 import argparse
 
 # local
 import armv8suite.routes as routes
+from armv8suite.data.result import Test
+from armv8suite.testing.cache import ResultCache
 from armv8suite.testing.config import RunnerConfig
 from armv8suite.testing.output import JSONPrinter, PrettyPrinter
 from armv8suite.testing.runner import Runner, RunnerResult
@@ -138,6 +140,32 @@ def setup_params() -> argparse.ArgumentParser:
         help="path to arm toolchain bin folder",
     )
 
+    extra.add_argument(
+        "--native",
+        action=argparse.BooleanOptionalAction,
+        help="run the assembler and emulator in-process through libarmv8",
+        default=False,
+    )
+
+    extra.add_argument(
+        "--library",
+        help="path to libarmv8 shared library, used with --native",
+    )
+
+    extra.add_argument(
+        "--dump-format",
+        choices=["text", "bin", "json"],
+        help="format the emulator writes its final state in, read back with the matching parser",
+        default="text",
+    )
+
+    extra.add_argument(
+        "--cache",
+        action=argparse.BooleanOptionalAction,
+        help="reuse results of tests whose source, expected results and binaries are unchanged",
+        default=True,
+    )
+
     extra.add_argument(
         "--multi-threaded",
         action=argparse.BooleanOptionalAction,
@@ -248,6 +276,10 @@ def setup_config(args: argparse.Namespace) -> RunnerConfig:
         emulator_only=args.emulator_only,
         logfile=args.logfile,
         is_multi_threaded=args.multi_threaded,
+        library=args.library,
+        use_native=args.native,
+        use_cache=args.cache,
+        dump_format=args.dump_format,
     )
 
     if args.toolchain is not None:
@@ -323,41 +355,85 @@ def _run_tests_process(cfg: RunnerConfig) -> RunnerResult:
 
 def run_tests_multi_process_with_cfg(cfg: RunnerConfig) -> RunnerResult:
     try:
-        num_procs = max(
-            min(mp.cpu_count() - 1, len(cfg.test_files) // 25),
-            1
-        )
+        num_procs = mp.cpu_count()
     except NotImplementedError:
         num_procs = 1
 
-    test_chunks = [cfg.test_files[i::num_procs] for i in range(num_procs)]
+    # Small chunks are handed out as workers become free, so slow tests
+    # don't leave the rest of the pool idle.
+    chunk_size = max(len(cfg.test_files) // (num_procs * 4), 1)
+    test_chunks = [
+        cfg.test_files[i : i + chunk_size] for i in range(0, len(cfg.test_files), chunk_size)
+    ]
     cfgs = [
         cfg.copy().with_test_files(test_chunk).with_id(i)
         for i, test_chunk in enumerate(test_chunks)
     ]
 
-    with mp.Pool(num_procs) as pool:
-        results = pool.map(_run_tests_process, cfgs)
-
     asm_results, ems_results, excs_results = {}, {}, {}
-    for res in results:
-        asm_results.update(res.assembler)
-        ems_results.update(res.emulator)
-        excs_results.update(res.exceptions)
+    with mp.Pool(num_procs) as pool:
+        for res in pool.imap_unordered(_run_tests_process, cfgs):
+            asm_results.update(res.assembler)
+            ems_results.update(res.emulator)
+            excs_results.update(res.exceptions)
 
     results = RunnerResult(asm_results, ems_results, excs_results)
 
     return results
 
 
-def run_tests_with_cfg(cfg: RunnerConfig) -> RunnerResult:
-    if not cfg.is_multi_threaded or len(cfg.test_files) < 30:
+def run_uncached_tests_with_cfg(cfg: RunnerConfig) -> RunnerResult:
+    # Native runs emulate every test in one batch on all host threads, from a single process
+    if not cfg.is_multi_threaded or len(cfg.test_files) < 30 or cfg.use_native:
         cfg.is_multi_threaded = False
         return run_tests_single_process_with_cfg(cfg)
     else:
         return run_tests_multi_process_with_cfg(cfg)
 
 
+def run_tests_with_cfg(cfg: RunnerConfig) -> RunnerResult:
+    if not cfg.use_cache:
+        return run_uncached_tests_with_cfg(cfg)
+
+    cache = ResultCache(cfg)
+    asm_results, ems_results = {}, {}
+    stale_files, stale_keys = [], {}
+    for path in cfg.test_files:
+        test = Test(path, cfg.testdir, cfg.actdir, cfg.expdir)
+        keys = cache.keys(test)
+        cached = cache.lookup(test, keys)
+        if cached is None:
+            stale_files.append(path)
+            stale_keys[test.name] = keys
+            continue
+        asm_res, emu_res = cached
+        if asm_res is not None:
+            asm_results[test] = asm_res
+        if emu_res is not None:
+            ems_results[test] = emu_res
+
+    if len(stale_files) < len(cfg.test_files):
+        print(f"Reusing cached results of {len(cfg.test_files) - len(stale_files)} unchanged tests")
+
+    all_files = cfg.test_files
+    cfg.with_test_files(stale_files)
+    results = run_uncached_tests_with_cfg(cfg)
+    cfg.with_test_files(all_files)
+
+    # Only cache tests that produced all of their results
+    produced: Dict[str, int] = {}
+    for test in list(results.assembler.keys()) + list(results.emulator.keys()):
+        produced[test.name] = produced.get(test.name, 0) + 1
+    failed = {test.name for test in results.exceptions}
+    for name, keys in stale_keys.items():
+        if name not in failed and produced.get(name, 0) == len(keys):
+            cache.store_keys(name, keys)
+    cache.save()
+
+    asm_results.update(results.assembler)
+    ems_results.update(results.emulator)
+    return RunnerResult(asm_results, ems_results, results.exceptions)
+
 
 def run_and_write_tests_with_args_get_cfg(args: List[str]) -> Tuple[RunnerResult, RunnerConfig]:
     args_ = parse_args(args)
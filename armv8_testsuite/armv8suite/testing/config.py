@@ -24,6 +24,8 @@ class RunnerConfig:
         _outdir: Path to test output directory
         _assembler: Path to assembler to run
         _emulator: Path to emulator to run
+        _library: Path to libarmv8 shared library, used when running natively
+        _dump_format: `--dump-format` the emulator writes its final state in
         _toolchain_prefix: Prefix for toolchain binaries
         _verbose: Whether to print verbose output
         _assembler_only: Whether to only run the assembler
@@ -42,6 +44,10 @@ class RunnerConfig:
 
     assembler: Path
     emulator: Path
+    library: Optional[Path] = None
+    use_native: bool = False
+    use_cache: bool = True
+    dump_format: str = "text"
 
     verbose: bool = False
     assembler_only: bool = False
@@ -72,6 +78,10 @@ class RunnerConfig:
         is_run_all: bool = True,
         is_multi_threaded: bool = False,
         id: Optional[int] = None,
+        library: Optional[Path | str] = None,
+        use_native: bool = False,
+        use_cache: bool = True,
+        dump_format: str = "text",
     ) -> None:
         self.with_test_files(testfiles)
         self.verbose = verbose
@@ -93,6 +103,13 @@ class RunnerConfig:
             
         self.assembler = self.prep_exec(d, assembler, "assembler", is_used=not self.emulator_only)
         self.emulator = self.prep_exec(d, emulator, "emulator", is_used=not self.assembler_only)
+
+        self.use_native = use_native
+        self.use_cache = use_cache
+        self.dump_format = dump_format
+        if library is None:
+            library = d.get("library", routes.LIBRARY_PATH)
+        self.library = self._prep_path_like(library)
         
         self.is_run_all = is_run_all
         self.is_multi_threaded = is_multi_threaded
@@ -161,6 +178,10 @@ class RunnerConfig:
         self.expected_only = expected_only
         return self
 
+    def with_native(self, use_native: bool = True) -> RunnerConfig:
+        self.use_native = use_native
+        return self
+
     def with_actual_only(self, actual_only: bool = True) -> RunnerConfig:
         self.actual_only = actual_only
         return self
@@ -228,6 +249,8 @@ class RunnerConfig:
                 return Err(f"assembler {self.assembler} cannot be found")
             if not self.assembler_only and not self.emulator.exists():
                 return Err(f"emulator {self.emulator} cannot be found")
+            if self.use_native and not self.library.exists():
+                return Err(f"library {self.library} cannot be found")
         return Ok(None)
 
     def copy(self, include_test_files: bool = False) -> RunnerConfig:
@@ -248,4 +271,8 @@ class RunnerConfig:
             process_wait_time=self.process_wait_time,
             is_run_all=self.is_run_all,
             is_multi_threaded=self.is_multi_threaded,
+            library=self.library,
+            use_native=self.use_native,
+            use_cache=self.use_cache,
+            dump_format=self.dump_format,
         )
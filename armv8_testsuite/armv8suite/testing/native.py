@@ -0,0 +1,182 @@
+"""
+In-process assembler and emulator, using `libarmv8.so` built by `src/Makefile`.
+
+Running tests through the library avoids spawning a process per test and
+parsing the textual state dump, the emulator state is read directly instead.
+Emulations are run as one batch of guests interleaved on the host threads.
+"""
+from __future__ import annotations
+
+import ctypes as ct
+from pathlib import Path
+from typing import Dict, List, Union
+
+from armv8suite.data.cpu_state import CPU_State
+from armv8suite.data.pstate import PState
+from armv8suite.data.reg import NUM_G_REGS, Reg
+
+MEMORY_BLOCK = 4
+PAGE_SIZE = 4096
+_ZERO_PAGE = bytes(PAGE_SIZE)
+GUEST_SLICE = 10000  # instructions each guest runs before the next takes over
+# Instructions a guest may run per second of the test timeout, about what the emulator runs
+# on one host thread, so a program that never halts fails alone instead of hanging the batch
+GUEST_INSNS_PER_SECOND = 100_000_000
+ARMV8_ERROR_SIZE = 256
+
+# armv8_status
+ARMV8_HALTED = 0
+ARMV8_BUDGET = 1
+ARMV8_FAULT = 2
+
+
+class _Buffer(ct.Structure):
+    _fields_ = [
+        ("data", ct.POINTER(ct.c_ubyte)),
+        ("len", ct.c_size_t),
+        ("cap", ct.c_size_t),
+    ]
+
+
+class _PState(ct.Structure):
+    _fields_ = [
+        ("negative", ct.c_bool),
+        ("zero", ct.c_bool),
+        ("carry", ct.c_bool),
+        ("overflow", ct.c_bool),
+    ]
+
+
+class _Regs(ct.Structure):
+    _fields_ = [
+        ("regs", ct.c_ulonglong * NUM_G_REGS),
+        ("pc", ct.c_ulonglong),
+        ("pstate", _PState),
+    ]
+
+
+class Armv8Lib:
+    """Wrapper around the libarmv8 shared library"""
+
+    def __init__(self, path: Path) -> None:
+        lib = ct.CDLL(str(Path(path).resolve()))
+
+        lib.buffer_init.argtypes = [ct.c_size_t]
+        lib.buffer_init.restype = ct.POINTER(_Buffer)
+        lib.buffer_free.argtypes = [ct.POINTER(_Buffer)]
+        lib.buffer_free.restype = None
+        lib.armv8_assemble_checked.argtypes = [ct.c_char_p, ct.c_size_t, ct.POINTER(_Buffer)]
+        lib.armv8_assemble_checked.restype = ct.c_bool
+        lib.armv8_error.argtypes = []
+        lib.armv8_error.restype = ct.c_char_p
+
+        lib.armv8_emul_create.argtypes = []
+        lib.armv8_emul_create.restype = ct.c_void_p
+        lib.armv8_emul_load.argtypes = [ct.c_void_p, ct.c_char_p, ct.c_size_t]
+        lib.armv8_emul_load.restype = ct.c_bool
+        lib.armv8_emul_run.argtypes = [ct.c_void_p]
+        lib.armv8_emul_run.restype = ct.c_ulonglong
+        lib.armv8_emul_run_many.argtypes = [
+            ct.POINTER(ct.c_void_p),
+            ct.c_size_t,
+            ct.c_int,
+            ct.c_ulonglong,
+            ct.c_ulonglong,
+            ct.c_ulonglong,
+            ct.POINTER(ct.c_int),
+            ct.POINTER(ct.c_char * ARMV8_ERROR_SIZE),
+        ]
+        lib.armv8_emul_run_many.restype = ct.c_ulonglong
+        lib.armv8_emul_destroy.argtypes = [ct.c_void_p]
+        lib.armv8_emul_destroy.restype = None
+        lib.armv8_emul_get_regs.argtypes = [ct.c_void_p, ct.POINTER(_Regs)]
+        lib.armv8_emul_get_regs.restype = None
+        lib.armv8_emul_memory.argtypes = [ct.c_void_p, ct.POINTER(ct.c_size_t)]
+        lib.armv8_emul_memory.restype = ct.c_void_p
+
+        self._lib = lib
+
+    def assemble(self, source: bytes) -> bytes:
+        """Assemble `source`, returning the binary, or raising the error of invalid source"""
+        buf = self._lib.buffer_init(len(source) // MEMORY_BLOCK)
+        try:
+            if not self._lib.armv8_assemble_checked(source, len(source), buf):
+                raise ValueError(self._error())
+            return ct.string_at(buf.contents.data, buf.contents.len)
+        finally:
+            self._lib.buffer_free(buf)
+
+    def emulate(self, image: bytes) -> CPU_State:
+        """Run the binary `image` until it halts, returning the final state"""
+        emul = self._lib.armv8_emul_create()
+        try:
+            if not self._lib.armv8_emul_load(emul, image, len(image)):
+                raise ValueError("binary does not fit in emulator memory")
+            self._lib.armv8_emul_run(emul)
+            return self._read_state(emul)
+        finally:
+            self._lib.armv8_emul_destroy(emul)
+
+    def emulate_many(
+        self, images: List[bytes], threads: int = 1, timeout: float = 1
+    ) -> List[Union[CPU_State, Exception]]:
+        """
+        Run each binary in `images` until it halts, as guests interleaved on `threads` threads,
+        returning the final state of each, or the exception of a program that failed or did not
+        halt within the instructions it could run in `timeout` seconds
+        """
+        count = len(images)
+        max_insns = max(1, int(timeout * GUEST_INSNS_PER_SECOND))
+        emuls = (ct.c_void_p * count)()
+        status = (ct.c_int * count)()
+        messages = (ct.c_char * ARMV8_ERROR_SIZE * count)()
+        errors: Dict[int, Exception] = {}
+        try:
+            for i, image in enumerate(images):
+                emuls[i] = self._lib.armv8_emul_create()
+                if not self._lib.armv8_emul_load(emuls[i], image, len(image)):
+                    errors[i] = ValueError("binary does not fit in emulator memory")
+            self._lib.armv8_emul_run_many(
+                emuls, count, threads, GUEST_SLICE, 0, max_insns, status, messages
+            )
+            for i in range(count):
+                if i in errors or status[i] == ARMV8_HALTED:
+                    continue
+                if status[i] == ARMV8_BUDGET:
+                    errors[i] = TimeoutError(f"did not halt within {max_insns} instructions")
+                else:
+                    message = messages[i].value.decode(errors="replace").strip()
+                    errors[i] = RuntimeError(message or "unknown error")
+            return [errors[i] if i in errors else self._read_state(emuls[i]) for i in range(count)]
+        finally:
+            for emul in emuls:
+                if emul is not None:
+                    self._lib.armv8_emul_destroy(emul)
+
+    def _error(self) -> str:
+        """Message of the last error of a checked call on this thread"""
+        message = self._lib.armv8_error()
+        return message.decode(errors="replace").strip() if message else "unknown error"
+
+    def _read_state(self, emul: int) -> CPU_State:
+        regs = _Regs()
+        self._lib.armv8_emul_get_regs(emul, ct.byref(regs))
+        reg_values: Dict[Reg, int] = {Reg(i): regs.regs[i] for i in range(NUM_G_REGS)}
+        reg_values[Reg.PC] = regs.pc
+        pstate = PState(
+            regs.pstate.negative, regs.pstate.zero, regs.pstate.carry, regs.pstate.overflow
+        )
+
+        size = ct.c_size_t()
+        memory = ct.string_at(self._lib.armv8_emul_memory(emul, ct.byref(size)), size.value)
+        nz_mem: Dict[int, int] = {}
+        # Only visit words in non-zero pages, rather than every word of memory
+        for page in range(0, len(memory), PAGE_SIZE):
+            if memory[page : page + PAGE_SIZE] == _ZERO_PAGE:
+                continue
+            for addr in range(page, min(page + PAGE_SIZE, len(memory)), MEMORY_BLOCK):
+                word = int.from_bytes(memory[addr : addr + MEMORY_BLOCK], "little")
+                if word != 0:
+                    nz_mem[addr] = word
+
+        return CPU_State(reg_values, pstate, nz_mem)
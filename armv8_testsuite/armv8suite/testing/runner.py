@@ -1,5 +1,6 @@
 from __future__ import annotations
 from functools import reduce
+import os
 from pathlib import Path
 import textwrap
 import traceback
@@ -24,6 +25,7 @@ from armv8suite.data.result import (
     write_process_state,
 )
 from armv8suite.testing.config import RunnerConfig
+from armv8suite.testing.native import Armv8Lib
 from armv8suite.testing.setup import STUDENT_MODE
 from armv8suite.utils import is_defined
 from armv8suite.utils.writer import StringWriter
@@ -120,6 +122,13 @@ class Runner:
         self._emulator_results: Dict[Test, EmulatorResult] = {}
         self._exceptions: Dict[Test, Exception] = {}
 
+        # Loaded per runner, since each process needs its own library handle
+        self._native: Optional[Armv8Lib] = None
+        if self._cfg.use_native:
+            self._native = Armv8Lib(self._cfg.library)
+        # Emulator tests run natively, with their expected states, see _run_native_emulator_batch
+        self._native_batch: List[Tuple[Test, CPU_State]] = []
+
         if self._cfg.is_multi_threaded:
             self._log_buffer: List[Tuple[tuple, Dict[str, Any]]] = []
 
@@ -258,6 +267,9 @@ class Runner:
             self._log("Skipping Assembler")
             return res.with_result(ResultType.CORRECT)
 
+        if self._native is not None:
+            return self._run_native_assembler_test(test, res, self._native)
+
         cmd = [f"./{self._cfg.assembler}", test._path, test._act_bin]
         if not STUDENT_MODE and self._cfg.verbose:
             cmd.append("-v")
@@ -278,6 +290,28 @@ class Runner:
         self._log_test_result(res)
         return res
 
+    def _run_native_assembler_test(
+        self, test: Test, res: AssemblerResult, native: Armv8Lib
+    ) -> AssemblerResult:
+        """Run the assembler in-process on test file `t`"""
+        self._log(f"run native: assemble {test._path}")
+        try:
+            test._act_bin.write_bytes(native.assemble(test._path.read_bytes()))
+            self._run_listing(test._act_lst, test._act_bin)
+            diffs = AssemblerDiffs.compare_raw_bin(test._exp_bin, test._act_bin)
+            if diffs:
+                res.save_diffs(diffs)
+                res = res.with_result(ResultType.INCORRECT)
+            else:
+                res = res.with_result(ResultType.CORRECT)
+        except Exception as e:
+            self._log_exception(e)
+            res.with_log_exception(e).with_result(ResultType.FAILED)
+
+        self._log_outcome("ASSEMBLER", res.result, test, is_bad=res.result.is_err())
+        self._log_test_result(res)
+        return res
+
     def _prepare_emulator_test(
         self, test: Test
     ) -> Result[CPU_State, Optional[List[ParseError]]]:
@@ -311,7 +345,7 @@ class Runner:
             return res.with_result(ResultType.FAILED)
 
         # Keeping Result changes local to this file
-        parsed_out_state = parsing.parse_out_file(test._act_out)
+        parsed_out_state = parsing.STATE_PARSERS[self._cfg.dump_format](test._act_out)
         if parsed_out_state.is_err():
             errs: List[ParseError] = typing.cast(List[ParseError], parsed_out_state.err())
             
@@ -364,6 +398,8 @@ class Runner:
         bin_to_run = test._exp_bin if use_exp_bin else test._act_bin
 
         cmd = [f"./{self._cfg.emulator}", bin_to_run, test._act_out]
+        if self._cfg.dump_format != "text":
+            cmd.insert(1, f"--dump-format={self._cfg.dump_format}")
         self._log(f'run: {reduce(lambda x, y: f"{x} {y}", cmd, "")}')
 
         with sp.Popen(cmd, stdout=sp.PIPE, stderr=sp.PIPE) as p:
@@ -380,6 +416,35 @@ class Runner:
         self._log_test_result(res)
         return res
 
+    def _run_native_emulator_batch(self, native: Armv8Lib):
+        """Run the queued emulator tests in-process, as one batch of guests on all host threads."""
+        self._log(f"run native: emulate {len(self._native_batch)} tests")
+        images = [test._exp_bin.read_bytes() for test, _ in self._native_batch]
+        out_states = native.emulate_many(
+            images, os.cpu_count() or 1, self._cfg.process_wait_time
+        )
+        for (test, exp_state), out_state in zip(self._native_batch, out_states):
+            res = EmulatorResult(test)
+            try:
+                if isinstance(out_state, Exception):
+                    raise out_state
+                out_state.dump(test._act_out)
+                differences = exp_state.compare(out_state)
+                if differences:
+                    res.save_diffs(differences)
+                    res = res.with_result(ResultType.INCORRECT)
+                else:
+                    res = res.with_result(ResultType.CORRECT)
+            except Exception as e:
+                self._log(f"Exception in test {test}: {e}")
+                res.with_log_exception(e).with_result(ResultType.FAILED)
+
+            self._log_outcome("EMULATOR", res.result, test, is_bad=res.result.is_err())
+            self._log_test_result(res)
+            self._emulator_results[test] = res
+            res.write_to_json(test._act_json)
+        self._native_batch = []
+
     def _run_test(self, test: Test):
         """Runs expected/actual assembly and emulation tests for a single test in assembly file `t`"""
         self._log(f"Running test {test}")
@@ -405,6 +470,9 @@ class Runner:
             self._log_outcome("PREPARE EMULATOR", ResultType.FAILED, test)
             return
 
+        elif self._native is not None and not self._cfg.expected_only:
+            self._native_batch.append((test, exp_state.ok()))
+
         elif not self._cfg.assembler_only:
             assert isinstance(exp_state, Ok)
             em_res = self._run_emulator_test(test, exp_state.ok(), use_exp_bin=True)
@@ -428,6 +496,8 @@ class Runner:
                 )
             if self._cfg.is_multi_threaded:
                 self._flush_log_buffer()
+        if self._native is not None and self._native_batch:
+            self._run_native_emulator_batch(self._native)
         return RunnerResult(
             self._assembler_results, self._emulator_results, self._exceptions
         )
@@ -0,0 +1,19 @@
+movz x1, #0x1000
+movz x2, #7
+str x2, [x1]
+movz x3, #7
+movz x4, #9
+cas x3, x4, [x1]
+ldr x5, [x1]
+movz x6, #7
+movz x7, #11
+casa x6, x7, [x1]
+ldr x8, [x1]
+movz w9, #9
+movz w10, #12
+casl w9, w10, [x1]
+movz w11, #12
+movz w12, #13
+casal w11, w12, [x1]
+ldr x13, [x1]
+and x0, x0, x0
@@ -0,0 +1,18 @@
+movz x1, #0x1000
+movz x2, #100
+str x2, [x1]
+movz x3, #5
+ldadd x3, x4, [x1]
+ldadda x3, x5, [x1]
+ldaddl x3, x6, [x1]
+ldaddal x3, x7, [x1]
+ldr x8, [x1]
+movn w9, #0
+str w9, [x1, #8]
+movz w10, #2
+add x14, x1, #8
+ldadd w10, w11, [x14]
+ldr x12, [x1, #8]
+ldadd x3, xzr, [x1]
+ldr x13, [x1]
+and x0, x0, x0
@@ -0,0 +1,12 @@
+movz x1, #0x1000
+movz x2, #40
+str x2, [x1]
+ldxr x3, [x1]
+add x3, x3, #2
+stxr w4, x3, [x1]
+stxr w5, x3, [x1]
+ldaxr w6, [x1]
+add w6, w6, #1
+stlxr w7, w6, [x1]
+ldr x8, [x1]
+and x0, x0, x0
@@ -0,0 +1,12 @@
+movz x0, #5
+bl double
+add x1, x0, #0
+add x2, x30, #0
+bl double
+bl double
+b end
+double:
+add x0, x0, x0
+ret
+end:
+and x0, x0, x0
@@ -0,0 +1,17 @@
+movz x5, #24
+movz x1, #1
+blr x5
+add x2, x30, #0
+movz x5, #32
+b end
+add x1, x1, #7
+ret x30
+add x1, x1, #100
+ret
+end:
+blr x5
+add x3, x1, #0
+movz x30, #60
+blr x30
+movz x4, #99
+and x0, x0, x0
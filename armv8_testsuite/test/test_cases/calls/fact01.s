@@ -0,0 +1,24 @@
+movz x0, #6
+bl fact
+add x1, x0, #0
+add x2, sp, #0
+b end
+fact:
+stp x29, x30, [sp, #-32]!
+add x29, sp, #0
+str x19, [sp, #16]
+add x19, x0, #0
+subs xzr, x0, #1
+b.le base
+sub x0, x0, #1
+bl fact
+mul x0, x0, x19
+b done
+base:
+movz x0, #1
+done:
+ldr x19, [sp, #16]
+ldp x29, x30, [sp], #32
+ret
+end:
+and x0, x0, x0
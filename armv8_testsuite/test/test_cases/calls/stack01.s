@@ -0,0 +1,11 @@
+add x9, sp, #0
+sub sp, sp, #16
+movz x1, #0x1234
+str x1, [sp, #8]
+ldr x2, [sp, #8]
+add x3, sp, #0
+stp x1, x2, [sp, #-16]!
+ldp x4, x5, [sp], #16
+add sp, sp, #16
+add x6, sp, #0
+and x0, x0, x0
@@ -0,0 +1,20 @@
+movz x1, #0x1000
+movz x2, #0x41
+strb w2, [x1], #1
+add w2, w2, #1
+strb w2, [x1], #1
+add w2, w2, #1
+strh w2, [x1], #2
+movz x3, #0x4443
+str w3, [x1, #4]!
+ldrb w4, [x1, #-6]!
+ldrh w5, [x1], #-2
+ldr w6, [x1], #8
+movz x7, #0x1008
+movz x8, #0x5566
+movk x8, #0x7788, lsl #48
+str x8, [x7, #8]!
+ldr x9, [x7], #-8
+ldrsb x10, [x7, #15]!
+ldrsh w11, [x7], #-7
+and x0, x0, x0
@@ -0,0 +1,18 @@
+movz x1, #0x1000
+movz x2, #0x8281
+movk x2, #0x8483, lsl #16
+movk x2, #0xf0f1, lsl #32
+movk x2, #0x7f80, lsl #48
+str x2, [x1]
+movn x3, #0
+movn x4, #0
+movn x5, #0
+movn x6, #0
+movn x7, #0
+ldrb w3, [x1]
+ldrb w4, [x1, #7]
+ldrh w5, [x1, #2]
+ldrh w6, [x1, #6]
+ldr w7, [x1, #4]
+ldr x8, [x1]
+and x0, x0, x0
@@ -0,0 +1,16 @@
+movz x1, #0x1000
+movz x2, #0x8281
+movk x2, #0x8483, lsl #16
+movk x2, #0xf0f1, lsl #32
+movk x2, #0x7f80, lsl #48
+str x2, [x1]
+ldrsb x10, [x1]
+ldrsb w11, [x1]
+ldrsb x12, [x1, #7]
+ldrsb w13, [x1, #6]
+ldrsh x14, [x1, #2]
+ldrsh w15, [x1, #2]
+ldrsh x16, [x1, #6]
+ldrsw x17, [x1]
+ldrsw x18, [x1, #4]
+and x0, x0, x0
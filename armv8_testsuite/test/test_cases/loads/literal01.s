@@ -0,0 +1,15 @@
+ldr x1, val64
+ldr w2, val64
+ldrsw x3, neg32
+ldr w4, neg32
+ldrsw x5, pos32
+b end
+val64:
+    .int 0x89abcdef
+    .int 0x01234567
+neg32:
+    .int 0x80000001
+pos32:
+    .int 0x7ffffffe
+end:
+and x0, x0, x0
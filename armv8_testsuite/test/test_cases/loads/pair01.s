@@ -0,0 +1,21 @@
+movz x1, #0x1000
+movz x2, #0x1111
+movz x3, #0x2222
+movk x3, #0x8000, lsl #48
+stp x2, x3, [x1]
+stp w3, w2, [x1, #16]
+ldp x4, x5, [x1]
+ldp w6, w7, [x1, #16]
+movz x8, #0x1040
+stp x2, x3, [x8, #-16]!
+add x9, x8, #0
+stp w2, w3, [x8], #32
+ldp x10, x11, [x9], #-16
+movz w12, #0xfffe
+movk w12, #0xffff, lsl #16
+stp w12, w2, [x1, #32]
+ldpsw x13, x14, [x1, #32]
+movz x15, #0x1028
+ldpsw x16, x17, [x15, #8]!
+ldp x18, x19, [x1, #-8]
+and x0, x0, x0
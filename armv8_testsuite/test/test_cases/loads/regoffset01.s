@@ -0,0 +1,31 @@
+movz x1, #0x1000
+movz x2, #0x1111
+movk x2, #0x2222, lsl #16
+movk x2, #0x3333, lsl #32
+movk x2, #0x8444, lsl #48
+str x2, [x1, #16]
+movz x3, #16
+ldr x4, [x1, x3]
+movz x5, #2
+ldr x6, [x1, x5, lsl #3]
+movz w7, #4
+ldr w8, [x1, w7, uxtw #2]
+movn w9, #0
+movz x10, #0x1011
+ldrb w11, [x10, w9, sxtw]
+movn x12, #1
+movz x13, #0x1018
+ldrsh x14, [x13, x12, sxtx #1]
+movz x15, #9
+ldrh w16, [x1, x15, lsl #1]
+movz w17, #7
+strb w2, [x1, w17, uxtw]
+strh w2, [x1, x5, lsl #1]
+str w2, [x1, x5]
+ldr x18, [x1]
+movz x19, #8
+str x2, [x1, x19, lsl #0]
+movz x22, #12
+ldrsw x20, [x1, x22]
+ldr x21, [x1, x19]
+and x0, x0, x0
@@ -0,0 +1,15 @@
+movz x1, #0x1000
+movn x2, #0
+str x2, [x1]
+movz x3, #0x1234
+movk x3, #0x5678, lsl #16
+strb w3, [x1]
+strh w3, [x1, #2]
+str w3, [x1, #4]
+str x3, [x1, #8]
+strb w3, [x1, #17]
+strh w3, [x1, #22]
+ldr x4, [x1]
+ldr x5, [x1, #8]
+ldr x6, [x1, #16]
+and x0, x0, x0
@@ -0,0 +1,23 @@
+movz x1, #0x1010
+movz x2, #0xa1a2
+movk x2, #0xb1b2, lsl #16
+movk x2, #0xc1c2, lsl #32
+movk x2, #0xd1d2, lsl #48
+stur x2, [x1, #-16]
+stur w2, [x1, #-5]
+sturh w2, [x1, #-1]
+sturb w2, [x1, #9]
+ldur x3, [x1, #-16]
+ldur w4, [x1, #-13]
+ldurb w5, [x1, #-10]
+ldurh w6, [x1, #-11]
+ldursb x7, [x1, #-9]
+ldursh w8, [x1, #-15]
+ldursw x9, [x1, #-12]
+ldr x10, [x1, #-8]
+ldr x11, [x1, #-3]
+ldr w12, [x1, #-1]
+ldrh w13, [x1, #9]
+str x2, [x1, #1]
+ldr x14, [x1, #1]
+and x0, x0, x0
@@ -0,0 +1,16 @@
+movz x1, #0x10
+movz x2, #0x1000
+movz x3, #0x9988
+str w3, [x2]
+ldr w4, [x1], #-256
+add x12, x1, #0
+ldrb w5, [x1, #0x100]
+strh w3, [x1, #0x1020]
+add x6, x2, #0
+ldr w7, [x6, #-8]!
+movz x8, #0x1010
+strh w3, [x8], #-32
+ldrsh x9, [x8, #0x20]!
+ldr w10, [x2], #4
+ldr w11, [x1, #0xf0]!
+and x0, x0, x0
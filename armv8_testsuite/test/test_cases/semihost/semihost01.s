@@ -0,0 +1,25 @@
+movz x1, #0x1000
+movz w0, #0x30
+hlt #0xf000
+ldr x2, [x1]
+movz x3, #1
+str x3, [x1]
+movz w0, #0x09
+hlt #0xf000
+add x4, x0, #0
+movz x3, #7
+str x3, [x1]
+movz w0, #0x09
+hlt #0xf000
+add x5, x0, #0
+movz w0, #0x31
+hlt #0xf000
+add x6, x0, #0
+movz x3, #0x0026
+movk x3, #0x2, lsl #16
+str x3, [x1]
+str xzr, [x1, #8]
+movz w0, #0x20
+hlt #0xf000
+movz x7, #1
+and x0, x0, x0
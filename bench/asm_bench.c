@@ -0,0 +1,187 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/resource.h>
+#include "assembler.h"
+
+#define DEFAULT_RUNS 3
+
+// Allocation counters, fed by the malloc family wrappers below. The binary is
+// linked with --wrap so that every allocation made by the assembler goes
+// through them. Atomic since parallel assembly allocates from several threads.
+static atomic_ulong allocs;
+static atomic_ulong live_bytes;
+static atomic_ulong peak_bytes;
+
+extern void *__real_malloc(size_t size);
+extern void *__real_calloc(size_t count, size_t size);
+extern void *__real_realloc(void *ptr, size_t size);
+extern void __real_free(void *ptr);
+
+static void track(void *ptr, size_t old_size)
+{
+  ulong live = atomic_fetch_add(&live_bytes, malloc_usable_size(ptr) - old_size);
+  live += malloc_usable_size(ptr) - old_size;
+  ulong peak = atomic_load(&peak_bytes);
+  while (live > peak && !atomic_compare_exchange_weak(&peak_bytes, &peak, live))
+    ;
+}
+
+void *__wrap_malloc(size_t size)
+{
+  void *ptr = __real_malloc(size);
+  atomic_fetch_add(&allocs, 1);
+  track(ptr, 0);
+  return ptr;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+  void *ptr = __real_calloc(count, size);
+  atomic_fetch_add(&allocs, 1);
+  track(ptr, 0);
+  return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+  size_t old_size = malloc_usable_size(ptr);
+  ptr = __real_realloc(ptr, size);
+  atomic_fetch_add(&allocs, 1);
+  track(ptr, old_size);
+  return ptr;
+}
+
+void __wrap_free(void *ptr)
+{
+  atomic_fetch_sub(&live_bytes, malloc_usable_size(ptr));
+  __real_free(ptr);
+}
+
+// Reads a whole file into a heap allocated string, storing its length in `length`.
+static char *read_file(const char *filename, long *length)
+{
+  FILE *file = fopen(filename, "rb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Error: Could not open file %s\n", filename);
+    exit(1);
+  }
+  fseek(file, 0, SEEK_END);
+  *length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char *source = malloc(*length + 1);
+  if (fread(source, 1, *length, file) != *length)
+  {
+    fprintf(stderr, "Error: Could not read file %s\n", filename);
+    exit(1);
+  }
+  source[*length] = '\0';
+  fclose(file);
+  return source;
+}
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+  int runs = DEFAULT_RUNS;
+  int num_threads = 1;
+  const char *out_path = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "r:j:o:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'r':
+      runs = atoi(optarg);
+      break;
+    case 'j':
+      num_threads = atoi(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      runs = 0;
+    }
+  }
+  if (runs < 1 || num_threads < 1 || optind != argc - 1)
+  {
+    fprintf(stderr, "Usage: %s [-r runs] [-j threads] [-o <file out>] <file in>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  long length;
+  char *source = read_file(argv[optind], &length);
+  long lines = 0;
+  for (long i = 0; i < length; i++)
+  {
+    lines += source[i] == '\n';
+  }
+
+  // Only the assembler is measured: the counters are reset after reading the
+  // source, and the output buffer is preallocated to the size of the binary.
+  size_t code_size = 0;
+  ulong run_allocs = 0;
+  ulong run_peak = 0;
+  double best_ns = 0, total_ns = 0;
+  for (int i = 0; i < runs; i++)
+  {
+    buffer_t out = buffer_init(code_size);
+    atomic_store(&allocs, 0);
+    atomic_store(&peak_bytes, atomic_load(&live_bytes));
+    ulong base_bytes = atomic_load(&live_bytes);
+
+    double start = now_ns();
+    if (num_threads > 1)
+      parallel_assemble(source, length, out, num_threads);
+    else
+      assemble_source(source, length, out);
+    double elapsed = now_ns() - start;
+
+    run_allocs = atomic_load(&allocs);
+    run_peak = atomic_load(&peak_bytes) - base_bytes;
+    code_size = out->len;
+    total_ns += elapsed;
+    if (i == 0 || elapsed < best_ns)
+      best_ns = elapsed;
+    buffer_free(out);
+  }
+  free(source);
+
+  // ru_maxrss is in kilobytes on Linux
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  FILE *out = stdout;
+  if (out_path != NULL)
+  {
+    out = fopen(out_path, "w");
+    if (out == NULL)
+    {
+      fprintf(stderr, "Error: Could not open file %s\n", out_path);
+      return EXIT_FAILURE;
+    }
+  }
+  fprintf(out, "{\n  \"source\": \"%s\",\n  \"runs\": %d,\n  \"threads\": %d,\n", argv[optind], runs, num_threads);
+  fprintf(out, "  \"lines\": %ld,\n  \"source_bytes\": %ld,\n  \"code_bytes\": %zu,\n", lines, length, code_size);
+  fprintf(out, "  \"best_ns\": %.0f,\n  \"mean_ns\": %.0f,\n  \"lines_per_sec\": %.0f,\n",
+          best_ns, total_ns / runs, lines / (best_ns / 1e9));
+  fprintf(out, "  \"allocs\": %lu,\n  \"allocs_per_line\": %.2f,\n", run_allocs, (double)run_allocs / lines);
+  fprintf(out, "  \"peak_heap_bytes\": %lu,\n  \"peak_rss_kb\": %ld\n}\n", run_peak, usage.ru_maxrss);
+  if (out != stdout)
+    fclose(out);
+  return EXIT_SUCCESS;
+}
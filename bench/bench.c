@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "armv8.h"
+
+#define DEFAULT_RUNS 5
+#define GUEST_SLICE 10000 // instructions per time slice with several guests
+
+// Timing results for a single workload
+typedef struct
+{
+  const char *name;
+  size_t code_size;
+  ullong insns;
+  double best_ns;
+  double mean_ns;
+} bench_result;
+
+// Reads a whole file into a heap allocated string, storing its length in `length`.
+static char *read_file(const char *filename, long *length)
+{
+  FILE *file = fopen(filename, "rb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Error: Could not open file %s\n", filename);
+    exit(1);
+  }
+  fseek(file, 0, SEEK_END);
+  *length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char *source = malloc(*length + 1);
+  if (fread(source, 1, *length, file) != *length)
+  {
+    fprintf(stderr, "Error: Could not read file %s\n", filename);
+    exit(1);
+  }
+  source[*length] = '\0';
+  fclose(file);
+  return source;
+}
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Strips the directory and extension from a workload path.
+static const char *workload_name(const char *path)
+{
+  const char *slash = strrchr(path, '/');
+  const char *base = slash == NULL ? path : slash + 1;
+  size_t len = strcspn(base, ".");
+  char *name = malloc(len + 1);
+  memcpy(name, base, len);
+  name[len] = '\0';
+  return name;
+}
+
+// Runs `guests` copies of an image interleaved on `threads` threads, returning the
+// instructions of all of them.
+static ullong run_guests(armv8_emul *emuls, int guests, int threads)
+{
+  armv8_status *status = malloc(guests * sizeof(armv8_status));
+  char (*errors)[ARMV8_ERROR_SIZE] = malloc(guests * sizeof(*errors));
+  ullong insns = armv8_emul_run_many(emuls, guests, threads, GUEST_SLICE, 0, 0, status, errors);
+  for (int g = 0; g < guests; g++)
+  {
+    if (status[g] != ARMV8_HALTED)
+    {
+      fprintf(stderr, "Error: Guest %d failed: %s", g, errors[g]);
+      exit(1);
+    }
+  }
+  free(errors);
+  free(status);
+  return insns;
+}
+
+// Assembles a workload once, then times `runs` emulations of it, each of `guests` copies of
+// the program, or of one copy on `cores` cores sharing memory, a host thread each. Only the
+// emulation loop is timed, so creating and loading the emulators is excluded.
+static bench_result run_workload(const char *path, int runs, int guests, int threads, int cores)
+{
+  bench_result result = {.name = workload_name(path)};
+
+  long length;
+  char *source = read_file(path, &length);
+  buffer_t image = buffer_init(length);
+  result.code_size = armv8_assemble(source, length, image);
+  free(source);
+
+  double total_ns = 0;
+  for (int i = 0; i < runs; i++)
+  {
+    int count = cores > 1 ? cores : guests;
+    armv8_emul *emuls = malloc(count * sizeof(armv8_emul));
+    for (int g = 0; g < count; g++)
+    {
+      if (cores > 1 && g > 0)
+      {
+        emuls[g] = armv8_emul_create_core(emuls[0], g);
+        continue;
+      }
+      emuls[g] = armv8_emul_create();
+      if (!armv8_emul_load(emuls[g], image->data, image->len))
+      {
+        fprintf(stderr, "Error: Workload %s does not fit in memory\n", path);
+        exit(1);
+      }
+    }
+
+    double start = now_ns();
+    ullong insns = count == 1 ? armv8_emul_run(emuls[0])
+                              : run_guests(emuls, count, cores > 1 ? cores : threads);
+    double elapsed = now_ns() - start;
+
+    // Every run must execute the same program, otherwise the timings are meaningless.
+    if (i > 0 && insns != result.insns)
+    {
+      fprintf(stderr, "Error: Workload %s is not deterministic\n", path);
+      exit(1);
+    }
+    result.insns = insns;
+    total_ns += elapsed;
+    if (i == 0 || elapsed < result.best_ns)
+      result.best_ns = elapsed;
+    // The first core is destroyed last, with the memory of the others
+    for (int g = count - 1; g >= 0; g--)
+    {
+      armv8_emul_destroy(emuls[g]);
+    }
+    free(emuls);
+  }
+  result.mean_ns = total_ns / runs;
+
+  buffer_free(image);
+  return result;
+}
+
+static void print_result(FILE *out, bench_result *result, bool last)
+{
+  // Guest MIPS and host ns per guest instruction are both derived from the best run.
+  double mips = result->insns / (result->best_ns / 1e3);
+  double ns_per_insn = result->best_ns / result->insns;
+  fprintf(out, "    {\"name\": \"%s\", \"code_bytes\": %zu, \"guest_insns\": %llu, "
+               "\"best_ns\": %.0f, \"mean_ns\": %.0f, \"mips\": %.2f, \"ns_per_insn\": %.3f}%s\n",
+          result->name, result->code_size, result->insns,
+          result->best_ns, result->mean_ns, mips, ns_per_insn, last ? "" : ",");
+}
+
+int main(int argc, char **argv)
+{
+  int runs = DEFAULT_RUNS;
+  int guests = 1;
+  int threads = 1;
+  int cores = 1;
+  const char *out_path = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "r:o:g:j:c:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'r':
+      runs = atoi(optarg);
+      break;
+    case 'g':
+      guests = atoi(optarg);
+      break;
+    case 'j':
+      threads = atoi(optarg);
+      break;
+    case 'c':
+      cores = atoi(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      runs = 0;
+    }
+  }
+  if (runs < 1 || guests < 1 || cores < 1 || (guests > 1 && cores > 1) || optind >= argc)
+  {
+    fprintf(stderr, "Usage: %s [-r runs] [-g guests [-j threads] | -c cores] [-o <file out>] <workload.s>...\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  FILE *out = stdout;
+  if (out_path != NULL)
+  {
+    out = fopen(out_path, "w");
+    if (out == NULL)
+    {
+      fprintf(stderr, "Error: Could not open file %s\n", out_path);
+      return EXIT_FAILURE;
+    }
+  }
+
+  int count = argc - optind;
+  bench_result *results = malloc(count * sizeof(bench_result));
+  for (int i = 0; i < count; i++)
+  {
+    results[i] = run_workload(argv[optind + i], runs, guests, threads, cores);
+  }
+
+  // ru_maxrss is in kilobytes on Linux
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  fprintf(out, "{\n  \"runs\": %d,\n  \"guests\": %d,\n  \"threads\": %d,\n  \"cores\": %d,\n  \"peak_rss_kb\": %ld,\n  \"workloads\": [\n",
+          runs, guests, threads, cores, usage.ru_maxrss);
+  for (int i = 0; i < count; i++)
+  {
+    print_result(out, &results[i], i == count - 1);
+    free((char *)results[i].name);
+  }
+  fprintf(out, "  ]\n}\n");
+
+  free(results);
+  if (out != stdout)
+    fclose(out);
+  return EXIT_SUCCESS;
+}
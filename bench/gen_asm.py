@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+"""
+Generates large, valid assembly sources for benchmarking the assembler.
+
+Every mnemonic accepted by src/assembler.c is emitted (the data processing,
+alias, branching, single data transfer, conditional, SIMD/FP, atomic, system and
+`.int` tables),
+with a controllable label density and mix of forward and backward references.
+"""
+
+import argparse
+import bisect
+import random
+import sys
+
+# Conditional branches and load literals have a 19-bit word offset, so label
+# references are kept within this many lines of the instruction using them.
+REFERENCE_WINDOW = 4096
+
+CONDS = ["eq", "ne", "ge", "lt", "gt", "le", "al"]
+SHIFTS = ["lsl", "lsr", "asr"]
+BARRIERS = ["oshld", "oshst", "osh", "nshld", "nshst", "nsh", "ishld", "ishst", "ish", "ld", "st", "sy"]
+
+
+def reg(rng, sf, zr=False):
+    n = rng.randrange(32 if zr else 31)
+    if n == 31:
+        return "xzr" if sf else "wzr"
+    return f"{'x' if sf else 'w'}{n}"
+
+
+def shift(rng, sf):
+    if rng.random() < 0.5:
+        return ""
+    amount = rng.randrange(64 if sf else 32)
+    return f", {rng.choice(SHIFTS)} #{amount}"
+
+
+def logic_shift(rng, sf):
+    if rng.random() < 0.5:
+        return ""
+    amount = rng.randrange(64 if sf else 32)
+    return f", {rng.choice(SHIFTS + ['ror'])} #{amount:#x}"
+
+
+def arith(rng, op):
+    sf = rng.random() < 0.5
+    if rng.random() < 0.5:
+        imm = rng.randrange(4096)
+        lsl = f", lsl #{rng.choice([0, 12])}" if rng.random() < 0.5 else ""
+        return f"{op} {reg(rng, sf)}, {reg(rng, sf)}, #{imm:#x}{lsl}"
+    return f"{op} {reg(rng, sf)}, {reg(rng, sf)}, {reg(rng, sf)}{shift(rng, sf)}"
+
+
+def logic(rng, op):
+    sf = rng.random() < 0.5
+    return f"{op} {reg(rng, sf)}, {reg(rng, sf)}, {reg(rng, sf)}{logic_shift(rng, sf)}"
+
+
+def wide_move(rng, op):
+    sf = rng.random() < 0.5
+    hw = rng.randrange(4 if sf else 2)
+    return f"{op} {reg(rng, sf)}, #{rng.randrange(1 << 16):#x}, lsl #{hw * 16}"
+
+
+def multiply(rng, op):
+    sf = rng.random() < 0.5
+    return f"{op} {reg(rng, sf)}, {reg(rng, sf)}, {reg(rng, sf)}, {reg(rng, sf)}"
+
+
+def compare(rng, op):
+    sf = rng.random() < 0.5
+    if op != "tst" and rng.random() < 0.5:
+        return f"{op} {reg(rng, sf)}, #{rng.randrange(4096)}, lsl #{rng.choice([0, 12])}"
+    return f"{op} {reg(rng, sf)}, {reg(rng, sf)}{shift(rng, sf)}"
+
+
+def unary(rng, op):
+    sf = rng.random() < 0.5
+    return f"{op} {reg(rng, sf)}, {reg(rng, sf)}"
+
+
+def mul_alias(rng, op):
+    sf = rng.random() < 0.5
+    return f"{op} {reg(rng, sf)}, {reg(rng, sf)}, {reg(rng, sf)}"
+
+
+def transfer(rng, op, label):
+    sf = rng.random() < 0.5
+    rt, xn, xm = reg(rng, sf), f"x{rng.randrange(31)}", f"x{rng.randrange(31)}"
+    form = rng.randrange(5 if op == "ldr" else 4)
+    if form == 0:
+        return f"{op} {rt}, [{xn}, #{rng.randrange(512) * (8 if sf else 4)}]"
+    if form == 1:
+        return f"{op} {rt}, [{xn}, #{rng.randrange(-256, 256)}]!"
+    if form == 2:
+        return f"{op} {rt}, [{xn}], #{rng.randrange(-256, 256)}"
+    if form == 3:
+        return f"{op} {rt}, [{xn}, {xm}]"
+    return f"{op} {rt}, {label()}"
+
+
+def conditional(rng, op):
+    sf = rng.random() < 0.5
+    cond = rng.choice(CONDS[:-1])
+    if op in ("cset", "csetm"):
+        return f"{op} {reg(rng, sf)}, {cond}"
+    return f"{op} {reg(rng, sf)}, {reg(rng, sf)}, {reg(rng, sf)}, {cond}"
+
+
+def atomic(rng, op):
+    sf = rng.random() < 0.5
+    base = f"[x{rng.randrange(31)}]"
+    if op in ("ldxr", "ldaxr"):
+        return f"{op} {reg(rng, sf)}, {base}"
+    if op in ("stxr", "stlxr"):
+        return f"{op} {reg(rng, False)}, {reg(rng, sf)}, {base}"
+    return f"{op} {reg(rng, sf)}, {reg(rng, sf)}, {base}"
+
+
+def system(rng, op):
+    if op == "dmb":
+        return f"dmb {rng.choice(BARRIERS)}"
+    return f"mrs {reg(rng, True)}, mpidr_el1"
+
+
+def fp_reg(rng, double):
+    return f"{'d' if double else 's'}{rng.randrange(32)}"
+
+
+def simd_fp(rng, op):
+    double = rng.random() < 0.5
+    d = lambda: fp_reg(rng, double)
+    if op == "fmov":
+        if rng.random() < 0.5:
+            return f"fmov {d()}, {d()}"
+        return f"fmov {d()}, {reg(rng, double)}" if rng.random() < 0.5 else f"fmov {reg(rng, double)}, {d()}"
+    if op in ("fabs", "fneg"):
+        return f"{op} {d()}, {d()}"
+    if op == "fcmp":
+        return f"fcmp {d()}, {d()}"
+    if op == "fcvtzs":
+        return f"fcvtzs {reg(rng, double)}, {d()}"
+    if op == "scvtf":
+        return f"scvtf {d()}, {reg(rng, double)}"
+    return f"{op} {d()}, {d()}, {d()}"
+
+
+class Generator:
+    def __init__(self, args):
+        self.rng = random.Random(args.seed)
+        self.args = args
+        # Decide label positions up front, so forward references have targets.
+        self.labels = [i for i in range(args.lines) if self.rng.random() < args.label_density]
+        self.line = 0
+
+        rng = self.rng
+        t = []
+        t += [(op, lambda op: arith(rng, op)) for op in ("add", "adds", "sub", "subs")]
+        t += [(op, lambda op: logic(rng, op)) for op in ("and", "ands", "bic", "bics", "eor", "orr", "eon", "orn")]
+        t += [(op, lambda op: wide_move(rng, op)) for op in ("movk", "movn", "movz")]
+        t += [(op, lambda op: multiply(rng, op)) for op in ("madd", "msub")]
+        t += [(op, lambda op: compare(rng, op)) for op in ("cmp", "cmn", "tst")]
+        t += [(op, lambda op: unary(rng, op)) for op in ("neg", "negs", "mvn", "mov")]
+        t += [(op, lambda op: mul_alias(rng, op)) for op in ("mul", "mneg")]
+        t += [(op, self.branch) for op in ("b", "br", "b.eq", "b.ne", "b.ge", "b.lt", "b.gt", "b.le", "b.al")]
+        t += [(op, lambda op: transfer(rng, op, self.reference)) for op in ("str", "ldr")]
+        t += [(op, lambda op: conditional(rng, op)) for op in ("csel", "cset", "csetm", "csinc", "csinv", "csneg")]
+        t += [(op, lambda op: simd_fp(rng, op)) for op in (
+            "fmov", "fabs", "fneg", "fmin", "fmax", "fmul", "fdiv", "fadd", "fsub", "fnmul",
+            "fcmp", "fcvtzs", "scvtf")]
+        t += [(op, lambda op: atomic(rng, op)) for op in (
+            "ldxr", "ldaxr", "stxr", "stlxr", "ldadd", "ldadda", "ldaddl", "ldaddal",
+            "cas", "casa", "casl", "casal")]
+        t += [(op, lambda op: system(rng, op)) for op in ("dmb", "mrs")]
+        t += [(".int", lambda op: f".int {rng.randrange(1 << 32):#x}")]
+        self.table = t
+
+    def label_name(self, pos):
+        # Fixed width names, since symbol lookup matches on prefixes.
+        return f"l{pos:08d}"
+
+    def reference(self):
+        """ Picks a label near the current line, forwards or backwards. """
+        if not self.labels:
+            return "0x0"  # no labels at all, fall back to an absolute address literal
+        i = bisect.bisect_left(self.labels, self.line)
+        forward = self.rng.random() < self.args.forward_ratio
+        if (forward and i < len(self.labels)) or i == 0:
+            j = min(len(self.labels) - 1, i + self.rng.randrange(8))
+        else:
+            j = max(0, i - 1 - self.rng.randrange(8))
+        if abs(self.labels[j] - self.line) > REFERENCE_WINDOW:
+            j = i if i < len(self.labels) and abs(self.labels[i] - self.line) <= REFERENCE_WINDOW else i - 1
+        return self.label_name(self.labels[j])
+
+    def branch(self, op):
+        if op == "br":
+            return f"br x{self.rng.randrange(31)}"
+        return f"{op} {self.reference()}"
+
+    def instruction(self):
+        op, emit = self.rng.choice(self.table)
+        return emit(op)
+
+    def write(self, out):
+        labels = set(self.labels)
+        for self.line in range(self.args.lines):
+            if self.line in labels:
+                out.write(f"{self.label_name(self.line)}:\n")
+            out.write(f"    {self.instruction()}\n")
+        out.write("    and x0, x0, x0\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("-n", "--lines", type=int, default=100000, help="number of instruction lines")
+    parser.add_argument("-d", "--label-density", type=float, default=0.1,
+                        help="fraction of instructions preceded by a label")
+    parser.add_argument("-f", "--forward-ratio", type=float, default=0.5,
+                        help="fraction of label references that point forwards")
+    parser.add_argument("-s", "--seed", type=int, default=0)
+    parser.add_argument("-o", "--output", help="output file (default stdout)")
+    args = parser.parse_args()
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    Generator(args).write(out)
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
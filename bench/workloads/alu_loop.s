@@ -0,0 +1,15 @@
+// Tight integer ALU loop: 1,000,000 iterations of 7 instructions.
+movz x1, #0x4240
+movk x1, #0xf, lsl #16
+movz x20, #0x1234
+
+loop:
+    add x2, x2, #3
+    eor x3, x3, x2
+    madd x4, x2, x20, x4
+    orr x5, x5, x4, lsr #3
+    sub x6, x4, x5
+    subs x1, x1, #1
+    b.ne loop
+
+and x0, x0, x0
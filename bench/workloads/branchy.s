@@ -0,0 +1,34 @@
+// Branchy code: 500,000 iterations of data-dependent branches on the bits of
+// a 64-bit linear congruential generator.
+movz x20, #0x7f2d
+movk x20, #0x4c95, lsl #16
+movk x20, #0xf42d, lsl #32
+movk x20, #0x5851, lsl #48
+movz x21, #0xf64f
+movk x21, #0x2e3b, lsl #16
+movk x21, #0x4061, lsl #32
+movk x21, #0x1405, lsl #48
+movz x22, #0x1, lsl #16
+movz x23, #0x1, lsl #32
+movz x9, #0xa120
+movk x9, #0x7, lsl #16
+
+loop:
+    madd x1, x1, x20, x21
+    tst x1, x22
+    b.eq even
+    add x3, x3, #1
+    b next
+even:
+    sub x4, x4, #1
+next:
+    tst x1, x23
+    b.ne skip
+    add x5, x5, x1
+skip:
+    cmp x3, x5
+    csel x6, x3, x6, lt
+    subs x9, x9, #1
+    b.ne loop
+
+and x0, x0, x0
@@ -0,0 +1,22 @@
+// Floating-point kernel: 500,000 iterations of double precision arithmetic.
+movz x1, #1
+scvtf d1, x1
+movz x2, #3
+scvtf d2, x2
+movz x9, #0xa120
+movk x9, #0x7, lsl #16
+
+loop:
+    fmul d4, d1, d2
+    fadd d5, d5, d4
+    fsub d6, d5, d1
+    fdiv d7, d6, d2
+    fmax d8, d7, d1
+    fmin d9, d8, d2
+    fadd d1, d9, d1
+    subs x9, x9, #1
+    b.ne loop
+
+fcvtzs x10, d5
+fcvtzs x11, d1
+and x0, x0, x0
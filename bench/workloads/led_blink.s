@@ -0,0 +1,50 @@
+// programs/led_blink.s with the GPIO registers moved into emulated memory,
+// and the endless blink loop bounded to 4 blinks.
+ldr w0, set_output
+ldr w2, addr_gpio_sel
+str w0, [w2]
+ldr w3, blinks
+
+begin:
+    ldr w0, set_pin
+    ldr w2, addr_gpio_set
+    str w0, [w2]
+
+    ldr w1, wait_cycles
+wait1:
+    subs w1, w1, #0x1
+    b.ne wait1
+
+    ldr w0, set_pin
+    ldr w2, addr_gpio_clr
+    str w0, [w2]
+
+    ldr w1, wait_cycles
+wait2:
+    subs w1, w1, #0x1
+    b.ne wait2
+    subs w3, w3, #0x1
+    b.ne begin
+
+and x0, x0, x0
+
+set_output:
+    .int 0x40
+
+set_pin:
+    .int 0x4
+
+wait_cycles:
+    .int 0x100000
+
+blinks:
+    .int 0x4
+
+addr_gpio_sel:
+    .int 0x100000
+
+addr_gpio_set:
+    .int 0x10001c
+
+addr_gpio_clr:
+    .int 0x100028
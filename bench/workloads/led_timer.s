@@ -0,0 +1,65 @@
+// led_blink.s waiting on the virtual timer rather than counting down: each wait
+// programs CNTV_CVAL_EL0 and sleeps in WFI until the timer interrupt, which the
+// emulator skips ahead to. Interrupts stay masked, so no vector table is needed.
+ldr w0, set_output
+ldr w2, addr_gpio_sel
+str w0, [w2]
+ldr w3, blinks
+ldr w5, wait_ticks
+movz x4, #0x1
+msr icc_igrpen1_el1, x4
+msr cntv_ctl_el0, x4
+
+begin:
+    ldr w0, set_pin
+    ldr w2, addr_gpio_set
+    str w0, [w2]
+
+    mrs x6, cntvct_el0
+    add x6, x6, x5
+    msr cntv_cval_el0, x6
+wait1:
+    wfi
+    mrs x7, icc_iar1_el1
+    cmp x7, #27
+    b.ne wait1
+    msr icc_eoir1_el1, x7
+
+    ldr w0, set_pin
+    ldr w2, addr_gpio_clr
+    str w0, [w2]
+
+    mrs x6, cntvct_el0
+    add x6, x6, x5
+    msr cntv_cval_el0, x6
+wait2:
+    wfi
+    mrs x7, icc_iar1_el1
+    cmp x7, #27
+    b.ne wait2
+    msr icc_eoir1_el1, x7
+    subs w3, w3, #0x1
+    b.ne begin
+
+and x0, x0, x0
+
+set_output:
+    .int 0x40
+
+set_pin:
+    .int 0x4
+
+wait_ticks:
+    .int 0x200000
+
+blinks:
+    .int 0x4
+
+addr_gpio_sel:
+    .int 0x100000
+
+addr_gpio_set:
+    .int 0x10001c
+
+addr_gpio_clr:
+    .int 0x100028
@@ -0,0 +1,32 @@
+// Linked-list walk: builds a 4096 node cyclic list, with nodes linked in a
+// scattered order, then follows 400 laps of it summing the node values.
+movz x8, #0xfff           // node index mask (4096 nodes)
+movz x11, #0x4, lsl #16   // nodes at 0x40000, 16 bytes each (next, value)
+movz x12, #1597           // step between linked nodes, odd so the list is one cycle
+
+    movz x5, #4096
+build:
+    add x7, x6, x12
+    and x7, x7, x8
+    add x1, x11, x6, lsl #4
+    add x2, x11, x7, lsl #4
+    str x2, [x1]
+    str x5, [x1, #8]
+    add x6, x7, #0
+    subs x5, x5, #1
+    b.ne build
+
+    movz x9, #400
+lap:
+    add x1, x11, #0
+    movz x4, #4096
+walk:
+    ldr x2, [x1, #8]
+    add x3, x3, x2
+    ldr x1, [x1]
+    subs x4, x4, #1
+    b.ne walk
+    subs x9, x9, #1
+    b.ne lap
+
+and x0, x0, x0
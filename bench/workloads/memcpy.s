@@ -0,0 +1,27 @@
+// Memory copy: fills a 4 KB block, then copies it 2000 times with 64-bit
+// post-indexed loads and stores.
+movz x10, #0x1, lsl #16   // source at 0x10000
+movz x11, #0x2, lsl #16   // destination at 0x20000
+
+    add x1, x10, #0
+    movz x5, #512
+fill:
+    add x3, x3, #0x101
+    str x3, [x1], #8
+    subs x5, x5, #1
+    b.ne fill
+
+    movz x9, #2000
+copy:
+    add x1, x10, #0
+    add x2, x11, #0
+    movz x5, #512
+copy_word:
+    ldr x4, [x1], #8
+    str x4, [x2], #8
+    subs x5, x5, #1
+    b.ne copy_word
+    subs x9, x9, #1
+    b.ne copy
+
+and x0, x0, x0
@@ -0,0 +1,26 @@
+// Shared counter: every core adds to one counter with LDADD, 200000 times, between
+// rounds of private arithmetic, then stores its own sum at 0x20000 + 8 * core. Run with
+// CORES=n to spread the cores over host threads. Retry loops (LDXR/STXR, CAS) are left out,
+// since their instruction count would depend on contention.
+mrs x9, mpidr_el1
+movz x1, #0xff
+and x9, x9, x1              // core number
+movz x10, #0x1, lsl #16     // shared counter at 0x10000
+movz x11, #0x2, lsl #16
+add x11, x11, x9, lsl #3    // private sum
+movz x12, #1
+movz x13, #0x9e37
+movz x14, #0x3, lsl #16
+add x14, x14, #0x0d40       // 200000 iterations
+
+loop:
+    ldadd x12, x2, [x10]
+    add x3, x3, x2
+    eor x3, x3, x13
+    add x3, x3, x3, lsr #7
+    subs x14, x14, #1
+    b.ne loop
+
+dmb ish
+str x3, [x11]
+and x0, x0, x0
@@ -0,0 +1,43 @@
+// String copy: fills a 4 KB NUL-terminated string, then copies it 1000 times
+// a byte at a time with ldrb/strb, and 1000 times 16 bytes at a time with
+// ldp/stp, the way guest C library routines do.
+movz x10, #0x1, lsl #16   // source at 0x10000
+movz x11, #0x2, lsl #16   // destination at 0x20000
+
+    add x1, x10, #0
+    movz x5, #4095
+    movz x6, #0x3f
+fill:
+    and w3, w5, w6
+    add w3, w3, #0x20     // printable, never NUL
+    strb w3, [x1], #1
+    subs x5, x5, #1
+    b.ne fill
+    strb wzr, [x1]
+
+    movz x9, #1000
+copy:
+    add x1, x10, #0
+    add x2, x11, #0
+copy_byte:
+    ldrb w4, [x1], #1
+    strb w4, [x2], #1
+    cmp w4, #0
+    b.ne copy_byte
+    subs x9, x9, #1
+    b.ne copy
+
+    movz x9, #1000
+copy_pairs:
+    add x1, x10, #0
+    add x2, x11, #0
+    movz x5, #256
+copy_pair:
+    ldp x3, x4, [x1], #16
+    stp x3, x4, [x2], #16
+    subs x5, x5, #1
+    b.ne copy_pair
+    subs x9, x9, #1
+    b.ne copy_pairs
+
+and x0, x0, x0
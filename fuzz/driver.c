@@ -0,0 +1,103 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "armv8.h"
+
+// Largest random input
+#define MAX_RANDOM_INPUT 4096
+#define NS_PER_SEC 1000000000.0
+
+// Fuzz target, see fuzz_emulate.c and fuzz_assemble.c
+extern int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Runs the target on the contents of `stream`
+static void run_stream(FILE *stream)
+{
+  buffer_t buf = buffer_init(0);
+  byte chunk[4096];
+  size_t len;
+  while ((len = fread(chunk, 1, sizeof(chunk), stream)) > 0)
+  {
+    buffer_append(buf, chunk, len);
+  }
+  LLVMFuzzerTestOneInput(buf->data, buf->len);
+  buffer_free(buf);
+}
+
+// xorshift64, cheap next to the target
+static ullong next_random(ullong *seed)
+{
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 7;
+  *seed ^= *seed << 17;
+  return *seed;
+}
+
+// Runs the target on `runs` random inputs, reporting executions per second on stderr
+static void run_random(long runs, ullong seed)
+{
+  ullong words[MAX_RANDOM_INPUT / sizeof(ullong)];
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (long run = 0; run < runs; run++)
+  {
+    size_t len = next_random(&seed) % MAX_RANDOM_INPUT;
+    for (size_t i = 0; i < (len + sizeof(ullong) - 1) / sizeof(ullong); i++)
+    {
+      words[i] = next_random(&seed);
+    }
+    LLVMFuzzerTestOneInput((const uint8_t *)words, len);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / NS_PER_SEC;
+  fprintf(stderr, "%ld runs in %.3f s (%.0f execs/s)\n", runs, secs, runs / secs);
+}
+
+// Standalone driver for builds without libFuzzer: runs the target once per input file, on stdin
+// if there are none (for AFL), or on random inputs with -r.
+int main(int argc, char **argv)
+{
+  long runs = 0;
+  ullong seed = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "r:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'r':
+      runs = atol(optarg);
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-r <runs> [-s <seed>]] [<input>...]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (runs > 0)
+  {
+    run_random(runs, seed != 0 ? seed : 1);
+    return EXIT_SUCCESS;
+  }
+  if (optind == argc)
+  {
+    run_stream(stdin);
+    return EXIT_SUCCESS;
+  }
+  for (int i = optind; i < argc; i++)
+  {
+    FILE *fin = fopen(argv[i], "rb");
+    if (fin == NULL)
+    {
+      fprintf(stderr, "Error: Could not open file %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+    run_stream(fin);
+    fclose(fin);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,31 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "armv8.h"
+#include "assembler.h"
+
+// Most threads parallel_assemble() is run with, more than the lines of most inputs
+#define MAX_THREADS 32
+
+// Assembles the input as source text. Invalid source is rejected without leaking. Valid source
+// is also assembled in parallel, which must give the same output however many threads split it.
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static buffer_t out = NULL;
+  static buffer_t parallel_out = NULL;
+  if (out == NULL)
+  {
+    out = buffer_init(0);
+    parallel_out = buffer_init(0);
+  }
+  out->len = 0;
+  if (!armv8_assemble_checked((const char *)data, size, out))
+    return 0;
+
+  // Errors on the assembler threads would exit, so only source assembled above gets here
+  parallel_out->len = 0;
+  parallel_assemble((const char *)data, size, parallel_out, 1 + size % MAX_THREADS);
+  if (parallel_out->len != out->len || memcmp(parallel_out->data, out->data, out->len) != 0)
+    abort();
+  return 0;
+}
@@ -0,0 +1,26 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "armv8.h"
+
+// Instruction budget of one input, so that loops in the guest end
+#define MAX_INSNS 10000
+// Largest image loaded, longer inputs are truncated
+#define MAX_IMAGE 65536
+
+// Loads the input as a guest image at address 0 and runs it. One emulator is reused, and only
+// the memory written by the last input is cleared.
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static armv8_emul emul = NULL;
+  if (emul == NULL)
+    emul = armv8_emul_create();
+  else
+    armv8_emul_reset(emul);
+
+  armv8_emul_load(emul, data, size < MAX_IMAGE ? size : MAX_IMAGE);
+  armv8_emul_run_checked(emul, MAX_INSNS);
+  // The zero register is never written
+  if (armv8_emul_get_reg(emul, GENERAL_REGS) != 0)
+    abort();
+  return 0;
+}
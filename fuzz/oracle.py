@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""
+Differential oracle for the assembler and emulator.
+
+Generates random straight-line programs with forward branches and loads and stores,
+then checks the tools under test against references:
+
+- with --toolchain, the binary must match the one built by `<prefix>-as` and
+  `<prefix>-objcopy`, as armv8_testsuite builds its expected binaries;
+- with --ref-emulator, the final state must match the one the reference emulator
+  prints for the same binary, compared with armv8_testsuite's CPU_State.
+
+Failing programs are kept in --outdir.
+"""
+
+import argparse
+import random
+import shutil
+import subprocess as sp
+import sys
+import tempfile
+from pathlib import Path
+
+ROOT = Path(__file__).resolve().parent.parent
+sys.path.insert(0, str(ROOT / "armv8_testsuite"))
+
+from armv8suite.data import parsing  # noqa: E402
+
+CONDS = ["eq", "ne", "ge", "lt", "gt", "le", "al"]
+SHIFTS = ["lsl", "lsr", "asr", "ror"]
+DATA_BASE = 0x10000  # x28 and x29 point here, see prologue()
+DATA_WORDS = 64
+HALT = "and x0, x0, x0"
+
+# `mov`, `neg`, `negs` and `mvn` are left out: their operand rewrite in src/assembler.c
+# repeats the destination register, a known difference from the toolchain.
+
+
+def reg(rng, sf, zr=True):
+    """x0-x27 or the zero register, x28 and x29 hold the data address"""
+    n = rng.randrange(29 if zr else 28)
+    if n == 28:
+        return "xzr" if sf else "wzr"
+    return f"{'x' if sf else 'w'}{n}"
+
+
+def shifted(rng, sf, rotate=False):
+    kind = rng.choice(SHIFTS if rotate else SHIFTS[:3])
+    # An arithmetic shift by 0 was undefined behaviour in the original emulator
+    amount = rng.randrange(1 if kind == "asr" else 0, 64 if sf else 32)
+    return f", {kind} #{amount}" if amount or rng.random() < 0.5 else ""
+
+
+def instruction(rng):
+    """One random instruction, or a conditional branch placeholder"""
+    sf = rng.random() < 0.7
+    rd, rn, rm, ra = (reg(rng, sf) for _ in range(4))
+    kind = rng.randrange(11)
+    if kind == 0:
+        op = rng.choice(["movz", "movn", "movk"])
+        hw = rng.randrange(4 if sf else 2)
+        return f"{op} {reg(rng, sf, zr=False)}, #{rng.getrandbits(16)}, lsl #{16 * hw}"
+    if kind == 1:
+        op = rng.choice(["add", "adds", "sub", "subs"])
+        lsl = ", lsl #12" if rng.random() < 0.2 else ""
+        return f"{op} {reg(rng, sf, zr=op.endswith('s'))}, {reg(rng, sf, zr=False)}, #{rng.getrandbits(12)}{lsl}"
+    if kind == 2:
+        op = rng.choice(["add", "adds", "sub", "subs"])
+        return f"{op} {rd}, {rn}, {rm}{shifted(rng, sf)}"
+    if kind == 3:
+        op = rng.choice(["and", "ands", "bic", "bics", "eor", "orr", "eon", "orn"])
+        return f"{op} {rd}, {rn}, {rm}{shifted(rng, sf, rotate=True)}"
+    if kind == 4:
+        op = rng.choice(["madd", "msub"])
+        return f"{op} {rd}, {rn}, {rm}, {ra}"
+    if kind == 5:
+        op = rng.choice(["cmp", "cmn", "tst"])
+        return f"{op} {rn}, {rm}"
+    if kind == 6:
+        op = rng.choice(["csel", "csinc", "csinv", "csneg"])
+        return f"{op} {rd}, {rn}, {rm}, {rng.choice(CONDS[:-1])}"
+    if kind == 7:
+        return f"{rng.choice(['cset', 'csetm'])} {rd}, {rng.choice(CONDS[:-1])}"
+    if kind == 8:
+        op = rng.choice(["ldr", "str"])
+        size = 8 if sf else 4
+        offset = rng.randrange(DATA_WORDS * 4 // size) * size
+        return f"{op} {reg(rng, sf, zr=False)}, [x28, #{offset}]"
+    if kind == 9:
+        op = rng.choice(["ldr", "str"])
+        rt = reg(rng, sf, zr=False)
+        simm = rng.randrange(-8, 9) * 4
+        return rng.choice([f"{op} {rt}, [x29, #{simm}]!", f"{op} {rt}, [x29], #{simm}"])
+    return None  # branch, resolved by program()
+
+
+def prologue(rng):
+    lines = [f"movz x28, #{DATA_BASE >> 16}, lsl #16", f"movz x29, #{DATA_BASE >> 16}, lsl #16",
+             f"add x29, x29, #{DATA_WORDS * 2}"]
+    for r in range(28):
+        value = rng.choice([0, 1, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF, rng.getrandbits(64)])
+        lines.append(f"movz x{r}, #{value & 0xFFFF}")
+        for hw in range(1, 4):
+            lines.append(f"movk x{r}, #{(value >> (16 * hw)) & 0xFFFF}, lsl #{16 * hw}")
+    return lines
+
+
+def program(rng, length):
+    body = [instruction(rng) for _ in range(length)]
+    lines = prologue(rng)
+    for i, instr in enumerate(body):
+        lines.append(f"l{i}:")
+        if instr is None:
+            target = rng.randrange(i + 1, length + 1)
+            cond = rng.choice(CONDS)
+            lines.append(f"b l{target}" if cond == "al" and rng.random() < 0.5 else f"b.{cond} l{target}")
+        else:
+            lines.append(instr)
+    lines += [f"l{length}:", HALT]
+    # Pad to the data area, whose initial words are random
+    words = len([line for line in lines if not line.endswith(":")])
+    lines += [".int 0"] * (DATA_BASE // 4 - words)
+    lines += [f".int {rng.getrandbits(32)}" for _ in range(DATA_WORDS)]
+    return "\n".join(lines) + "\n"
+
+
+def run(cmd):
+    return sp.run([str(c) for c in cmd], stdout=sp.PIPE, stderr=sp.PIPE, timeout=10)
+
+
+def check(args, source, work):
+    """Returns a description of the first difference, or None"""
+    src, act_bin, act_out = work / "prog.s", work / "act.bin", work / "act.out"
+    src.write_text(source)
+    if run([args.assembler, src, act_bin]).returncode != 0:
+        return "assembler failed"
+
+    ref_bin = act_bin
+    if args.toolchain:
+        ref_bin = work / "ref.bin"
+        if run([f"{args.toolchain}-as", src, "-o", ref_bin]).returncode != 0:
+            return "reference assembler failed"
+        run([f"{args.toolchain}-objcopy", "-O", "binary", ref_bin])
+        if ref_bin.read_bytes() != act_bin.read_bytes():
+            return "binaries differ"
+
+    if args.ref_emulator:
+        ref_out = work / "ref.out"
+        ref = run([args.ref_emulator, ref_bin, ref_out])
+        act = run([args.emulator, "--dump-format=bin", act_bin, act_out])
+        if ref.returncode != act.returncode:
+            return f"exit status {act.returncode}, expected {ref.returncode}"
+        if ref.returncode != 0:
+            return None
+        exp_state = parsing.parse_out_file(ref_out)
+        act_state = parsing.parse_bin_file(act_out)
+        if exp_state.is_err() or act_state.is_err():
+            return "state dump not parsed"
+        diffs = exp_state.unwrap().compare(act_state.unwrap())
+        if diffs.any_diffs():
+            return f"states differ\n{diffs}"
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("-n", "--runs", type=int, default=100, help="programs to generate")
+    parser.add_argument("-s", "--seed", type=int, default=1)
+    parser.add_argument("-l", "--length", type=int, default=64, help="instructions per program")
+    parser.add_argument("--assembler", default=ROOT / "src" / "assemble")
+    parser.add_argument("--emulator", default=ROOT / "src" / "emulate")
+    parser.add_argument("--toolchain", help="prefix of the reference toolchain, e.g. aarch64-none-elf")
+    parser.add_argument("--ref-emulator", help="reference emulator, printing the text state dump")
+    parser.add_argument("--outdir", type=Path, default=Path("build/oracle"), help="where failing programs are kept")
+    args = parser.parse_args()
+    if not args.toolchain and not args.ref_emulator:
+        parser.error("nothing to compare against, give --toolchain and/or --ref-emulator")
+
+    rng = random.Random(args.seed)
+    failures = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        work = Path(tmp)
+        for i in range(args.runs):
+            source = program(rng, args.length)
+            failure = check(args, source, work)
+            if failure is not None:
+                failures += 1
+                args.outdir.mkdir(parents=True, exist_ok=True)
+                kept = args.outdir / f"seed{args.seed}_{i}.s"
+                shutil.copy(work / "prog.s", kept)
+                print(f"{kept}: {failure}")
+    print(f"{args.runs} programs, {failures} failures")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
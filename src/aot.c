@@ -0,0 +1,37 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "emulator.h"
+#include "translator.h"
+#include "aot.h"
+
+int main(int argc, char **argv)
+{
+  if (argc != 3)
+  {
+    fprintf(stderr, "Usage: %s <file in> <file out>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  FILE *fin = fopen(argv[1], "rb");
+  if (fin == NULL)
+  {
+    fprintf(stderr, "Error: Could not open file %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  // Images are loaded at address 0 like emulate does, so only MAX_MEMORY bytes are read
+  byte *image = malloc(MAX_MEMORY);
+  ulong size = fread(image, 1, MAX_MEMORY, fin);
+  fclose(fin);
+
+  FILE *fout = fopen(argv[2], "w");
+  if (fout == NULL)
+  {
+    fprintf(stderr, "Error: Could not open file %s\n", argv[2]);
+    free(image);
+    return EXIT_FAILURE;
+  }
+  translate_image(fout, image, size);
+  fclose(fout);
+  free(image);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "armv8.h"
+#include "assembler.h"
+#include "error.h"
+#include "scheduler.h"
+
+size_t armv8_assemble(const char *src, size_t len, buffer_t out)
+{
+  size_t start = out->len;
+  assemble_source(src, len, out);
+  return out->len - start;
+}
+
+bool armv8_assemble_checked(const char *src, size_t len, buffer_t out)
+{
+  long length = len;
+  char *stripped = strip_comments(src, &length);
+  symbol_table_t st = symbol_table_init();
+  size_t start = out->len;
+  bool ok = true;
+  jmp_buf recovery;
+  jmp_buf *outer = error_recovery;
+  if (setjmp(recovery) == 0)
+  {
+    error_recovery = &recovery;
+    assemble_program(stripped, length, st, out);
+  }
+  else
+  {
+    ok = false;
+    out->len = start;
+  }
+  error_recovery = outer;
+  symbol_table_free(st);
+  free(stripped);
+  return ok;
+}
+
+armv8_emul armv8_emul_create(void)
+{
+  return emulstate_init();
+}
+
+armv8_emul armv8_emul_create_core(armv8_emul primary, int core)
+{
+  return emulstate_init_core(primary, core);
+}
+
+bool armv8_emul_load(armv8_emul emul, const void *image, size_t len)
+{
+  if (len > MAX_MEMORY)
+    return false;
+  memcpy(emul->memory, image, len);
+  invalidate_decoded(emul, 0, len);
+  return true;
+}
+
+bool armv8_emul_step(armv8_emul emul)
+{
+  return emulstep(emul);
+}
+
+ullong armv8_emul_run(armv8_emul emul)
+{
+  ullong start = emul->insns;
+  emulrun(emul, NO_INSN_LIMIT);
+  return emul->insns - start;
+}
+
+armv8_status armv8_emul_run_checked(armv8_emul emul, ullong max_insns)
+{
+  armv8_status status = ARMV8_BUDGET;
+  ullong start = emul->insns;
+  jmp_buf recovery;
+  jmp_buf *outer = error_recovery;
+  if (setjmp(recovery) == 0)
+  {
+    error_recovery = &recovery;
+    ullong limit = max_insns < NO_INSN_LIMIT - start ? start + max_insns : NO_INSN_LIMIT;
+    if (!emulrun(emul, limit))
+      status = ARMV8_HALTED;
+  }
+  else
+  {
+    status = ARMV8_FAULT;
+  }
+  error_recovery = outer;
+  return status;
+}
+
+ullong armv8_emul_run_many(armv8_emul *emuls, size_t count, int threads, ullong slice,
+                           ullong budget, ullong max_insns, armv8_status *status,
+                           char (*errors)[ARMV8_ERROR_SIZE])
+{
+  scheduler_t sched = scheduler_init(slice);
+  for (size_t i = 0; i < count; i++)
+  {
+    scheduler_limit(sched, scheduler_add(sched, emuls[i]), max_insns);
+  }
+  ullong executed = scheduler_run(sched, threads, budget);
+  for (size_t i = 0; i < count; i++)
+  {
+    if (errors != NULL)
+    {
+      const char *error = scheduler_error(sched, i);
+      snprintf(errors[i], ARMV8_ERROR_SIZE, "%s", error == NULL ? "" : error);
+    }
+    switch (scheduler_status(sched, i))
+    {
+    case GUEST_HALTED:
+      status[i] = ARMV8_HALTED;
+      break;
+    case GUEST_FAULTED:
+      status[i] = ARMV8_FAULT;
+      break;
+    default:
+      status[i] = ARMV8_BUDGET;
+    }
+  }
+  scheduler_free(sched);
+  return executed;
+}
+
+void armv8_emul_reset(armv8_emul emul)
+{
+  emulstate_reset(emul);
+}
+
+void armv8_emul_destroy(armv8_emul emul)
+{
+  emulstate_free(emul);
+}
+
+void armv8_emul_get_regs(armv8_emul emul, armv8_regs *out)
+{
+  memcpy(out->regs, emul->regs, sizeof(out->regs));
+  out->sp = emul->regs[SP_REG];
+  out->pc = emul->pc;
+  out->pstate = emul->pstate;
+}
+
+ullong armv8_emul_get_reg(armv8_emul emul, int reg)
+{
+  if (reg < 0 || reg > GENERAL_REGS)
+    return 0;
+  return emul->regs[reg];
+}
+
+const byte *armv8_emul_memory(armv8_emul emul, size_t *size)
+{
+  *size = MAX_MEMORY;
+  return emul->memory;
+}
+
+void armv8_emul_dump(armv8_emul emul, FILE *stream)
+{
+  fprint_emulstate(stream, emul);
+}
+
+const char *armv8_error(void)
+{
+  return error_message();
+}
@@ -0,0 +1,81 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include "buffer.h"
+#include "emulator.h"
+
+#ifndef ARMV8_H
+#define ARMV8_H
+
+// Public API of libarmv8, for assembling and emulating programs in-process
+// without going through files.
+
+// Emulator handle
+typedef emulstate armv8_emul;
+
+// Size of an error message of armv8_emul_run_many(), with its terminating NUL
+#define ARMV8_ERROR_SIZE 256
+
+// Snapshot of the emulator registers
+typedef struct
+{
+  ullong regs[GENERAL_REGS];
+  ullong pc;
+  pstate_t pstate;
+  ullong sp; // last, so that the layout before it stays that of earlier versions
+} armv8_regs;
+
+// Outcome of armv8_emul_run_checked()
+typedef enum
+{
+  ARMV8_HALTED, // the program reached HALT
+  ARMV8_BUDGET, // the instruction budget ran out first
+  ARMV8_FAULT,  // unknown instruction or out of bounds memory access, see armv8_error()
+} armv8_status;
+
+// Assembles `len` bytes of source, appending the binary to `out`.
+// Returns the number of bytes appended.
+extern size_t armv8_assemble(const char *src, size_t len, buffer_t out);
+// Assembles like armv8_assemble, but returns false instead of exiting if the source is invalid,
+// leaving `out` unchanged.
+extern bool armv8_assemble_checked(const char *src, size_t len, buffer_t out);
+
+// Creates an emulator with zeroed memory and registers, but for SP at the top of memory.
+extern armv8_emul armv8_emul_create(void);
+// Creates core `core` (1-255) of the machine of `primary`, sharing its memory. Running the
+// cores of a machine with armv8_emul_run_many() on as many threads runs each on its own host
+// thread. Destroy the other cores before `primary`.
+extern armv8_emul armv8_emul_create_core(armv8_emul primary, int core);
+// Loads a binary image at address 0. Returns false if it does not fit in memory.
+extern bool armv8_emul_load(armv8_emul emul, const void *image, size_t len);
+// Executes the next instruction, or a pair of instructions fused by the decoder.
+// Returns false once the program halted.
+extern bool armv8_emul_step(armv8_emul emul);
+// Runs until the program halts. Returns the number of instructions executed.
+extern ullong armv8_emul_run(armv8_emul emul);
+// Runs until the program halts, stopping at the first step that reaches `max_insns` instructions.
+// Errors in the program return ARMV8_FAULT instead of exiting.
+extern armv8_status armv8_emul_run_checked(armv8_emul emul, ullong max_insns);
+// Runs `count` emulators interleaved on `threads` host threads, `slice` instructions at a time
+// (see scheduler.h), until each halts, faults or ran `max_insns` instructions of its own, or
+// `budget` instructions ran in total (0 for no limit to either). Stores the outcome of each in
+// `status`, and, unless `errors` is NULL, the error message of each that faulted in `errors`
+// (empty for the others). Returns the instructions run.
+extern ullong armv8_emul_run_many(armv8_emul *emuls, size_t count, int threads, ullong slice,
+                                  ullong budget, ullong max_insns, armv8_status *status,
+                                  char (*errors)[ARMV8_ERROR_SIZE]);
+// Resets the registers and the memory written since the last reset, to reuse the emulator.
+extern void armv8_emul_reset(armv8_emul emul);
+// Frees the emulator.
+extern void armv8_emul_destroy(armv8_emul emul);
+// Returns the message of the last error returned on this thread by a checked function.
+extern const char *armv8_error(void);
+
+// Copies the general registers, SP, PC and PSTATE into `out`.
+extern void armv8_emul_get_regs(armv8_emul emul, armv8_regs *out);
+// Returns the value of general register `reg` (0-30), or 0 for the zero register.
+extern ullong armv8_emul_get_reg(armv8_emul emul, int reg);
+// Returns a read-only view of the emulator memory, storing its size in `size`.
+extern const byte *armv8_emul_memory(armv8_emul emul, size_t *size);
+// Writes the emulator state in the same text format as `emulate`.
+extern void armv8_emul_dump(armv8_emul emul, FILE *stream);
+#endif
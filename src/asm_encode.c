@@ -3,6 +3,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include "asm_encode.h"
+#include "error.h"
+#include "isa.h"
 #include "parse_utils.h"
 
 char *arithmetic[] = {"add", "adds", "sub", "subs", NULL};
@@ -10,6 +12,46 @@ char *logic[] = {"and", "bic", "orr", "orn", "eor", "eon", "ands", "bics", NULL}
 char *movs[] = {"movn", "movz", "movk", NULL};
 char *muls[] = {"madd", "msub", NULL};
 
+// Loads and stores of one register, by their mnemonic without the U of the unscaled forms: the
+// log2 of their access size (-1 for that of the register) and their opc, with SIGNED_OPC
+// standing for the sign-extending loads into X (2) or W (3) registers
+#define SIGNED_OPC -1
+static const struct
+{
+  const char *name;
+  int size;
+  int opc;
+} sdt_forms[] = {
+    {"str", -1, 0}, {"ldr", -1, 1}, {"strb", 0, 0}, {"ldrb", 0, 1}, {"ldrsb", 0, SIGNED_OPC},
+    {"strh", 1, 0}, {"ldrh", 1, 1}, {"ldrsh", 1, SIGNED_OPC}, {"ldrsw", 2, SIGNED_OPC},
+};
+
+// Addressing modes of LDP and STP (bits 24..23)
+#define PAIR_POST 1
+#define PAIR_OFFSET 2
+#define PAIR_PRE 3
+#define PAIR_IMM_MIN -64
+#define PAIR_IMM_MAX 63
+#define PAIR_OPC_SIGNED 1 // LDPSW
+// Indexing of single-register loads and stores (bits 11..10), and the range of their offsets
+#define INDEX_UNSCALED 0
+#define INDEX_POST 1
+#define INDEX_REGISTER 2
+#define INDEX_PRE 3
+#define SIMM9_MIN -256
+#define SIMM9_MAX 255
+#define UIMM12_MAX 4095
+// Extensions of the index register (bits 15..13)
+#define EXTEND_UXTW 2
+#define EXTEND_LSL 3
+#define EXTEND_SXTW 6
+#define EXTEND_SXTX 7
+// opc of LDR (literal) (bits 31..30)
+#define LITERAL_OPC_32 0
+#define LITERAL_OPC_64 1
+#define LITERAL_OPC_LDRSW 2
+#define LINK_REG 30
+
 char *get_condition_code(const char *str)
 {
   if (strlen(str) <= 2)
@@ -58,8 +100,7 @@ ulong encode_dp(symbol_table_t st, char *opcode, char *operands)
     instr = set_value(instr, arith_idx, 29, 2);
     if (operands[0] == '#')
     {
-      // 0b100010 for arithmetic immediate
-      instr = set_value(instr, 0x22, 23, 6);
+      instr |= ARITH_IMM_MATCH;
 
       ulong imm;
       operands = finish_parse_operand(parse_imm(operands + 1, &imm));
@@ -69,8 +110,8 @@ ulong encode_dp(symbol_table_t st, char *opcode, char *operands)
       {
         if (strncmp(operands, "lsl #", 5) != 0)
         {
-          fprintf(stderr, "Error: Only LSL shift supported for immediate arithmetic\n");
-          exit(1);
+          error_report("Error: Only LSL shift supported for immediate arithmetic\n");
+          error_fail();
         }
         ulong shift;
         operands = finish_parse_operand(parse_imm(operands + 5, &shift));
@@ -84,26 +125,26 @@ ulong encode_dp(symbol_table_t st, char *opcode, char *operands)
         }
         else
         {
-          fprintf(stderr, "Error: Only LSL #0 or #12 supported for immediate arithmetic\n");
-          exit(1);
+          error_report("Error: Only LSL #0 or #12 supported for immediate arithmetic\n");
+          error_fail();
         }
       }
 
       if (!r2_sp_used && r2 == MAX_REG)
       {
-        fprintf(stderr, "Error: Cannot use ZR as Rn in immediate arithmetic\n");
-        exit(1);
+        error_report("Error: Cannot use ZR as Rn in immediate arithmetic\n");
+        error_fail();
       }
       // adds and subs are allowed to use ZR for Rd
       if (arith_idx != 1 && arith_idx != 3 && !r1_sp_used && r1 == MAX_REG)
       {
-        fprintf(stderr, "Error: Cannot use ZR as Rd in immediate arithmetic without setting flags\n");
-        exit(1);
+        error_report("Error: Cannot use ZR as Rd in immediate arithmetic without setting flags\n");
+        error_fail();
       }
       if (r1_sf != r2_sf)
       {
-        fprintf(stderr, "Error: Register sizes must match in immediate arithmetic\n");
-        exit(1);
+        error_report("Error: Register sizes must match in immediate arithmetic\n");
+        error_fail();
       }
       instr = set_value(instr, r1_sf, 31, 1);
     }
@@ -113,9 +154,14 @@ ulong encode_dp(symbol_table_t st, char *opcode, char *operands)
       ulong r3;
       operands = finish_parse_operand(parse_register(operands, &r3, &r3_sf, &r3_sp_used));
       instr = set_value(instr, r3, 16, 5);
-      instr = set_value(instr, 0x5, 25, 4);
+      instr |= ARITH_REG_MATCH;
       instr = set_value(instr, r3_sf, 31, 1);
-      instr = set_value(instr, 0x8, 21, 4);
+
+      if (r1_sp_used || r2_sp_used || r3_sp_used)
+      {
+        error_report("Error: Cannot use SP as register in register arithmetic\n");
+        error_fail();
+      }
 
       if (operands[0] != '\0')
       {
@@ -133,8 +179,8 @@ ulong encode_dp(symbol_table_t st, char *opcode, char *operands)
         }
         else
         {
-          fprintf(stderr, "Error: Only LSL, LSR, ASR shift supported for register arithmetic\n");
-          exit(1);
+          error_report("Error: Only LSL, LSR, ASR shift supported for register arithmetic\n");
+          error_fail();
         }
         ulong shift;
         operands = finish_parse_operand(parse_imm(operands + 5, &shift));
@@ -156,20 +202,19 @@ ulong encode_dp(symbol_table_t st, char *opcode, char *operands)
     instr = set_value(instr, r2, 5, 5);
     instr = set_value(instr, r3, 16, 5);
     instr = set_value(instr, logic_idx % 2, 21, 1); // negation bit
-    // 0b01010 for bit-logic
-    instr = set_value(instr, 0xa, 24, 5);
+    instr |= LOGIC_REG_MATCH;
     instr = set_value(instr, logic_idx / 2, 29, 2);
 
     if (r1_sp_used || r2_sp_used || r3_sp_used)
     {
-      fprintf(stderr, "Error: Cannot use SP as register in bit-logic\n");
-      exit(1);
+      error_report("Error: Cannot use SP as register in bit-logic\n");
+      error_fail();
     }
 
     if (r1_sf != r2_sf || r1_sf != r3_sf)
     {
-      fprintf(stderr, "Error: Register sizes must match in bit-logic\n");
-      exit(1);
+      error_report("Error: Register sizes must match in bit-logic\n");
+      error_fail();
     }
     instr = set_value(instr, r1_sf, 31, 1);
 
@@ -195,8 +240,8 @@ ulong encode_dp(symbol_table_t st, char *opcode, char *operands)
       }
       else
       {
-        fprintf(stderr, "Error: Unsupported shift type\n");
-        exit(1);
+        error_report("Error: Unsupported shift type\n");
+        error_fail();
       }
       operands = finish_parse_operand(parse_imm(operands + 5, &shift_imm));
       instr = set_value(instr, shift_imm, 10, 6);
@@ -206,7 +251,7 @@ ulong encode_dp(symbol_table_t st, char *opcode, char *operands)
   else if (index_of(opcode, movs) >= 0)
   {
     instr = set_value(instr, r1, 0, 5);
-    int mov_idx;
+    int mov_idx = 0;
     if (strcmp(opcode, "movn") == 0)
     {
       mov_idx = 0;
@@ -223,8 +268,7 @@ ulong encode_dp(symbol_table_t st, char *opcode, char *operands)
 
     if (operands[0] == '#')
     {
-      // 0b100101 for wide move
-      instr = set_value(instr, 0x25, 23, 6);
+      instr |= WIDE_MOVE_MATCH;
 
       ulong imm;
       operands = finish_parse_operand(parse_imm(operands + 1, &imm));
@@ -234,24 +278,24 @@ ulong encode_dp(symbol_table_t st, char *opcode, char *operands)
       {
         if (strncmp(operands, "lsl #", 5) != 0)
         {
-          fprintf(stderr, "Error: Only LSL shift supported for immediate mov\n");
-          exit(1);
+          error_report("Error: Only LSL shift supported for immediate mov\n");
+          error_fail();
         }
         ulong shift;
         operands = finish_parse_operand(parse_imm(operands + 5, &shift));
         ulong hw = shift / 16;
         if (!r1_sf && (hw != 0 && hw != 1))
         {
-          fprintf(stderr, "Error: Only LSL #0 or #16 supported for immediate mov on 32-bit registers\n");
-          exit(1);
+          error_report("Error: Only LSL #0 or #16 supported for immediate mov on 32-bit registers\n");
+          error_fail();
         }
         instr = set_value(instr, hw, 21, 2);
       }
 
       if (!r1_sp_used && r1 == MAX_REG)
       {
-        fprintf(stderr, "Error: Cannot use ZR as register in immediate mov\n");
-        exit(1);
+        error_report("Error: Cannot use ZR as register in immediate mov\n");
+        error_fail();
       }
       instr = set_value(instr, r1_sf, 31, 1);
     }
@@ -275,149 +319,337 @@ ulong encode_dp(symbol_table_t st, char *opcode, char *operands)
     instr = set_value(instr, r4, 10, 5);
     instr = set_value(instr, strcmp(opcode, "msub") == 0, 15, 1);
     instr = set_value(instr, r3, 16, 5);
-    instr = set_value(instr, 0xd8, 21, 10);
+    instr |= MULTIPLY_MATCH;
 
     if (r1_sp_used || r2_sp_used || r3_sp_used)
     {
-      fprintf(stderr, "Error: Cannot use SP as register in multiply\n");
-      exit(1);
+      error_report("Error: Cannot use SP as register in multiply\n");
+      error_fail();
     }
 
     if (r1_sf != r2_sf || r1_sf != r3_sf)
     {
-      fprintf(stderr, "Error: Register sizes must match in multiply\n");
-      exit(1);
+      error_report("Error: Register sizes must match in multiply\n");
+      error_fail();
     }
     instr = set_value(instr, r1_sf, 31, 1);
   }
   else
   {
-    fprintf(stderr, "Error: Unknown opcode\n");
-    exit(1);
+    error_report("Error: Unknown opcode\n");
+    error_fail();
   }
 
   if (operands[0] != '\0')
   {
-    fprintf(stderr, "Error: Extra operands after instruction\n");
-    exit(EXIT_FAILURE);
+    error_report("Error: Extra operands after instruction\n");
+    error_fail();
   }
   return instr;
 }
 
-ulong encode_sdt(symbol_table_t st, char *opcode, char *operands, long address)
+// LDP, LDPSW and STP: <rt>, <rt2>, then [<xn>{, #<simm>}], [<xn>, #<simm>]! or [<xn>], #<simm>,
+// with the offset a multiple of the access size
+static ulong encode_pair(char *opcode, char *operands)
 {
-  ulong instr = 0;
-  bool rt_sf, rt_sp_used, xn_sf, xn_sp_used, xm_sf, xm_sp_used;
-  ulong rt, xn, xm;
+  bool rt_sf, rt_sp_used, rt2_sf, rt2_sp_used, xn_sf, xn_sp_used;
+  ulong rt, rt2, xn;
   operands = finish_parse_operand(parse_register(operands, &rt, &rt_sf, &rt_sp_used));
-  bool is_literal = true;
-  ulong imm_value;
-  long simm_value;
-  ulong literal_value;
+  operands = finish_parse_operand(parse_register(operands, &rt2, &rt2_sf, &rt2_sp_used));
+  if (rt_sp_used || rt2_sp_used)
+  {
+    error_report("Error: Cannot use SP as transferred register in pair transfers\n");
+    error_fail();
+  }
+  if (rt_sf != rt2_sf)
+  {
+    error_report("Error: Register sizes must match in pair transfers\n");
+    error_fail();
+  }
+  if (operands[0] != '[')
+  {
+    error_report("Error: Expected [ before base register %s\n", operands);
+    error_fail();
+  }
+  operands = trim_left(parse_register(operands + 1, &xn, &xn_sf, &xn_sp_used));
+  if (!xn_sp_used && xn == MAX_REG)
+  {
+    error_report("Error: Cannot use ZR as base register\n");
+    error_fail();
+  }
 
+  ulong mode = PAIR_OFFSET;
+  long offset = 0;
+  bool has_offset = operands[0] == ',';
+  if (has_offset)
+  {
+    operands = finish_parse_operand(operands);
+    if (operands[0] != '#')
+    {
+      error_report("Error: Expected #offset in pair transfer %s\n", operands);
+      error_fail();
+    }
+    operands = trim_left(parse_simm(operands + 1, &offset));
+  }
+  if (operands[0] != ']')
+  {
+    error_report("Error: Missing ] after offset %s\n", operands);
+    error_fail();
+  }
+  operands = trim_left(operands + 1);
+  if (operands[0] == '!' && has_offset)
+  {
+    mode = PAIR_PRE;
+    operands = trim_left(operands + 1);
+  }
+  else if (operands[0] == ',' && !has_offset)
+  {
+    mode = PAIR_POST;
+    operands = finish_parse_operand(operands);
+    if (operands[0] != '#')
+    {
+      error_report("Error: Expected #offset in pair transfer %s\n", operands);
+      error_fail();
+    }
+    operands = trim_left(parse_simm(operands + 1, &offset));
+  }
+  if (operands[0] != '\0')
+  {
+    error_report("Error: Extra operands after instruction\n");
+    error_fail();
+  }
+
+  bool ldpsw = strcmp(opcode, "ldpsw") == 0;
+  if (ldpsw && !rt_sf)
+  {
+    error_report("Error: ldpsw loads into 64-bit registers\n");
+    error_fail();
+  }
+  long size = rt_sf && !ldpsw ? 8 : 4;
+  if (offset % size != 0 || offset / size < PAIR_IMM_MIN || offset / size > PAIR_IMM_MAX)
+  {
+    error_report("Error: Pair offset %ld is not a multiple of %ld within [%ld, %ld]\n", offset, size,
+                 PAIR_IMM_MIN * size, PAIR_IMM_MAX * size);
+    error_fail();
+  }
+  ulong instr = LOAD_STORE_PAIR_MATCH;
   instr = set_value(instr, rt, 0, 5);
+  instr = set_value(instr, xn, 5, 5);
+  instr = set_value(instr, rt2, 10, 5);
+  instr = set_value(instr, offset / size, 15, 7);
+  instr = set_value(instr, strcmp(opcode, "stp") != 0, 22, 1);
+  instr = set_value(instr, mode, 23, 2);
+  instr = set_value(instr, ldpsw ? PAIR_OPC_SIGNED : rt_sf ? 2 : 0, 30, 2);
+  return instr;
+}
 
-  if (operands[0] == '[')
+// Parses #<simm> of a load or store
+static char *parse_offset(char *operands, long *offset)
+{
+  if (operands[0] != '#')
   {
-    is_literal = false;
-    operands++;
-    operands = parse_register(operands, &xn, &xn_sf, &xn_sp_used);
+    error_report("Error: Expected #offset in load or store %s\n", operands);
+    error_fail();
+  }
+  return trim_left(parse_simm(operands + 1, offset));
+}
 
-    if (operands[0] == ']')
+// Parses the index register of a register offset, and its optional extension and shift, up to
+// the ], encoding them for an access of 1 << `size` bytes
+static char *parse_index(char *operands, ulong instr, int size, ulong *encoded)
+{
+  bool xm_sf, xm_sp_used;
+  ulong xm;
+  operands = trim_left(parse_register(operands, &xm, &xm_sf, &xm_sp_used));
+  if (xm_sp_used)
+  {
+    error_report("Error: Cannot use SP as index register\n");
+    error_fail();
+  }
+  ulong option = EXTEND_LSL;
+  long amount = 0;
+  bool has_amount = false;
+  if (operands[0] == ',')
+  {
+    operands = trim_left(operands + 1);
+    static const struct
     {
-      if (operands[1] == ',')
-      {
-        // post-indexed
-        instr = set_value(instr, 1, 10, 1);
-        operands++;
-        operands = finish_parse_operand(operands);
-        operands++;
-        parse_simm(operands, &simm_value);
-        instr = set_value(instr, simm_value, 12, 9);
-      }
-      else
-      {
-        // zero unsigned offset
-        instr = set_value(instr, 1, 24, 1);
-      }
+      const char *name;
+      ulong option;
+    } extends[] = {{"lsl", EXTEND_LSL}, {"uxtw", EXTEND_UXTW}, {"sxtw", EXTEND_SXTW}, {"sxtx", EXTEND_SXTX}};
+    size_t i = 0;
+    while (i < sizeof(extends) / sizeof(extends[0]) && strncmp(operands, extends[i].name, strlen(extends[i].name)) != 0)
+      i++;
+    if (i == sizeof(extends) / sizeof(extends[0]))
+    {
+      error_report("Error: Expected lsl, uxtw, sxtw or sxtx after index register %s\n", operands);
+      error_fail();
     }
-    else if (operands[0] == ',')
+    option = extends[i].option;
+    operands = trim_left(operands + strlen(extends[i].name));
+    has_amount = operands[0] == '#';
+    if (has_amount)
+      operands = parse_offset(operands, &amount);
+    else if (option == EXTEND_LSL)
     {
-      operands = finish_parse_operand(operands);
-      if (operands[0] != '#')
-      {
-        // register offset
-        instr = set_value(instr, 1, 21, 1);
-        instr = set_value(instr, 0xD, 11, 4);
-        operands = parse_register(operands, &xm, &xm_sf, &xm_sp_used);
-        instr = set_value(instr, xm, 16, 5);
-      }
-      else
-      {
-        int counter = 1;
-        for (char *temp = operands; *temp != ']'; temp++)
-        {
-          counter++;
-        }
-        if (operands[counter] == '!')
-        {
-          // pre-indexed
-          instr = set_value(instr, 0x3, 10, 2);
-          operands++;
-          parse_simm(operands, &simm_value);
-          instr = set_value(instr, simm_value, 12, 9);
-        }
-        else
-        {
-          // unsigned offset
-          instr = set_value(instr, 1, 24, 1);
-          operands++;
-          parse_imm(operands, &imm_value);
-          if (rt_sf)
-          {
-            instr = set_value(instr, (imm_value / 8), 10, 12);
-          }
-          else
-          {
-            instr = set_value(instr, (imm_value / 4), 10, 12);
-          }
-        }
-      }
+      error_report("Error: Expected #amount after lsl\n");
+      error_fail();
     }
   }
-  else
+  // W index registers are extended by UXTW or SXTW, X ones shifted by LSL or extended by SXTX
+  if (xm_sf != (option == EXTEND_LSL || option == EXTEND_SXTX))
+  {
+    error_report("Error: Index register size does not match its extension\n");
+    error_fail();
+  }
+  if (amount != 0 && amount != size)
+  {
+    error_report("Error: Index shift must be #0 or #%d\n", size);
+    error_fail();
+  }
+  instr = set_value(instr, 1, 21, 1);
+  instr = set_value(instr, xm, 16, 5);
+  instr = set_value(instr, option, 13, 3);
+  instr = set_value(instr, has_amount && amount == size, 12, 1);
+  *encoded = set_value(instr, INDEX_REGISTER, 10, 2);
+  return operands;
+}
+
+// LDR, LDRB, LDRH, LDRSB, LDRSH, LDRSW, STR, STRB, STRH and their unscaled LDUR and STUR forms:
+// <rt>, then a literal (LDR and LDRSW), [<xn>{, #<simm>}], [<xn>, #<simm>]!, [<xn>], #<simm> or
+// [<xn>, <index>{, <extend> {#<amount>}}]. An offset that the scaled unsigned immediate cannot
+// hold is encoded unscaled, like assemblers do.
+ulong encode_sdt(symbol_table_t st, char *opcode, char *operands, long address)
+{
+  if (strcmp(opcode, "ldp") == 0 || strcmp(opcode, "stp") == 0 || strcmp(opcode, "ldpsw") == 0)
+    return encode_pair(opcode, operands);
+
+  bool unscaled = strncmp(opcode, "ldur", 4) == 0 || strncmp(opcode, "stur", 4) == 0;
+  char name[8];
+  snprintf(name, sizeof(name), "%.2s%s", opcode, opcode + (unscaled ? 3 : 2));
+  size_t form = 0;
+  while (form < sizeof(sdt_forms) / sizeof(sdt_forms[0]) && strcmp(name, sdt_forms[form].name) != 0)
+    form++;
+  if (form == sizeof(sdt_forms) / sizeof(sdt_forms[0]))
   {
-    // load from literal
-    if (strcmp(opcode, "ldr") != 0)
+    error_report("Error: Unknown opcode\n");
+    error_fail();
+  }
+
+  bool rt_sf, rt_sp_used;
+  ulong rt;
+  operands = finish_parse_operand(parse_register(operands, &rt, &rt_sf, &rt_sp_used));
+  if (rt_sp_used)
+  {
+    error_report("Error: Cannot use SP as transferred register\n");
+    error_fail();
+  }
+  int size = sdt_forms[form].size >= 0 ? sdt_forms[form].size : rt_sf ? 3 : 2;
+  bool sign = sdt_forms[form].opc == SIGNED_OPC;
+  if ((sdt_forms[form].size >= 0 && !sign && rt_sf) || (size == 2 && sign && !rt_sf))
+  {
+    error_report("Error: Register size does not match %s\n", opcode);
+    error_fail();
+  }
+  ulong opc = sign ? (rt_sf ? 2 : 3) : sdt_forms[form].opc;
+
+  if (operands[0] != '[')
+  {
+    // Load from literal
+    if (unscaled || !(sign ? size == 2 : opc == 1 && size >= 2))
     {
-      fprintf(stderr, "Error: Literal is only available in load instructions.");
-      exit(1);
+      error_report("Error: Literal is only available in ldr and ldrsw\n");
+      error_fail();
     }
+    ulong literal_value;
     parse_literal(operands, &literal_value, st);
     long offset = (literal_value - address) / 4;
-    instr = set_value(instr, (offset), 5, 19);
+    ulong instr = set_value(LOAD_LITERAL_MATCH, rt, 0, 5);
+    instr = set_value(instr, offset, 5, 19);
+    return set_value(instr, sign ? LITERAL_OPC_LDRSW : rt_sf ? LITERAL_OPC_64 : LITERAL_OPC_32, 30, 2);
   }
 
-  if (rt_sf)
+  bool xn_sf, xn_sp_used;
+  ulong xn;
+  operands = trim_left(parse_register(operands + 1, &xn, &xn_sf, &xn_sp_used));
+  if (!xn_sp_used && xn == MAX_REG)
   {
-    instr = set_value(instr, 1, 30, 1);
+    error_report("Error: Cannot use ZR as base register\n");
+    error_fail();
   }
+  ulong instr = set_value(LOAD_STORE_MATCH, rt, 0, 5);
+  instr = set_value(instr, xn, 5, 5);
+  instr = set_value(instr, opc, 22, 2);
+  instr = set_value(instr, size, 30, 2);
 
-  instr = set_value(instr, 0x3, 27, 2);
-
-  if (!is_literal)
+  long offset = 0;
+  ulong index = INDEX_UNSCALED;
+  bool scaled = !unscaled;
+  if (operands[0] == ',')
   {
-    instr = set_value(instr, 1, 31, 1);
-    instr = set_value(instr, 1, 29, 1);
-    instr = set_value(instr, xn, 5, 5);
-
-    if (strcmp(opcode, "ldr") == 0)
+    operands = finish_parse_operand(operands);
+    if (operands[0] != '#')
+    {
+      operands = parse_index(operands, instr, size, &instr);
+      scaled = false;
+      index = INDEX_REGISTER;
+    }
+    else
+      operands = parse_offset(operands, &offset);
+    if (operands[0] != ']')
+    {
+      error_report("Error: Missing ] after offset %s\n", operands);
+      error_fail();
+    }
+    operands = trim_left(operands + 1);
+    if (operands[0] == '!' && index != INDEX_REGISTER)
+    {
+      index = INDEX_PRE;
+      scaled = false;
+      operands = trim_left(operands + 1);
+    }
+  }
+  else if (operands[0] == ']')
+  {
+    operands = trim_left(operands + 1);
+    if (operands[0] == ',')
     {
-      instr = set_value(instr, 1, 22, 1);
+      index = INDEX_POST;
+      scaled = false;
+      operands = parse_offset(finish_parse_operand(operands), &offset);
     }
   }
+  else
+  {
+    error_report("Error: Missing ] after base register %s\n", operands);
+    error_fail();
+  }
+  if (operands[0] != '\0')
+  {
+    error_report("Error: Extra operands after instruction\n");
+    error_fail();
+  }
+  if (unscaled && index != INDEX_UNSCALED)
+  {
+    error_report("Error: %s only takes an immediate offset\n", opcode);
+    error_fail();
+  }
+  if (index == INDEX_REGISTER)
+    return instr;
 
-  return instr;
+  // The scaled unsigned offset where it fits, else a signed 9-bit one
+  if (scaled && offset >= 0 && offset % (1 << size) == 0 && (offset >> size) <= UIMM12_MAX)
+  {
+    instr = set_value(instr, 1, 24, 1);
+    return set_value(instr, offset >> size, 10, 12);
+  }
+  if (offset < SIMM9_MIN || offset > SIMM9_MAX)
+  {
+    error_report("Error: Offset %ld out of range for %s\n", offset, opcode);
+    error_fail();
+  }
+  instr = set_value(instr, offset, 12, 9);
+  return set_value(instr, index, 10, 2);
 }
 
 ulong encode_branch(symbol_table_t st, char *opcode, char *operands, long address)
@@ -430,17 +662,31 @@ ulong encode_branch(symbol_table_t st, char *opcode, char *operands, long addres
     operands = finish_parse_operand(parse_literal(operands, &literal, st));
     long offset = literal - address;
     instr = set_value(instr, offset / 4, 0, 26);
-    instr = set_value(instr, 0x5, 26, 6); // opcode for unconditional branch
+    instr |= B_MATCH;
+  }
+  else if (strcmp(opcode, "bl") == 0)
+  {
+    ulong literal;
+    operands = finish_parse_operand(parse_literal(operands, &literal, st));
+    long offset = literal - address;
+    instr = set_value(BL_MATCH, offset / 4, 0, 26);
   }
-  else if (strcmp(opcode, "br") == 0)
+  else if (strcmp(opcode, "br") == 0 || strcmp(opcode, "blr") == 0)
   {
-    // br xn
+    // br xn, blr xn
     bool xn_sf, xn_sp_used;
     ulong xn;
     operands = finish_parse_operand(parse_register(operands, &xn, &xn_sf, &xn_sp_used));
-    instr = set_value(instr, 0x0, 0, 5);
-    instr = set_value(instr, xn, 5, 5);
-    instr = set_value(instr, 0x3587c0, 10, 22); // opcode for register branch
+    instr = set_value(strcmp(opcode, "br") == 0 ? BR_MATCH : BLR_MATCH, xn, 5, 5);
+  }
+  else if (strcmp(opcode, "ret") == 0)
+  {
+    // ret {xn}, returning through x30 by default
+    bool xn_sf, xn_sp_used;
+    ulong xn = LINK_REG;
+    if (operands[0] != '\0')
+      operands = finish_parse_operand(parse_register(operands, &xn, &xn_sf, &xn_sp_used));
+    instr = set_value(RET_MATCH, xn, 5, 5);
   }
   else
   {
@@ -450,7 +696,7 @@ ulong encode_branch(symbol_table_t st, char *opcode, char *operands, long addres
     ulong literal;
     operands = finish_parse_operand(parse_literal(operands, &literal, st));
     long offset = literal - address;
-    int cond_code;
+    int cond_code = 0;
     if (strcmp(condition, "eq") == 0)
       cond_code = 0x0;
     else if (strcmp(condition, "ne") == 0)
@@ -465,10 +711,8 @@ ulong encode_branch(symbol_table_t st, char *opcode, char *operands, long addres
       cond_code = 0xd;
     else if (strcmp(condition, "al") == 0)
       cond_code = 0xe;
-    instr = set_value(instr, cond_code, 0, 4);
-    instr = set_value(instr, 0x0, 4, 1);
+    instr = set_value(BCOND_MATCH, cond_code, 0, 4);
     instr = set_value(instr, offset / 4, 5, 19);
-    instr = set_value(instr, 0x54, 24, 8);
   }
 
   return instr;
@@ -493,52 +737,44 @@ ulong encode_conditionals(symbol_table_t st, char *opcode, char *operands)
   ulong rd, rn, rm;
   operands = finish_parse_operand(parse_register(operands, &rd, &rd_sf, &rd_sp_used));
   
-  instr = set_value(instr, rd, 0, 5);
-  instr = set_value(instr, 0xD4, 21, 8);
-  instr = set_value(instr, rd_sf, 31, 1);
-
   if (strcmp(opcode, "csel") == 0)
   {
-    operands = finish_parse_operand(parse_register(operands, &rn, &rn_sf, &rn_sp_used));
-    operands = finish_parse_operand(parse_register(operands, &rm, &rm_sf, &rm_sp_used));
-    instr = set_value(instr, rn, 5, 5);
-    instr = set_value(instr, rm, 16, 5);
+    instr = CSEL_MATCH;
   }
   else if (strcmp(opcode, "cset") == 0)
   {
-    instr = set_value(instr, 0x3F, 5, 6);
-    instr = set_value(instr, 0x1F, 16, 5);
+    instr = CSET_MATCH;
   }
   else if (strcmp(opcode, "csetm") == 0)
   {
-    instr = set_value(instr, 0x1F, 5, 5);
-    instr = set_value(instr, 0x1F, 16, 5);
-    instr = set_value(instr, 0x1, 30, 1);
+    instr = CSETM_MATCH;
   }
   else if (strcmp(opcode, "csinc") == 0)
   {
-    operands = finish_parse_operand(parse_register(operands, &rn, &rn_sf, &rn_sp_used));
-    operands = finish_parse_operand(parse_register(operands, &rm, &rm_sf, &rm_sp_used));
-    instr = set_value(instr, rn, 5, 5);
-    instr = set_value(instr, rm, 16, 5);
-    instr = set_value(instr, 0x1, 10, 1);
+    instr = CSINC_MATCH;
   }
   else if (strcmp(opcode, "csinv") == 0)
   {
-    operands = finish_parse_operand(parse_register(operands, &rn, &rn_sf, &rn_sp_used));
-    operands = finish_parse_operand(parse_register(operands, &rm, &rm_sf, &rm_sp_used));
-    instr = set_value(instr, rn, 5, 5);
-    instr = set_value(instr, rm, 16, 5);
-    instr = set_value(instr, 0x1, 30, 1);
+    instr = CSINV_MATCH;
   }
   else if (strcmp(opcode, "csneg") == 0)
+  {
+    instr = CSNEG_MATCH;
+  }
+  else
+  {
+    instr = COND_OTHER_MATCH;
+  }
+  instr = set_value(instr, rd, 0, 5);
+  instr = set_value(instr, rd_sf, 31, 1);
+
+  // cset and csetm have rn and rm fixed to ZR
+  if (strcmp(opcode, "cset") != 0 && strcmp(opcode, "csetm") != 0)
   {
     operands = finish_parse_operand(parse_register(operands, &rn, &rn_sf, &rn_sp_used));
     operands = finish_parse_operand(parse_register(operands, &rm, &rm_sf, &rm_sp_used));
     instr = set_value(instr, rn, 5, 5);
     instr = set_value(instr, rm, 16, 5);
-    instr = set_value(instr, 0x1, 30, 1);
-    instr = set_value(instr, 0x1, 10, 1);
   }
 
   unsigned int cond_code = 0;
@@ -564,9 +800,7 @@ ulong encode_conditionals(symbol_table_t st, char *opcode, char *operands)
 
 ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
 {
-  ulong instr = 0;
-  // 0bX0011110XX1 << 21 for floating-point
-  instr = set_value(instr, 0xf1, 21, 8);
+  ulong instr = FP_DP_MATCH;
   if (strcmp(opcode, "fmov") == 0)
   {
     bool rd_sf, rd_sp_used, rn_sf, rn_sp_used;
@@ -583,8 +817,8 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
       { // fp -> fp
         if (rd_ftype != rn_ftype)
         {
-          fprintf(stderr, "Error: SIMD register sizes must match in fmov\n");
-          exit(1);
+          error_report("Error: SIMD register sizes must match in fmov\n");
+          error_fail();
         }
         instr = set_value(instr, 1, 14, 1);
       }
@@ -592,8 +826,8 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
       { // int -> fp
         if (rn_sp_used)
         {
-          fprintf(stderr, "Error: SP cannot be used as register in fmov\n");
-          exit(1);
+          error_report("Error: SP cannot be used as register in fmov\n");
+          error_fail();
         }
         instr = set_value(instr, 7, 16, 3);
         instr = set_value(instr, rn_sf, 31, 1);
@@ -603,13 +837,13 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
     { // fp -> int
       if (rd_sp_used)
       {
-        fprintf(stderr, "Error: SP cannot be used as register in fmov\n");
-        exit(1);
+        error_report("Error: SP cannot be used as register in fmov\n");
+        error_fail();
       }
       if (rn_ftype < 0)
       {
-        fprintf(stderr, "Error: Unsupported SIMD register type for fmov %d\n", rn_ftype);
-        exit(1);
+        error_report("Error: Unsupported SIMD register type for fmov %d\n", rn_ftype);
+        error_fail();
       }
       instr = set_value(instr, rn, 5, 5);
       instr = set_value(instr, 6, 16, 3);
@@ -627,13 +861,13 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
     operands = finish_parse_operand(parse_reg_or_simd(operands, &rn, NULL, NULL, &rn_ftype));
     if (rd_ftype < 0 || rn_ftype < 0)
     {
-      fprintf(stderr, "Error: Invalid general register in fabs\n");
-      exit(1);
+      error_report("Error: Invalid general register in fabs\n");
+      error_fail();
     }
     if (rd_ftype != rn_ftype)
     {
-      fprintf(stderr, "Error: SIMD register sizes must match in fabs\n");
-      exit(1);
+      error_report("Error: SIMD register sizes must match in fabs\n");
+      error_fail();
     }
     instr = set_value(instr, rd, 0, 5);
     instr = set_value(instr, rn, 5, 5);
@@ -649,13 +883,13 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
     operands = finish_parse_operand(parse_reg_or_simd(operands, &rn, NULL, NULL, &rn_ftype));
     if (rd_ftype < 0 || rn_ftype < 0)
     {
-      fprintf(stderr, "Error: Invalid general register in fneg\n");
-      exit(1);
+      error_report("Error: Invalid general register in fneg\n");
+      error_fail();
     }
     if (rd_ftype != rn_ftype)
     {
-      fprintf(stderr, "Error: SIMD register sizes must match in fneg\n");
-      exit(1);
+      error_report("Error: SIMD register sizes must match in fneg\n");
+      error_fail();
     }
     instr = set_value(instr, rd, 0, 5);
     instr = set_value(instr, rn, 5, 5);
@@ -721,13 +955,13 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
     operands = finish_parse_operand(parse_reg_or_simd(operands, &rm, NULL, NULL, &rm_ftype));
     if (rd_ftype < 0 || rn_ftype < 0 || rm_ftype < 0)
     {
-      fprintf(stderr, "Error: Invalid general register in fmul\n");
-      exit(1);
+      error_report("Error: Invalid general register in fmul\n");
+      error_fail();
     }
     if (rd_ftype != rn_ftype || rd_ftype != rm_ftype)
     {
-      fprintf(stderr, "Error: SIMD register sizes must match in fmul\n");
-      exit(1);
+      error_report("Error: SIMD register sizes must match in fmul\n");
+      error_fail();
     }
     instr = set_value(instr, rd, 0, 5);
     instr = set_value(instr, rn, 5, 5);
@@ -745,13 +979,13 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
     operands = finish_parse_operand(parse_reg_or_simd(operands, &rm, NULL, NULL, &rm_ftype));
     if (rd_ftype < 0 || rn_ftype < 0 || rm_ftype < 0)
     {
-      fprintf(stderr, "Error: Invalid general register in fdiv\n");
-      exit(1);
+      error_report("Error: Invalid general register in fdiv\n");
+      error_fail();
     }
     if (rd_ftype != rn_ftype || rd_ftype != rm_ftype)
     {
-      fprintf(stderr, "Error: SIMD register sizes must match in fdiv\n");
-      exit(1);
+      error_report("Error: SIMD register sizes must match in fdiv\n");
+      error_fail();
     }
     instr = set_value(instr, rd, 0, 5);
     instr = set_value(instr, rn, 5, 5);
@@ -769,13 +1003,13 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
     operands = finish_parse_operand(parse_reg_or_simd(operands, &rm, NULL, NULL, &rm_ftype));
     if (rd_ftype < 0 || rn_ftype < 0 || rm_ftype < 0)
     {
-      fprintf(stderr, "Error: Invalid general register in fadd\n");
-      exit(1);
+      error_report("Error: Invalid general register in fadd\n");
+      error_fail();
     }
     if (rd_ftype != rn_ftype || rd_ftype != rm_ftype)
     {
-      fprintf(stderr, "Error: SIMD register sizes must match in fadd\n");
-      exit(1);
+      error_report("Error: SIMD register sizes must match in fadd\n");
+      error_fail();
     }
     instr = set_value(instr, rd, 0, 5);
     instr = set_value(instr, rn, 5, 5);
@@ -793,13 +1027,13 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
     operands = finish_parse_operand(parse_reg_or_simd(operands, &rm, NULL, NULL, &rm_ftype));
     if (rd_ftype < 0 || rn_ftype < 0 || rm_ftype < 0)
     {
-      fprintf(stderr, "Error: Invalid general register in fsub\n");
-      exit(1);
+      error_report("Error: Invalid general register in fsub\n");
+      error_fail();
     }
     if (rd_ftype != rn_ftype || rd_ftype != rm_ftype)
     {
-      fprintf(stderr, "Error: SIMD register sizes must match in fsub\n");
-      exit(1);
+      error_report("Error: SIMD register sizes must match in fsub\n");
+      error_fail();
     }
     instr = set_value(instr, rd, 0, 5);
     instr = set_value(instr, rn, 5, 5);
@@ -817,13 +1051,13 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
     operands = finish_parse_operand(parse_reg_or_simd(operands, &rm, NULL, NULL, &rm_ftype));
     if (rd_ftype < 0 || rn_ftype < 0 || rm_ftype < 0)
     {
-      fprintf(stderr, "Error: Invalid general register in fmax\n");
-      exit(1);
+      error_report("Error: Invalid general register in fmax\n");
+      error_fail();
     }
     if (rd_ftype != rn_ftype || rd_ftype != rm_ftype)
     {
-      fprintf(stderr, "Error: SIMD register sizes must match in fmax\n");
-      exit(1);
+      error_report("Error: SIMD register sizes must match in fmax\n");
+      error_fail();
     }
     instr = set_value(instr, rd, 0, 5);
     instr = set_value(instr, rn, 5, 5);
@@ -841,13 +1075,13 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
     operands = finish_parse_operand(parse_reg_or_simd(operands, &rm, NULL, NULL, &rm_ftype));
     if (rd_ftype < 0 || rn_ftype < 0 || rm_ftype < 0)
     {
-      fprintf(stderr, "Error: Invalid general register in fmin\n");
-      exit(1);
+      error_report("Error: Invalid general register in fmin\n");
+      error_fail();
     }
     if (rd_ftype != rn_ftype || rd_ftype != rm_ftype)
     {
-      fprintf(stderr, "Error: SIMD register sizes must match in fmin\n");
-      exit(1);
+      error_report("Error: SIMD register sizes must match in fmin\n");
+      error_fail();
     }
     instr = set_value(instr, rd, 0, 5);
     instr = set_value(instr, rn, 5, 5);
@@ -865,13 +1099,13 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
     operands = finish_parse_operand(parse_reg_or_simd(operands, &rm, NULL, NULL, &rm_ftype));
     if (rd_ftype < 0 || rn_ftype < 0 || rm_ftype < 0)
     {
-      fprintf(stderr, "Error: Invalid general register in fnmul\n");
-      exit(1);
+      error_report("Error: Invalid general register in fnmul\n");
+      error_fail();
     }
     if (rd_ftype != rn_ftype || rd_ftype != rm_ftype)
     {
-      fprintf(stderr, "Error: SIMD register sizes must match in fnmul\n");
-      exit(1);
+      error_report("Error: SIMD register sizes must match in fnmul\n");
+      error_fail();
     }
     instr = set_value(instr, rd, 0, 5);
     instr = set_value(instr, rn, 5, 5);
@@ -880,8 +1114,168 @@ ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands)
   }
   if (operands[0] != '\0')
   {
-    fprintf(stderr, "Error: Extra operands after instruction\n");
-    exit(EXIT_FAILURE);
+    error_report("Error: Extra operands after instruction\n");
+    error_fail();
   }
   return instr;
-}
\ No newline at end of file
+}
+// Parses the [xn] base address of an atomic access, which has no offset
+static char *parse_base(char *operands, ulong *xn)
+{
+  bool xn_sf, xn_sp_used;
+  if (operands[0] != '[')
+  {
+    error_report("Error: Expected [ before base register %s\n", operands);
+    error_fail();
+  }
+  operands = trim_left(parse_register(operands + 1, xn, &xn_sf, &xn_sp_used));
+  if (operands[0] != ']')
+  {
+    error_report("Error: Missing ] after base register %s\n", operands);
+    error_fail();
+  }
+  return finish_parse_operand(operands + 1);
+}
+
+// Sets the ordering bits of an "a", "l" or "al" mnemonic suffix
+static ulong set_ordering(ulong instr, const char *suffix, uint acquire_bit, uint release_bit)
+{
+  if (strcmp(suffix, "a") == 0 || strcmp(suffix, "al") == 0)
+    instr = set_value(instr, 1, acquire_bit, 1);
+  if (strcmp(suffix, "l") == 0 || strcmp(suffix, "al") == 0)
+    instr = set_value(instr, 1, release_bit, 1);
+  return instr;
+}
+
+ulong encode_atomic(symbol_table_t st, char *opcode, char *operands)
+{
+  ulong instr;
+  bool rs_sf, rt_sf, sp_used;
+  ulong rs = MAX_REG, rt, xn;
+  if (strcmp(opcode, "ldxr") == 0 || strcmp(opcode, "ldaxr") == 0)
+  {
+    // ld(a)xr rt, [xn]
+    instr = set_value(LDXR_MATCH, opcode[2] == 'a', 15, 1);
+  }
+  else if (strcmp(opcode, "stxr") == 0 || strcmp(opcode, "stlxr") == 0)
+  {
+    // st(l)xr ws, rt, [xn]
+    instr = set_value(STXR_MATCH, opcode[2] == 'l', 15, 1);
+    operands = finish_parse_operand(parse_register(operands, &rs, &rs_sf, &sp_used));
+  }
+  else if (strncmp(opcode, "ldadd", 5) == 0)
+  {
+    // ldadd{a,l,al} rs, rt, [xn]
+    instr = set_ordering(LDADD_MATCH, opcode + 5, 23, 22);
+    operands = finish_parse_operand(parse_register(operands, &rs, &rs_sf, &sp_used));
+  }
+  else
+  {
+    // cas{a,l,al} rs, rt, [xn]
+    instr = set_ordering(CAS_MATCH, opcode + 3, 22, 15);
+    operands = finish_parse_operand(parse_register(operands, &rs, &rs_sf, &sp_used));
+  }
+  operands = finish_parse_operand(parse_register(operands, &rt, &rt_sf, &sp_used));
+  parse_base(operands, &xn);
+
+  instr = set_value(instr, rt, 0, 5);
+  instr = set_value(instr, xn, 5, 5);
+  instr = set_value(instr, rs, 16, 5);
+  instr = set_value(instr, rt_sf, 30, 1);
+  return instr;
+}
+
+// DMB options, indexed by their CRm value. Reserved values have no name.
+char *barrier_options[] = {"", "oshld", "oshst", "osh", "", "nshld", "nshst", "nsh",
+                           "", "ishld", "ishst", "ish", "", "ld", "st", "sy", NULL};
+char *system_regs[] = {"mpidr_el1", "spsr_el1", "elr_el1", "vbar_el1", "icc_iar1_el1",
+                       "icc_eoir1_el1", "icc_igrpen1_el1", "daif", "cntfrq_el0", "cntvct_el0",
+                       "cntv_ctl_el0", "cntv_cval_el0", NULL};
+ulong system_reg_operands[] = {SYSREG_MPIDR_EL1, SYSREG_SPSR_EL1, SYSREG_ELR_EL1,
+                               SYSREG_VBAR_EL1, SYSREG_ICC_IAR1_EL1, SYSREG_ICC_EOIR1_EL1,
+                               SYSREG_ICC_IGRPEN1_EL1, SYSREG_DAIF, SYSREG_CNTFRQ_EL0,
+                               SYSREG_CNTVCT_EL0, SYSREG_CNTV_CTL_EL0, SYSREG_CNTV_CVAL_EL0};
+char *daif_fields[] = {"daifset", "daifclr", NULL};
+
+// Returns the MRS/MSR operand of the system register named `name`
+static ulong parse_system_reg(char *name)
+{
+  int reg = index_of(name, system_regs);
+  if (reg < 0)
+  {
+    error_report("Error: Unsupported system register %s\n", name);
+    error_fail();
+  }
+  return system_reg_operands[reg];
+}
+
+ulong encode_system(symbol_table_t st, char *opcode, char *operands)
+{
+  if (strcmp(opcode, "dmb") == 0)
+  {
+    // dmb <option>
+    operands[strcspn(operands, " \t\r\n")] = '\0';
+    int option = operands[0] != '\0' ? index_of(operands, barrier_options) : -1;
+    if (option < 0)
+    {
+      error_report("Error: Invalid barrier option %s\n", operands);
+      error_fail();
+    }
+    return set_value(DMB_MATCH, option, 8, 4);
+  }
+  if (strcmp(opcode, "hlt") == 0)
+  {
+    // hlt #imm16
+    operands[strcspn(operands, " \t\r\n")] = '\0';
+    ulong imm;
+    if (operands[0] != '#' || parse_imm(operands + 1, &imm)[0] != '\0' || imm > 0xFFFF)
+    {
+      error_report("Error: Invalid halt immediate %s\n", operands);
+      error_fail();
+    }
+    return set_value(HLT_MATCH, imm, 5, 16);
+  }
+
+  if (strcmp(opcode, "wfi") == 0)
+    return WFI_MATCH;
+  if (strcmp(opcode, "eret") == 0)
+    return ERET_MATCH;
+
+  bool rt_sf, rt_sp_used;
+  ulong rt;
+  if (strcmp(opcode, "msr") == 0)
+  {
+    // msr daifset|daifclr, #imm4 or msr <system register>, xt
+    char *name = operands;
+    operands = strchr(operands, ',');
+    if (operands == NULL)
+    {
+      error_report("Error: Missing operands %s\n", name);
+      error_fail();
+    }
+    *operands = '\0';
+    operands = trim_left(operands + 1);
+    name[strcspn(name, " \t")] = '\0';
+    int field = index_of(name, daif_fields);
+    if (field >= 0)
+    {
+      operands[strcspn(operands, " \t\r\n")] = '\0';
+      ulong imm;
+      if (operands[0] != '#' || parse_imm(operands + 1, &imm)[0] != '\0' || imm > 0xF)
+      {
+        error_report("Error: Invalid DAIF immediate %s\n", operands);
+        error_fail();
+      }
+      return set_value(set_value(MSR_DAIF_MATCH, imm, 8, 4), field, 5, 1);
+    }
+    ulong instr = set_value(MSR_MATCH, parse_system_reg(name), 5, 15);
+    parse_register(operands, &rt, &rt_sf, &rt_sp_used);
+    return set_value(instr, rt, 0, 5);
+  }
+
+  // mrs xt, <system register>
+  operands = finish_parse_operand(parse_register(operands, &rt, &rt_sf, &rt_sp_used));
+  operands[strcspn(operands, " \t\r\n")] = '\0';
+  ulong instr = set_value(MRS_MATCH, parse_system_reg(operands), 5, 15);
+  return set_value(instr, rt, 0, 5);
+}
@@ -9,4 +9,6 @@ extern ulong encode_sdt(symbol_table_t st, char *opcode, char *operands, long ad
 extern ulong encode_branch(symbol_table_t st, char *opcode, char *operands, long address);
 extern ulong encode_directives(symbol_table_t st, char *opcode, char *operands);
 extern ulong encode_conditionals(symbol_table_t st, char *opcode, char *operands);
-extern ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands);
\ No newline at end of file
+extern ulong encode_simd_fp(symbol_table_t st, char *opcode, char *operands);
+extern ulong encode_atomic(symbol_table_t st, char *opcode, char *operands);
+extern ulong encode_system(symbol_table_t st, char *opcode, char *operands);
\ No newline at end of file
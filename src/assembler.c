@@ -1,25 +1,34 @@
 #include <assert.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "assembler.h"
 #include "asm_encode.h"
+#include "error.h"
 #include "parse_utils.h"
 
 #define MAX_LINE_LENGTH 256
 #define INSTR_SIZE 4
+#define ALIAS_LENGTH (MAX_LINE_LENGTH + 8) // longest line and alias operands
 
 char *data_processing[] = {"add", "adds", "sub", "subs",
                            "and", "ands", "bic", "bics", "eor", "orr", "eon", "orn", "movk", "movn",
                            "movz", "madd", "msub", NULL};
 char *dp_aliases[] = {"cmp", "cmn", "neg", "negs", "tst", "mvn", "mov", "mul", "mneg", NULL};
-char *branching[] = {"b", "br", "b.eq", "b.ne", "b.ge", "b.lt", "b.gt", "b.le", "b.al", NULL};
-char *sdts[] = {"str", "ldr", NULL};
+char *branching[] = {"b", "bl", "br", "blr", "ret", "b.eq", "b.ne", "b.ge", "b.lt", "b.gt", "b.le", "b.al", NULL};
+char *sdts[] = {"str", "ldr", "strb", "ldrb", "ldrsb", "strh", "ldrh", "ldrsh", "ldrsw",
+                "stur", "ldur", "sturb", "ldurb", "ldursb", "sturh", "ldurh", "ldursh", "ldursw",
+                "stp", "ldp", "ldpsw", NULL};
 char *directives[] = {".int", NULL};
 char *conditional[] = {"csel", "cset", "csetm", "csinc", "csinv", "csneg", NULL};
 char *simd_fps[] = {"fmov", "fabs", "fneg", "fmin", "fmax", "fmul", "fdiv", "fadd", "fsub", "fnmul",
                     "fcmp", "fcvtzs", "scvtf", NULL};
+char *atomics[] = {"ldxr", "ldaxr", "stxr", "stlxr", "ldadd", "ldadda", "ldaddl", "ldaddal",
+                   "cas", "casa", "casl", "casal", NULL};
+char *systems[] = {"dmb", "eret", "hlt", "mrs", "msr", "wfi", NULL};
+char *no_operands[] = {"eret", "ret", "wfi", NULL};
 
 static bool instruction_type(const char *instr, char **array)
 {
@@ -33,32 +42,33 @@ static bool instruction_type(const char *instr, char **array)
   return false;
 }
 
-static char *prepend(const char *prefix, const char *str)
+// The operand rewrites of aliases are built in a caller buffer of ALIAS_LENGTH bytes, rather
+// than allocated, so nothing leaks when encoding fails (see error.h).
+static char *prepend(char *dest, const char *prefix, const char *str)
 {
-  char *result = malloc(strlen(prefix) + strlen(str) + 1);
-  strcpy(result, prefix);
-  strcat(result, str);
-  return result;
+  strcpy(dest, prefix);
+  strcat(dest, str);
+  return dest;
 }
 
-static char *append(const char *str, const char *suffix)
+static char *append(char *dest, const char *str, const char *suffix)
 {
-  char *result = malloc(strlen(str) + strlen(suffix) + 1);
-  strcpy(result, str);
-  strcat(result, suffix);
-  return result;
+  strcpy(dest, str);
+  strcat(dest, suffix);
+  return dest;
 }
 
-static char *split_and_add(const char *str, const char *middle)
+// Inserts `middle` after the first operand of `str`, before the operands after it
+static char *split_and_add(char *dest, const char *str, const char *middle)
 {
-  char *result = malloc(strlen(str) + strlen(middle) + 1);
-  char *final = malloc(strlen(str) + strlen(middle) + 1);
-  strcpy(result, str);
-  char *token = strtok(result, ",");
-  strcpy(final, token);
-  strcat(final, middle);
-  strcat(final, result);
-  return final;
+  const char *rest = strchr(str, ',');
+  size_t first_len = rest != NULL ? (size_t)(rest - str) : strlen(str);
+  memcpy(dest, str, first_len);
+  dest[first_len] = '\0';
+  strcat(dest, middle);
+  if (rest != NULL)
+    strcat(dest, rest + 1);
+  return dest;
 }
 
 static void parse_labels(symbol_table_t st, long *address, char *line)
@@ -85,36 +95,39 @@ static void parse_labels(symbol_table_t st, long *address, char *line)
   }
 }
 
-void first_pass(FILE *source_file, symbol_table_t st)
+// Reads the next line from memory with the same semantics as fgets.
+static bool read_line(char *buf, int size, const char **src, const char *end)
 {
-  char line_buf[MAX_LINE_LENGTH];
-  long address = 0;
-
-  while (fgets(line_buf, sizeof(line_buf), source_file))
-  {
-    parse_labels(st, &address, line_buf);
-  }
-
-  // handle the error in case the line cannot be read from the file
-  if (ferror(source_file))
+  if (*src >= end)
+    return false;
+  int len = 0;
+  while (*src < end && len < size - 1)
   {
-    fprintf(stderr, "Error reading from file\n");
-    exit(EXIT_FAILURE);
+    char c = *(*src)++;
+    buf[len++] = c;
+    if (c == '\n')
+      break;
   }
+  buf[len] = '\0';
+  return true;
 }
 
-static void write_binary(FILE *output_file, ulong instruction)
+long first_pass(const char *source, long length, symbol_table_t st)
 {
-  // don't use fwrite on entire instruction directly to avoid undefined
-  // behaviour due to different memory layouts on different systems.
-  for (int idx = 0; idx < INSTR_SIZE; idx++)
+  char line_buf[MAX_LINE_LENGTH];
+  const char *end = source + length;
+  long address = 0;
+
+  while (read_line(line_buf, sizeof(line_buf), &source, end))
   {
-    byte b = (instruction >> (idx * 8)) & 0xFF;
-    fwrite(&b, 1, 1, output_file);
+    parse_labels(st, &address, line_buf);
   }
+  return address;
 }
 
-static void parse_instruction(FILE *output_file, symbol_table_t st, char *line, long *address)
+// Encodes the instruction on a line (if any) at the given address.
+// Returns false if the line has no instruction (empty or labels only).
+static bool encode_line(symbol_table_t st, char *line, long address, ulong *binary)
 {
   char *label_end;
   while ((label_end = strchr(line, ':')) != NULL)
@@ -123,122 +136,138 @@ static void parse_instruction(FILE *output_file, symbol_table_t st, char *line,
   }
   line = trim_left(line);
   if (line[0] == '\0') // empty line
-    return;
+    return false;
 
   for (int idx = 0; line[idx] != '\0'; idx++)
   {
     line[idx] = tolower(line[idx]);
   }
   char *operands = strchr(line, ' ');
-  assert(operands != NULL); // all instructions have operands
-  operands[0] = '\0';       // split opcode and operands
-  operands = trim_left(operands + 1);
+  if (operands == NULL) // all instructions but those of no_operands have operands
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (!instruction_type(line, no_operands))
+    {
+      error_report("Error: Missing operands %s\n", line);
+      error_fail();
+    }
+    operands = line + strlen(line);
+  }
+  else
+  {
+    operands[0] = '\0'; // split opcode and operands
+    operands = trim_left(operands + 1);
+  }
   char *opcode = line;
 
-  ulong binary_instruction;
+  ulong binary_instruction = 0;
   if (instruction_type(opcode, dp_aliases))
   {
-    char *temp_str;
+    char temp_str[ALIAS_LENGTH];
     if (strcmp(opcode, "cmp") == 0)
     {
-      if (operands[0] == 'x')
+      if (operands[0] == 'x' || strncmp(operands, "sp", 2) == 0)
       {
-        binary_instruction = encode_dp(st, "subs", temp_str = prepend("xzr, ", operands));
+        binary_instruction = encode_dp(st, "subs", prepend(temp_str, "xzr, ", operands));
       }
       else
       {
-        binary_instruction = encode_dp(st, "subs", temp_str = prepend("wzr, ", operands));
+        binary_instruction = encode_dp(st, "subs", prepend(temp_str, "wzr, ", operands));
       }
     }
     else if (strcmp(opcode, "cmn") == 0)
     {
-      if (operands[0] == 'x')
+      if (operands[0] == 'x' || strncmp(operands, "sp", 2) == 0)
       {
-        binary_instruction = encode_dp(st, "adds", temp_str = prepend("xzr, ", operands));
+        binary_instruction = encode_dp(st, "adds", prepend(temp_str, "xzr, ", operands));
       }
       else
       {
-        binary_instruction = encode_dp(st, "adds", temp_str = prepend("wzr, ", operands));
+        binary_instruction = encode_dp(st, "adds", prepend(temp_str, "wzr, ", operands));
       }
     }
     else if (strcmp(opcode, "neg") == 0)
     {
       if (operands[0] == 'x')
       {
-        binary_instruction = encode_dp(st, "sub", temp_str = split_and_add(operands, ", xzr, "));
+        binary_instruction = encode_dp(st, "sub", split_and_add(temp_str, operands, ", xzr, "));
       }
       else
       {
-        binary_instruction = encode_dp(st, "sub", temp_str = split_and_add(operands, ", wzr, "));
+        binary_instruction = encode_dp(st, "sub", split_and_add(temp_str, operands, ", wzr, "));
       }
     }
     else if (strcmp(opcode, "negs") == 0)
     {
       if (operands[0] == 'x')
       {
-        binary_instruction = encode_dp(st, "subs", temp_str = split_and_add(operands, ", xzr, "));
+        binary_instruction = encode_dp(st, "subs", split_and_add(temp_str, operands, ", xzr, "));
       }
       else
       {
-        binary_instruction = encode_dp(st, "subs", temp_str = split_and_add(operands, ", wzr, "));
+        binary_instruction = encode_dp(st, "subs", split_and_add(temp_str, operands, ", wzr, "));
       }
     }
     else if (strcmp(opcode, "tst") == 0)
     {
       if (operands[0] == 'x')
       {
-        binary_instruction = encode_dp(st, "ands", temp_str = prepend("xzr, ", operands));
+        binary_instruction = encode_dp(st, "ands", prepend(temp_str, "xzr, ", operands));
       }
       else
       {
-        binary_instruction = encode_dp(st, "ands", temp_str = prepend("wzr, ", operands));
+        binary_instruction = encode_dp(st, "ands", prepend(temp_str, "wzr, ", operands));
       }
     }
     else if (strcmp(opcode, "mvn") == 0)
     {
       if (operands[0] == 'x')
       {
-        binary_instruction = encode_dp(st, "orn", temp_str = split_and_add(operands, ", xzr, "));
+        binary_instruction = encode_dp(st, "orn", split_and_add(temp_str, operands, ", xzr, "));
       }
       else
       {
-        binary_instruction = encode_dp(st, "orn", temp_str = split_and_add(operands, ", wzr, "));
+        binary_instruction = encode_dp(st, "orn", split_and_add(temp_str, operands, ", wzr, "));
       }
     }
     else if (strcmp(opcode, "mov") == 0)
     {
-      if (operands[0] == 'x')
+      // To or from SP is an ADD, as ORR reads and writes the zero register instead
+      if (strstr(operands, "sp") != NULL)
       {
-        binary_instruction = encode_dp(st, "orr", temp_str = split_and_add(operands, ", xzr, "));
+        binary_instruction = encode_dp(st, "add", append(temp_str, operands, ", #0"));
+      }
+      else if (operands[0] == 'x')
+      {
+        binary_instruction = encode_dp(st, "orr", split_and_add(temp_str, operands, ", xzr, "));
       }
       else
       {
-        binary_instruction = encode_dp(st, "orr", temp_str = split_and_add(operands, ", wzr, "));
+        binary_instruction = encode_dp(st, "orr", split_and_add(temp_str, operands, ", wzr, "));
       }
     }
     else if (strcmp(opcode, "mul") == 0)
     {
       if (operands[0] == 'x')
       {
-        binary_instruction = encode_dp(st, "madd", temp_str = append(operands, ", xzr"));
+        binary_instruction = encode_dp(st, "madd", append(temp_str, operands, ", xzr"));
       }
       else
       {
-        binary_instruction = encode_dp(st, "madd", temp_str = append(operands, ", wzr"));
+        binary_instruction = encode_dp(st, "madd", append(temp_str, operands, ", wzr"));
       }
     }
     else if (strcmp(opcode, "mneg") == 0)
     {
       if (operands[0] == 'x')
       {
-        binary_instruction = encode_dp(st, "msub", temp_str = append(operands, ", xzr"));
+        binary_instruction = encode_dp(st, "msub", append(temp_str, operands, ", xzr"));
       }
       else
       {
-        binary_instruction = encode_dp(st, "msub", temp_str = append(operands, ", wzr"));
+        binary_instruction = encode_dp(st, "msub", append(temp_str, operands, ", wzr"));
       }
     }
-    free(temp_str);
   }
   else if (instruction_type(opcode, data_processing))
   {
@@ -250,11 +279,11 @@ static void parse_instruction(FILE *output_file, symbol_table_t st, char *line,
   }
   else if (instruction_type(opcode, sdts))
   {
-    binary_instruction = encode_sdt(st, opcode, operands, *address);
+    binary_instruction = encode_sdt(st, opcode, operands, address);
   }
   else if (instruction_type(opcode, branching))
   {
-    binary_instruction = encode_branch(st, opcode, operands, *address);
+    binary_instruction = encode_branch(st, opcode, operands, address);
   }
   else if (instruction_type(opcode, directives))
   {
@@ -264,25 +293,209 @@ static void parse_instruction(FILE *output_file, symbol_table_t st, char *line,
   {
     binary_instruction = encode_simd_fp(st, opcode, operands);
   }
+  else if (instruction_type(opcode, atomics))
+  {
+    binary_instruction = encode_atomic(st, opcode, operands);
+  }
+  else if (instruction_type(opcode, systems))
+  {
+    binary_instruction = encode_system(st, opcode, operands);
+  }
   else
   {
-    fprintf(stderr, "Unknown opcode: %s\n", opcode);
-    exit(EXIT_FAILURE);
+    error_report("Unknown opcode: %s\n", opcode);
+    error_fail();
   }
-  *address += INSTR_SIZE;
-
-  write_binary(output_file, binary_instruction);
+  *binary = binary_instruction;
+  return true;
 }
 
-void second_pass(FILE *source_file, FILE *output_file, symbol_table_t st)
+void second_pass(const char *source, long length, long address, symbol_table_t st, buffer_t out)
 {
   char line_buf[MAX_LINE_LENGTH];
+  const char *end = source + length;
+  ulong binary_instruction;
+
+  while (read_line(line_buf, sizeof(line_buf), &source, end))
+  {
+    if (encode_line(st, line_buf, address, &binary_instruction))
+    {
+      buffer_append_word(out, binary_instruction);
+      address += INSTR_SIZE;
+    }
+  }
+}
+
+char *strip_comments(const char *source, long *length)
+{
+  char *stripped = malloc(*length + 1);
+  assert(stripped != NULL);
+
+  long i = 0, j = 0;
+  while (i < *length)
+  {
+    if (source[i] == '/' && i + 1 < *length && source[i + 1] == '/')
+    {
+      // Single-line comment found, skip until end of line
+      while (i < *length && source[i] != '\n')
+      {
+        i++;
+      }
+    }
+    else if (source[i] == '/' && i + 1 < *length && source[i + 1] == '*')
+    {
+      // Multi-line comment found, skip until closing */
+      i += 2;
+      while (i < *length && !(source[i] == '*' && i + 1 < *length && source[i + 1] == '/'))
+      {
+        i++;
+      }
+      if (i < *length)
+      {
+        i += 2;
+      }
+    }
+    else
+    {
+      // Copy non-comment content
+      stripped[j++] = source[i++];
+    }
+  }
+
+  stripped[j] = '\0';
+  *length = j;
+  return stripped;
+}
+
+void assemble_program(const char *source, long length, symbol_table_t st, buffer_t out)
+{
+  // The first pass gives the size of the output, so the buffer never grows
+  long size = first_pass(source, length, st);
+  buffer_reserve(out, size);
+  second_pass(source, length, 0, st, out);
+}
+
+void assemble_source(const char *source, long length, buffer_t out)
+{
+  char *stripped = strip_comments(source, &length);
+  symbol_table_t st = symbol_table_init();
+  assemble_program(stripped, length, st, out);
+  symbol_table_free(st);
+  free(stripped);
+}
+
+// A contiguous range of whole source lines, assembled by one thread.
+typedef struct
+{
+  const char *start;
+  long length;
+  symbol_table_t labels; // labels with addresses relative to the chunk
+  long size;             // bytes of output produced by the chunk
+  long base;             // address of the first instruction in the chunk
+  symbol_table_t st;     // complete symbol table, shared by all chunks
+  buffer_t out;          // encoded instructions of the chunk
+} chunk_t;
+
+static void *chunk_first_pass(void *arg)
+{
+  chunk_t *chunk = arg;
+  chunk->size = first_pass(chunk->start, chunk->length, chunk->labels);
+  return NULL;
+}
+
+static void *chunk_second_pass(void *arg)
+{
+  chunk_t *chunk = arg;
+  second_pass(chunk->start, chunk->length, chunk->base, chunk->st, chunk->out);
+  return NULL;
+}
+
+// Runs `pass` on every chunk, one thread per chunk.
+static void run_chunks(chunk_t *chunks, int num_chunks, void *(*pass)(void *))
+{
+  pthread_t *threads = malloc(num_chunks * sizeof(pthread_t));
+  assert(threads != NULL);
+  for (int i = 0; i < num_chunks; i++)
+  {
+    if (pthread_create(&threads[i], NULL, pass, &chunks[i]) != 0)
+    {
+      fprintf(stderr, "Error: Could not create assembler thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  for (int i = 0; i < num_chunks; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+}
+
+void parallel_assemble(const char *source, long length, buffer_t out, int num_threads)
+{
+  if (num_threads < 1)
+    num_threads = 1;
+  char *stripped = strip_comments(source, &length);
+  // Chunks split at line boundaries, so more threads than lines would only leave some empty
+  long lines = 0;
+  for (long i = 0; i < length; i++)
+  {
+    if (stripped[i] == '\n')
+      lines++;
+  }
+  if (length > 0 && stripped[length - 1] != '\n')
+    lines++;
+  if (num_threads > lines)
+    num_threads = lines > 0 ? lines : 1;
+  chunk_t *chunks = calloc(num_threads, sizeof(chunk_t));
+  assert(chunks != NULL);
+
+  // Split the source into roughly equal chunks at line boundaries
+  const char *end = stripped + length;
+  const char *start = stripped;
+  for (int i = 0; i < num_threads; i++)
+  {
+    const char *split = stripped + length * (i + 1) / num_threads;
+    if (split < start)
+      split = start;
+    while (split > stripped && split < end && split[-1] != '\n')
+      split++;
+    chunks[i].start = start;
+    chunks[i].length = split - start;
+    chunks[i].labels = symbol_table_init();
+    start = split;
+  }
+
+  // First pass: collect labels relative to each chunk in parallel
+  run_chunks(chunks, num_threads, chunk_first_pass);
+
+  // Resolve chunk base addresses with a prefix sum over the chunk sizes, then
+  // merge labels in source order so duplicate labels resolve as in first_pass.
+  symbol_table_t st = symbol_table_init();
   long address = 0;
+  for (int i = 0; i < num_threads; i++)
+  {
+    chunks[i].base = address;
+    chunks[i].st = st;
+    chunks[i].out = buffer_init(chunks[i].size);
+    symbol_table_t labels = chunks[i].labels;
+    for (int j = 0; j < labels->len; j++)
+    {
+      symbol_table_append(st, labels->elements[j].label, address + labels->elements[j].address);
+    }
+    address += chunks[i].size;
+  }
+
+  // Second pass: every label is known now, so chunks encode independently
+  run_chunks(chunks, num_threads, chunk_second_pass);
 
-  while (fgets(line_buf, sizeof(line_buf), source_file))
+  buffer_reserve(out, address);
+  for (int i = 0; i < num_threads; i++)
   {
-    if (line_buf[0] == '\0') // empty line
-      continue;
-    parse_instruction(output_file, st, line_buf, &address);
+    buffer_append(out, chunks[i].out->data, chunks[i].out->len);
+    buffer_free(chunks[i].out);
+    symbol_table_free(chunks[i].labels);
   }
+  symbol_table_free(st);
+  free(chunks);
+  free(stripped);
 }
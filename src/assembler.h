@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdbool.h>
 #include "symbol_table.h"
+#include "buffer.h"
 
 typedef unsigned char byte;
 typedef unsigned long ulong;
@@ -12,5 +13,17 @@ typedef struct
     char *operands;
 } instr_t;
 
-extern void first_pass(FILE *fin, symbol_table_t symbol_table);
-extern void second_pass(FILE *fin, FILE *fout, symbol_table_t symbol_table);
\ No newline at end of file
+// Collects the labels in `length` bytes of (comment free) source.
+// Returns the number of bytes the source assembles to.
+extern long first_pass(const char *source, long length, symbol_table_t symbol_table);
+// Encodes the instructions in the source, starting at `address`, into `out`.
+extern void second_pass(const char *source, long length, long address, symbol_table_t symbol_table, buffer_t out);
+// Returns a copy of the source without comments, updating `length`.
+extern char *strip_comments(const char *source, long *length);
+// Assembles a complete (comment free) program with both passes, collecting its labels in `st`.
+extern void assemble_program(const char *source, long length, symbol_table_t st, buffer_t out);
+// Assembles a complete program in memory, appending the binary to `out`.
+extern void assemble_source(const char *source, long length, buffer_t out);
+// Assembles a complete program like assemble_source, using `num_threads`
+// threads to process chunks of the source in parallel.
+extern void parallel_assemble(const char *source, long length, buffer_t out, int num_threads);
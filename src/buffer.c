@@ -0,0 +1,60 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "buffer.h"
+
+#define INIT_CAP 64
+#define WORD_SIZE 4
+
+buffer_t buffer_init(size_t cap)
+{
+  buffer_t buf = malloc(sizeof(struct buffer_t));
+  assert(buf != NULL);
+  if (cap < INIT_CAP)
+    cap = INIT_CAP;
+  buf->data = malloc(cap);
+  assert(buf->data != NULL);
+  buf->cap = cap;
+  buf->len = 0;
+  return buf;
+}
+
+void buffer_free(buffer_t buf)
+{
+  free(buf->data);
+  free(buf);
+}
+
+void buffer_reserve(buffer_t buf, size_t extra)
+{
+  if (buf->len + extra <= buf->cap)
+    return; // Only grow if full.
+  while (buf->len + extra > buf->cap)
+  {
+    buf->cap <<= 1;
+  }
+  buf->data = realloc(buf->data, buf->cap);
+  assert(buf->data != NULL);
+}
+
+void buffer_append(buffer_t buf, const void *data, size_t len)
+{
+  buffer_reserve(buf, len);
+  memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+}
+
+void buffer_append_word(buffer_t buf, ulong word)
+{
+  buffer_reserve(buf, WORD_SIZE);
+  // don't copy the word directly to avoid depending on host byte order.
+  for (int idx = 0; idx < WORD_SIZE; idx++)
+  {
+    buf->data[buf->len++] = (word >> (idx * 8)) & 0xFF;
+  }
+}
+
+bool buffer_write(buffer_t buf, FILE *stream)
+{
+  return fwrite(buf->data, 1, buf->len, stream) == buf->len;
+}
@@ -0,0 +1,32 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#ifndef BUFFER_H
+#define BUFFER_H
+
+typedef unsigned char byte;
+typedef unsigned long ulong;
+
+struct buffer_t
+{
+    byte *data;
+    size_t len;
+    size_t cap;
+};
+// Growable Byte Buffer ADT
+typedef struct buffer_t *buffer_t;
+
+// Allocates and initialises a new buffer with space for `cap` bytes.
+extern buffer_t buffer_init(size_t cap);
+// Frees the memory allocated for a buffer.
+extern void buffer_free(buffer_t buf);
+// Ensures the buffer has space for at least `extra` more bytes.
+extern void buffer_reserve(buffer_t buf, size_t extra);
+// Appends `len` bytes to the buffer.
+extern void buffer_append(buffer_t buf, const void *data, size_t len);
+// Appends a 32-bit word to the buffer in little-endian byte order.
+extern void buffer_append_word(buffer_t buf, ulong word);
+// Writes the buffer contents to a file at once. Returns false on failure.
+extern bool buffer_write(buffer_t buf, FILE *stream);
+#endif
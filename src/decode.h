@@ -0,0 +1,90 @@
+#include <stdbool.h>
+#include "emulator.h"
+#include "isa.h"
+
+#ifndef DECODE_H
+#define DECODE_H
+
+typedef struct decoded decoded_t;
+// Handler executing a decoded instruction, including the PC update.
+typedef void (*exec_fn)(emulstate state, const decoded_t *d);
+// Decoder of the instructions of isa.def entry `op`, setting d->exec.
+// Returns false if the instruction is unknown.
+typedef bool (*decode_fn)(ulong raw, decoded_t *d, isa_op op);
+// Fuser of a decoded instruction of entry `op` with the next decoded entry d[1], of entry
+// `next_op`. Replaces d->exec with a handler executing both, and sets d->insns to 2, if the
+// pair has one.
+typedef void (*fuse_fn)(decoded_t *d, isa_op op, isa_op next_op);
+
+// An instruction decoded once, with the handler specialised for its operation and width.
+struct decoded
+{
+  exec_fn exec; // NULL if the word has not been decoded yet
+  ullong imm;
+  uint raw;
+  byte rd, rn, rm, ra;
+  byte shift; // shift amount
+  byte stype; // shift type
+  byte cond;
+  byte insns; // guest instructions executed by exec, 0 until fusion was considered
+};
+
+// Decodes `raw` as emulstep() does, without fusion, setting `op` to its isa.def entry (ISA_OPS
+// if there is none). Returns false if the instruction is unknown.
+extern bool decode_raw(ulong raw, decoded_t *d, isa_op *op);
+
+// Register access for specialised handlers. Register numbers are validated at decode
+// time, and reading register 31 gives the zero register.
+#define W64(value) ((ullong)(value))
+#define W32(value) ((ullong)(value) & 0xFFFFFFFF)
+#define MSB64(value) (((value) >> 63) & 1)
+#define MSB32(value) (((value) >> 31) & 1)
+#define REG(state, width, rg) W##width((state)->regs[rg])
+// Writes to the zero register are dropped by selecting the ZR variant of a handler.
+#define SET_RD(state, d, value) ((state)->regs[(d)->rd] = (value))
+#define SET_ZR(state, d, value) ((void)(value))
+
+// Defines the 32/64-bit variants of a handler, each writing either rd or the zero register.
+#define DEFINE_VARIANTS(DEFINE, name, arg) \
+  DEFINE(name, 32, RD, arg)                \
+  DEFINE(name, 32, ZR, arg)                \
+  DEFINE(name, 64, RD, arg)                \
+  DEFINE(name, 64, ZR, arg)
+// Initialiser for a table of handler variants, indexed by [sf][rd == ZR].
+#define VARIANTS(name)                  \
+  {                                     \
+    {name##_32_RD, name##_32_ZR},       \
+    {name##_64_RD, name##_64_ZR}        \
+  }
+
+// PC updates of handlers: to the next instruction, past a fused pair, or the B.cond fused
+// after a flag-setting instruction, whose condition and offset are in the next entry d[1].
+#define PC_NEXT(state, d) ((state)->pc += INSTR_SIZE)
+#define PC_PAIR(state, d) ((state)->pc += 2 * INSTR_SIZE)
+#define PC_BCOND(state, d)                                     \
+  ((state)->pc += cond_holds(&(state)->pstate, (d)[1].cond)     \
+                      ? INSTR_SIZE + (d)[1].imm                 \
+                      : 2 * INSTR_SIZE)
+
+// Evaluates a condition code (validated at decode time) against PSTATE.
+static inline bool cond_holds(const pstate_t *pstate, byte cond)
+{
+  switch (cond)
+  {
+  case 0x0: // EQ
+    return pstate->zero;
+  case 0x1: // NE
+    return !pstate->zero;
+  case 0xA: // GE
+    return pstate->negative == pstate->overflow;
+  case 0xB: // LT
+    return pstate->negative != pstate->overflow;
+  case 0xC: // GT
+    return !pstate->zero && pstate->negative == pstate->overflow;
+  case 0xD: // LE
+    return !(!pstate->zero && pstate->negative == pstate->overflow);
+  default: // AL
+    return true;
+  }
+}
+#endif
@@ -0,0 +1,239 @@
+#include <elf.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "elf_loader.h"
+#include "error.h"
+
+typedef struct
+{
+  ulong address;
+  const char *name;
+} symbol_t;
+
+struct symbols
+{
+  symbol_t *entries; // by address
+  size_t count;
+  char *names;       // the string table the names point into
+};
+
+// An ELF file mapped for reading
+typedef struct
+{
+  const char *path;
+  int fd;
+  const byte *data; // NULL until mapped
+  size_t size;
+  symbols_t symbols; // read so far, NULL before
+} elf_file_t;
+
+// Unmaps and closes the file
+static void release_file(const elf_file_t *file)
+{
+  if (file->data != NULL)
+    munmap((void *)file->data, file->size);
+  if (file->fd >= 0)
+    close(file->fd);
+}
+
+// Fails after a message was reported, releasing the file and the symbols read, so that a
+// caller recovering from the error (see error.h) leaks neither
+static _Noreturn void fail(const elf_file_t *file)
+{
+  if (file->symbols != NULL)
+    symbols_free(file->symbols);
+  release_file(file);
+  error_fail();
+}
+
+// Fails with a message about the file
+static _Noreturn void invalid(const elf_file_t *file, const char *problem)
+{
+  error_report("Error: Invalid ELF file %s: %s\n", file->path, problem);
+  fail(file);
+}
+
+// Returns the `count` entries of `entsize` bytes at `offset`, failing unless they are in the file
+static const byte *file_range(const elf_file_t *file, ullong offset, ullong count, ullong entsize)
+{
+  if (offset > file->size || (entsize != 0 && count > (file->size - offset) / entsize))
+    invalid(file, "truncated");
+  return file->data + offset;
+}
+
+bool elf_is_elf(const byte *header, size_t len)
+{
+  return len >= ELF_MAGIC_LEN && memcmp(header, ELF_MAGIC, ELF_MAGIC_LEN) == 0;
+}
+
+static const Elf64_Ehdr *check_header(const elf_file_t *file)
+{
+  const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)file_range(file, 0, 1, sizeof(Elf64_Ehdr));
+  if (!elf_is_elf(file->data, file->size) || ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+      ehdr->e_ident[EI_DATA] != ELFDATA2LSB)
+    invalid(file, "not a little-endian ELF64 file");
+  if (ehdr->e_machine != EM_AARCH64 || (ehdr->e_type != ET_EXEC && ehdr->e_type != ET_DYN))
+    invalid(file, "not an AArch64 executable");
+  if (ehdr->e_phnum > 0 && ehdr->e_phentsize != sizeof(Elf64_Phdr))
+    invalid(file, "unexpected program header size");
+  if (ehdr->e_shnum > 0 && ehdr->e_shentsize != sizeof(Elf64_Shdr))
+    invalid(file, "unexpected section header size");
+  return ehdr;
+}
+
+// Copies or maps the file contents of a segment into memory
+static void load_segment(emulstate state, const elf_file_t *file, const Elf64_Phdr *ph)
+{
+  if (ph->p_filesz > ph->p_memsz || ph->p_vaddr > MAX_MEMORY || ph->p_memsz > MAX_MEMORY - ph->p_vaddr)
+  {
+    error_report("Error: Segment at 0x%llx of %s does not fit in memory\n",
+                 (ullong)ph->p_vaddr, file->path);
+    fail(file);
+  }
+  const byte *contents = file_range(file, ph->p_offset, ph->p_filesz, 1);
+  ulong start = ph->p_vaddr;
+  ulong end = ph->p_vaddr + ph->p_filesz;
+
+  // Whole pages are mapped where file offsets and addresses agree within a page
+  ulong page = sysconf(_SC_PAGESIZE);
+  ulong first = (start + page - 1) / page * page;
+  ulong last = end / page * page;
+  if ((ph->p_vaddr - ph->p_offset) % page != 0 || first >= last ||
+      mmap(state->memory + first, last - first, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+           file->fd, ph->p_offset + (first - start)) == MAP_FAILED)
+  {
+    first = last = end;
+  }
+  memcpy(state->memory + start, contents, first - start);
+  memcpy(state->memory + last, contents + (last - start), end - last);
+  invalidate_decoded(state, start, ph->p_filesz);
+}
+
+static int compare_symbols(const void *a, const void *b)
+{
+  const symbol_t *sa = a, *sb = b;
+  return (sa->address > sb->address) - (sa->address < sb->address);
+}
+
+// Reads the functions, objects and labels of the symbol table, without the mapping symbols
+// ($x, $d) that mark code and data
+static symbols_t read_symbols(elf_file_t *file, const Elf64_Ehdr *ehdr)
+{
+  symbols_t symbols = calloc(1, sizeof(struct symbols));
+  if (symbols == NULL)
+  {
+    fprintf(stderr, "Error: Could not allocate symbol table\n");
+    exit(1);
+  }
+  file->symbols = symbols;
+  if (ehdr->e_shnum == 0)
+    return symbols;
+  const Elf64_Shdr *shdrs = (const Elf64_Shdr *)file_range(file, ehdr->e_shoff, ehdr->e_shnum, sizeof(Elf64_Shdr));
+  for (int i = 0; i < ehdr->e_shnum; i++)
+  {
+    if (shdrs[i].sh_type != SHT_SYMTAB || shdrs[i].sh_link >= ehdr->e_shnum)
+      continue;
+    const Elf64_Shdr *strtab = &shdrs[shdrs[i].sh_link];
+    size_t count = shdrs[i].sh_size / sizeof(Elf64_Sym);
+    if (count == 0)
+      break;
+    const Elf64_Sym *syms = (const Elf64_Sym *)file_range(file, shdrs[i].sh_offset, count, sizeof(Elf64_Sym));
+    const char *strings = (const char *)file_range(file, strtab->sh_offset, strtab->sh_size, 1);
+    if (strtab->sh_size == 0 || strings[strtab->sh_size - 1] != '\0')
+      invalid(file, "unterminated string table");
+    symbols->names = malloc(strtab->sh_size);
+    symbols->entries = malloc(count * sizeof(symbol_t));
+    if (symbols->names == NULL || symbols->entries == NULL)
+    {
+      fprintf(stderr, "Error: Could not allocate symbol table\n");
+      exit(1);
+    }
+    memcpy(symbols->names, strings, strtab->sh_size);
+    for (size_t s = 0; s < count; s++)
+    {
+      int type = ELF64_ST_TYPE(syms[s].st_info);
+      const char *name = symbols->names + (syms[s].st_name < strtab->sh_size ? syms[s].st_name : 0);
+      if ((type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE) ||
+          syms[s].st_shndx == SHN_UNDEF || name[0] == '\0' || name[0] == '$')
+        continue;
+      symbols->entries[symbols->count++] = (symbol_t){syms[s].st_value, name};
+    }
+    qsort(symbols->entries, symbols->count, sizeof(symbol_t), compare_symbols);
+    break;
+  }
+  return symbols;
+}
+
+symbols_t elf_load(emulstate state, const char *path)
+{
+  elf_file_t file = {path, open(path, O_RDONLY), NULL, 0, NULL};
+  struct stat st;
+  if (file.fd < 0 || fstat(file.fd, &st) != 0)
+  {
+    error_report("Error: Could not open file %s\n", path);
+    fail(&file);
+  }
+  file.size = st.st_size;
+  const byte *data = file.size > 0 ? mmap(NULL, file.size, PROT_READ, MAP_PRIVATE, file.fd, 0) : MAP_FAILED;
+  if (data == MAP_FAILED)
+  {
+    error_report("Error: Could not read file %s\n", path);
+    fail(&file);
+  }
+  file.data = data;
+
+  const Elf64_Ehdr *ehdr = check_header(&file);
+  const Elf64_Phdr *phdrs = (const Elf64_Phdr *)file_range(&file, ehdr->e_phoff, ehdr->e_phnum, sizeof(Elf64_Phdr));
+  for (int i = 0; i < ehdr->e_phnum; i++)
+  {
+    if (phdrs[i].p_type == PT_LOAD && phdrs[i].p_memsz > 0)
+      load_segment(state, &file, &phdrs[i]);
+  }
+  state->pc = ehdr->e_entry;
+  symbols_t symbols = read_symbols(&file, ehdr);
+
+  // Mapped segments stay mapped without the file
+  release_file(&file);
+  return symbols;
+}
+
+void symbols_free(symbols_t symbols)
+{
+  free(symbols->entries);
+  free(symbols->names);
+  free(symbols);
+}
+
+size_t symbols_count(symbols_t symbols)
+{
+  return symbols->count;
+}
+
+long symbols_find(symbols_t symbols, ulong address)
+{
+  // The last symbol at or below the address
+  long low = 0, high = symbols->count;
+  while (low < high)
+  {
+    long mid = (low + high) / 2;
+    if (symbols->entries[mid].address <= address)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low - 1;
+}
+
+const char *symbols_name(symbols_t symbols, long idx)
+{
+  return symbols->entries[idx].name;
+}
+
+ulong symbols_address(symbols_t symbols, long idx)
+{
+  return symbols->entries[idx].address;
+}
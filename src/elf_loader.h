@@ -0,0 +1,34 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include "emulator.h"
+
+#ifndef ELF_LOADER_H
+#define ELF_LOADER_H
+
+// Loader of AArch64 ELF64 executables, as linked by aarch64-none-elf toolchains, so that they
+// run without being converted to flat images first.
+//
+// PT_LOAD segments go at their virtual addresses, which must be in memory. The pages of a
+// segment that are whole pages of the file are mapped from it copy-on-write, rather than read,
+// and only the partial pages at its ends are copied. The BSS is left to the memory, which is
+// zero until touched. The symbol table, if any, is read for symbolizing addresses in profiles
+// and traces.
+
+#define ELF_MAGIC "\x7f" "ELF"
+#define ELF_MAGIC_LEN 4
+
+// Symbol table ADT
+typedef struct symbols *symbols_t;
+
+// Returns true if the `len` bytes of `header` start an ELF file.
+extern bool elf_is_elf(const byte *header, size_t len);
+// Loads the executable at `path` into the memory of `state`, and sets the PC to its entry
+// point. Returns its symbols, which may be empty. Invalid files are errors (see error.h).
+extern symbols_t elf_load(emulstate state, const char *path);
+extern void symbols_free(symbols_t symbols);
+extern size_t symbols_count(symbols_t symbols);
+// Returns the index of the symbol nearest below `address`, or -1 if there is none.
+extern long symbols_find(symbols_t symbols, ulong address);
+extern const char *symbols_name(symbols_t symbols, long idx);
+extern ulong symbols_address(symbols_t symbols, long idx);
+#endif
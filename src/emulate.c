@@ -1,60 +1,287 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "emulator.h"
 #include "emulate.h"
+#include "interrupt.h"
+#include "perf_stats.h"
+#include "scheduler.h"
+#include "semihost.h"
+#include "uart.h"
+#include "elf_loader.h"
+
+#define MAX_CORES 255          // numbered in 8 bits of MPIDR_EL1
+#define CORE_SLICE 1000000     // instructions a core runs between checks of the scheduler
+#define WATCHDOG_SLICE 1000000 // instructions run between reads of the clock for --max-time
+#define EXIT_BUDGET 2          // a budget ran out before the program halted
+
+// The machine, so that the output of a program that fails is still written
+static emulstate machine = NULL;
+
+static void flush_output(void)
+{
+  if (machine == NULL)
+    return;
+  semihost_flush(machine);
+  if (machine->uart != NULL)
+    uart_flush(machine->uart);
+}
+
+static double now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Runs the program until it halts, or until it ran `max_insns` instructions or `max_ms`
+// milliseconds (0 for no limit). The clock is read every WATCHDOG_SLICE instructions.
+// Returns the name of the budget that ran out, or NULL if the program halted.
+static const char *run_program(emulstate state, perf_stats_t stats, symbols_t symbols,
+                               FILE *fout, ullong max_insns, ullong max_ms)
+{
+  char buf[100];
+  bool debug = getenv("ARMV8_DEBUG") != NULL;
+  double deadline = now_ms() + max_ms;
+  set_insn_limit(state, max_insns);
+  bool running = true;
+  while (running)
+  {
+    if (state->insns >= max_insns)
+      return "instruction";
+    if (max_ms > 0 && now_ms() >= deadline)
+      return "time";
+    ullong check = max_insns - state->insns > WATCHDOG_SLICE ? state->insns + WATCHDOG_SLICE : max_insns;
+    if (stats == NULL && !debug)
+    {
+      running = emulrun(state, check);
+      continue;
+    }
+    // With --perf-stats, or ARMV8_DEBUG set, one step at a time
+    while (running && state->insns < check)
+    {
+      running = stats != NULL ? perf_stats_step(stats, state) : emulstep(state);
+      // Useful for debugging Part 3
+      if (debug && running)
+      {
+        long sym = symbols != NULL ? symbols_find(symbols, state->pc) : -1;
+        if (sym >= 0)
+          fprintf(fout, "At %s+0x%llx\n", symbols_name(symbols, sym), state->pc - symbols_address(symbols, sym));
+        fprint_emulstate(fout, state);
+        fgets(buf, 100, stdin);
+      }
+    }
+  }
+  return NULL;
+}
+
+// Runs `count` cores of the machine of `state` from its PC, each on its own thread, until
+// all of them halted, or `max_insns` instructions ran in total or `max_ms` milliseconds passed
+// (0 for no limit), storing the instructions run in `insns`. The clock is read between slices
+// of CORE_SLICE instructions. Exits if a core fails. Returns the name of the budget that ran
+// out, or NULL if the cores halted.
+static const char *run_cores(emulstate state, int count, ullong max_insns, ullong max_ms,
+                             ullong *insns)
+{
+  double deadline = now_ms() + max_ms;
+  emulstate *cores = malloc(count * sizeof(emulstate));
+  scheduler_t sched = scheduler_init(CORE_SLICE);
+  cores[0] = state;
+  scheduler_add(sched, state);
+  for (int i = 1; i < count; i++)
+  {
+    cores[i] = emulstate_init_core(state, i);
+    cores[i]->pc = state->pc;
+    scheduler_add(sched, cores[i]);
+  }
+  scheduler_deadline(sched, max_ms);
+  *insns = scheduler_run(sched, count, max_insns == NO_INSN_LIMIT ? 0 : max_insns);
+
+  bool failed = false;
+  bool exhausted = false;
+  for (int i = 0; i < count; i++)
+  {
+    if (scheduler_status(sched, i) == GUEST_FAULTED)
+    {
+      fprintf(stderr, "Core %d: %s", i, scheduler_error(sched, i));
+      failed = true;
+    }
+    exhausted |= scheduler_status(sched, i) == GUEST_RUNNABLE;
+  }
+  for (int i = 1; i < count; i++)
+  {
+    emulstate_free(cores[i]);
+  }
+  scheduler_free(sched);
+  free(cores);
+  if (failed)
+    exit(EXIT_FAILURE);
+  if (!exhausted)
+    return NULL;
+  return max_ms > 0 && now_ms() >= deadline ? "time" : "instruction";
+}
 
 int main(int argc, char **argv)
 {
+  static struct option long_options[] = {
+      {"perf-stats", no_argument, NULL, 'p'},
+      {"dump-format", required_argument, NULL, 'd'},
+      {"cores", required_argument, NULL, 'c'},
+      {"max-insns", required_argument, NULL, 'i'},
+      {"max-time", required_argument, NULL, 't'},
+      {"uart", optional_argument, NULL, 'u'},
+      {"uart-out", required_argument, NULL, 'o'},
+      {NULL, 0, NULL, 0}};
+  bool perf = false;
+  bool usage = false;
+  int cores = 1;
+  ullong max_insns = NO_INSN_LIMIT;
+  ullong max_ms = 0;
+  ulong uart_base = 0; // 0 for no UART
+  const char *uart_path = NULL;
+  // Writer of the final state, selected with --dump-format
+  void (*dump)(FILE *, emulstate) = fprint_emulstate;
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1)
+  {
+    if (opt == 'p')
+      perf = true;
+    else if (opt == 'd' && strcmp(optarg, "text") == 0)
+      dump = fprint_emulstate;
+    else if (opt == 'd' && strcmp(optarg, "bin") == 0)
+      dump = fwrite_emulstate_bin;
+    else if (opt == 'd' && strcmp(optarg, "json") == 0)
+      dump = fprint_emulstate_json;
+    else if (opt == 'c' && atoi(optarg) >= 1 && atoi(optarg) <= MAX_CORES)
+      cores = atoi(optarg);
+    else if (opt == 'i' && strtoull(optarg, NULL, 0) > 0)
+      max_insns = strtoull(optarg, NULL, 0);
+    else if (opt == 't' && strtoull(optarg, NULL, 0) > 0)
+      max_ms = strtoull(optarg, NULL, 0);
+    else if (opt == 'u')
+      uart_base = optarg != NULL ? strtoul(optarg, NULL, 0) : UART_DEFAULT_BASE;
+    else if (opt == 'o')
+      uart_path = optarg;
+    else
+      usage = true;
+  }
+
   // Check correct number of arguments
-  if (argc != 2 && argc != 3)
+  int num_paths = argc - optind;
+  // The UART goes past the end of memory, at a multiple of its size
+  bool uart_invalid = uart_base == 0 ? uart_path != NULL : uart_base < MAX_MEMORY || uart_base % UART_SIZE != 0;
+  if (usage || (num_paths != 1 && num_paths != 2) || (cores > 1 && perf) || uart_invalid)
   {
-    fprintf(stderr, "Usage: %s <file in> [<file out>]\n", argv[0]);
+    fprintf(stderr, "Usage: %s [--perf-stats | --cores=n] [--max-insns=n] [--max-time=ms] "
+                    "[--uart[=address] [--uart-out=file]] [--dump-format=text|bin|json] "
+                    "<file in> [<file out>]\n", argv[0]);
     return EXIT_FAILURE;
   }
+  const char *in_path = argv[optind];
+  const char *out_path = num_paths == 2 ? argv[optind + 1] : NULL;
 
   // If second arg provided, open file for writing, otherwise use stdout.
   FILE *fout = stdout;
-  if (argc == 3)
+  if (out_path != NULL)
   {
-    fout = fopen(argv[2], "w");
+    fout = fopen(out_path, "wb");
     if (fout == NULL)
     {
-      fprintf(stderr, "Error: Could not open file %s\n", argv[2]);
+      fprintf(stderr, "Error: Could not open file %s\n", out_path);
       return EXIT_FAILURE;
     }
   }
 
   // Open input binary file
-  FILE *fin = fopen(argv[1], "rb");
+  FILE *fin = fopen(in_path, "rb");
   if (fin == NULL)
   {
-    fprintf(stderr, "Error: Could not open file %s\n", argv[1]);
+    fprintf(stderr, "Error: Could not open file %s\n", in_path);
     return EXIT_FAILURE;
   }
 
-  // Create emulator state, load memory from binary file, and run
-  // emulation steps while HALT is not reached.
-  emulstate state = emulstate_init();       // initialise memory and registers
-  fread(state->memory, 1, MAX_MEMORY, fin); // we expect less than MAX_MEMORY to be writen, ignore return value
+  // Create emulator state, load memory from the ELF executable or the flat binary file, and
+  // run emulation steps while HALT is not reached.
+  emulstate state = emulstate_init(); // initialise memory and registers
+  byte magic[ELF_MAGIC_LEN];
+  size_t magic_len = fread(magic, 1, ELF_MAGIC_LEN, fin);
+  symbols_t symbols = NULL;
+  if (elf_is_elf(magic, magic_len))
+  {
+    symbols = elf_load(state, in_path);
+  }
+  else
+  {
+    rewind(fin);
+    fread(state->memory, 1, MAX_MEMORY, fin); // we expect less than MAX_MEMORY to be writen, ignore return value
+  }
   fclose(fin);
 
-  char buf[100];
-  bool debug = getenv("ARMV8_DEBUG") != NULL;
-
-  while (emulstep(state))
-  { // keep running while no halt
-    // Useful for debugging Part 3
-    if (debug)
+  // With --uart, the guest writes to stdout or the --uart-out file, and reads stdin
+  if (uart_base != 0)
+  {
+    int uart_fd = STDOUT_FILENO;
+    if (uart_path != NULL)
+      uart_fd = open(uart_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (uart_fd < 0)
     {
-      fprint_emulstate(fout, state);
-      fgets(buf, 100, stdin);
+      fprintf(stderr, "Error: Could not open file %s\n", uart_path);
+      return EXIT_FAILURE;
     }
+    state->uart = uart_init(uart_fd, STDIN_FILENO);
+    state->uart_base = uart_base;
   }
+  machine = state;
+  atexit(flush_output);
 
-  // Finaly, print state
-  fprint_emulstate(fout, state);
+  // With --perf-stats every step is measured, and the report goes to stderr.
+  perf_stats_t stats = perf ? perf_stats_init() : NULL;
+  if (stats != NULL && symbols != NULL)
+    perf_stats_symbolize(stats, symbols);
+
+  // With --cores, all cores start at the entry point and tell themselves apart by MPIDR_EL1. The
+  // final state shows the registers of core 0.
+  const char *exhausted = NULL;
+  ullong insns;
+  if (cores > 1)
+  {
+    exhausted = run_cores(state, cores, max_insns, max_ms, &insns);
+  }
+  else
+  {
+    exhausted = run_program(state, stats, symbols, fout, max_insns, max_ms);
+    insns = state->insns;
+  }
+
+  if (stats != NULL)
+  {
+    perf_stats_report(stats, stderr);
+    perf_stats_free(stats);
+  }
+
+  // Finaly, print state, which is where the program stopped if a budget ran out, after the
+  // output of the program
+  semihost_flush(state);
+  if (state->uart != NULL)
+  {
+    uart_free(state->uart);
+    state->uart = NULL;
+  }
+  state->exhausted = exhausted;
+  dump(fout, state);
   fclose(fout); // This is the end, so fclose(stdout) is fine
+  if (exhausted != NULL)
+    fprintf(stderr, "Budget exhausted: %s limit reached after %llu instructions\n", exhausted, insns);
+  // A program stopped by a semihosting exit call exits with its code
+  int status = exhausted != NULL ? EXIT_BUDGET : state->exit_code;
+  machine = NULL;
+  if (symbols != NULL)
+    symbols_free(symbols);
   emulstate_free(state);
-  return EXIT_SUCCESS;
+  return status;
 }
@@ -1,155 +1,513 @@
 #include <stdlib.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "buffer.h"
 #include "emulator.h"
+#include "decode.h"
+#include "error.h"
+#include "isa.h"
 #include "instr_dpimm.h"
 #include "instr_dpreg.h"
 #include "instr_sdt.h"
 #include "instr_branch.h"
 #include "instr_cond.h"
 #include "instr_simd_fp.h"
+#include "instr_atomic.h"
+#include "instr_system.h"
+#include "semihost.h"
+#include "interrupt.h"
+#include "uart.h"
 
 #define NELEMENTS(arr) (sizeof(arr) / sizeof(*arr))
 #define MEMORY_BLOCKS 4
 #define SF_MASK 0xFFFFFFFF
+#define DUMP_INIT_CAP 4096
+#define DUMP_BIN_MAGIC "A8SD"
+#define DUMP_BIN_MAGIC_LEN 4
+#define DUMP_BIN_VERSION 1
+#define DUMP_BIN_EXHAUSTED 0x80000000u // in the NZCV word
+#define DCACHE_ENTRIES (MAX_MEMORY / INSTR_SIZE)
+// The decode table is indexed by the top bits of an instruction (31..21), and lists the
+// isa.def entries those bits can match.
+#define DECODE_SHIFT 21
+#define DECODE_BUCKETS (1 << (32 - DECODE_SHIFT))
+#define DECODE_TOP_MASK 0xFFE00000
+#define BUCKET_ENTRIES 8
+#define NO_ENTRY 0xFF
+#define MAX_CORE 255 // cores are numbered by the Aff0 field of MPIDR_EL1
 
-// Print unknown instruction error message and exit
+// Print unknown instruction error message and state dump, and fail
 static void unknown_instr(emulstate state, ulong instr)
 {
-  fprintf(stderr, "Error: Unrecognized instruction 0x%08lx\nState Dump:\n", instr);
-  fprint_emulstate(stderr, state);
-  exit(1);
+  error_report("Error: Unrecognized instruction 0x%08lx\nState Dump:\n", instr);
+  if (error_recovery == NULL)
+    fprint_emulstate(stderr, state);
+  error_fail();
 }
 
-// Create a new emulator state with default values
-emulstate emulstate_init()
+// Sets the registers to their initial values
+static void reset_regs(emulstate state)
 {
-  emulstate state = malloc(sizeof(struct emulstate));
   state->pc = 0;
+  state->insns = 0;
+  state->insn_limit = NO_INSN_LIMIT;
   state->pstate.negative = false;
   state->pstate.zero = true; // (spec 1.1.1 - "initial value of PSTATE has the Z flag set")
   state->pstate.carry = false;
   state->pstate.overflow = false;
+  state->excl_size = 0;
+  state->exited = false;
+  state->exit_code = 0;
+  state->exhausted = NULL;
+  state->next_event = NO_INSN_LIMIT;
+  state->num_events = 0;
+  state->daif = 0xF; // interrupts masked
+  state->vbar = 0;
+  state->elr = 0;
+  state->spsr = 0;
+  state->cntv_ctl = 0;
+  state->cntv_cval = 0;
+  state->irq_enabled = false;
+  state->irq_active = 0;
   for (int i = 0; i <= GENERAL_REGS; i++)
   {
     state->regs[i] = 0;
   }
+  // Each core gets a stack below that of the core before it
+  state->regs[SP_REG] = MAX_MEMORY - state->core * CORE_STACK_SIZE;
   for (int i = 0; i < SIMD_REGS; i++)
   {
     state->simd_regs[i] = 0;
   }
-  for (int i = 0; i < MAX_MEMORY; i++)
+}
+
+// Create a new emulator state with default values
+static void build_decode_table(void);
+
+// Creates a state using `memory`
+static emulstate init_state(byte *memory, uint core)
+{
+  build_decode_table();
+  emulstate state = calloc(1, sizeof(struct emulstate));
+  if (state == NULL || memory == NULL)
   {
-    state->memory[i] = 0;
+    fprintf(stderr, "Error: Could not allocate emulator state\n");
+    exit(1);
   }
+  state->memory = memory;
+  state->core = core;
+  reset_regs(state);
+  // calloc so that pages of the cache are only touched once code runs from them
+  state->dcache = calloc(DCACHE_ENTRIES, sizeof(decoded_t));
   return state;
 }
 
+emulstate emulstate_init()
+{
+  // Anonymous pages are only allocated once used, so many states can be held at once, and
+  // the loader can map ELF segments over them (see elf_loader.h)
+  byte *memory = mmap(NULL, MAX_MEMORY, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return init_state(memory != MAP_FAILED ? memory : NULL, 0);
+}
+
+emulstate emulstate_init_core(emulstate primary, uint core)
+{
+  if (core == 0 || core > MAX_CORE)
+  {
+    fprintf(stderr, "Error: Invalid core number %u\n", core);
+    exit(1);
+  }
+  emulstate state = init_state(primary->memory, core);
+  state->uart = primary->uart;
+  state->uart_base = primary->uart_base;
+  return state;
+}
+
+void emulstate_reset(emulstate state)
+{
+  semihost_flush(state);
+  reset_regs(state);
+  for (ulong page = 0; page < DIRTY_PAGES; page++)
+  {
+    if (!state->dirty[page])
+      continue;
+    memset(state->memory + page * DIRTY_PAGE_SIZE, 0, DIRTY_PAGE_SIZE);
+    invalidate_decoded(state, page * DIRTY_PAGE_SIZE, DIRTY_PAGE_SIZE);
+  }
+  memset(state->dirty, 0, sizeof(state->dirty));
+}
+
 void emulstate_free(emulstate state)
 {
+  semihost_free(state);
+  if (state->core == 0)
+    munmap(state->memory, MAX_MEMORY);
+  free(state->dcache);
   free(state);
 }
 
-// Print emulator state to file
+// Appends the lowest `digits` hex digits of `value`
+static void append_hex(buffer_t buf, ullong value, int digits)
+{
+  static const char hex_digits[] = "0123456789abcdef";
+  buffer_reserve(buf, digits);
+  for (int i = digits - 1; i >= 0; i--)
+  {
+    buf->data[buf->len + i] = hex_digits[value & 0xf];
+    value >>= 4;
+  }
+  buf->len += digits;
+}
+
+static void append_str(buffer_t buf, const char *str)
+{
+  buffer_append(buf, str, strlen(str));
+}
+
+// Returns the address of the first non-zero MEMORY_BLOCKS-byte block at or after the aligned
+// `addr`, or MAX_MEMORY if there is none. Zero memory is skipped a 64-bit word at a time.
+static ulong next_nonzero_block(emulstate state, ulong addr)
+{
+  for (; addr < MAX_MEMORY && addr % sizeof(ullong) != 0; addr += MEMORY_BLOCKS)
+  {
+    if (load_mem(state, false, addr) != 0)
+      return addr;
+  }
+  for (; addr < MAX_MEMORY; addr += sizeof(ullong))
+  {
+    ullong word;
+    memcpy(&word, state->memory + addr, sizeof(word));
+    if (word != 0)
+      return load_mem(state, false, addr) != 0 ? addr : addr + MEMORY_BLOCKS;
+  }
+  return MAX_MEMORY;
+}
+
+// Print emulator state to file. The dump is formatted into one buffer and written at once.
 void fprint_emulstate(FILE *fout, emulstate state)
 {
+  buffer_t buf = buffer_init(DUMP_INIT_CAP);
   // Registers
-  fprintf(fout, "Registers:\n");
+  append_str(buf, "Registers:\n");
   for (int i = 0; i < GENERAL_REGS; i++)
   {
-    fprintf(fout, "X%02d = %016llx\n", i, state->regs[i]);
+    char name[] = {'X', '0' + i / 10, '0' + i % 10, '\0'};
+    append_str(buf, name);
+    append_str(buf, " = ");
+    append_hex(buf, state->regs[i], 16);
+    append_str(buf, "\n");
   }
-  fprintf(fout, "PC = %016llx\n", state->pc);
+  append_str(buf, "PC = ");
+  append_hex(buf, state->pc, 16);
   // PSTATE register
-  fprintf(fout, "PSTATE : ");
+  append_str(buf, "\nPSTATE : ");
   char labels[] = {'N', 'Z', 'C', 'V'};
   bool values[] = {state->pstate.negative, state->pstate.zero,
                    state->pstate.carry, state->pstate.overflow};
   for (int idx = 0; idx < NELEMENTS(labels) && idx < NELEMENTS(values); idx++)
   {
-    if (values[idx])
-    {
-      fputc(labels[idx], fout);
-    }
-    else
-    {
-      fputc('-', fout);
-    }
+    buffer_append(buf, values[idx] ? &labels[idx] : "-", 1);
   }
-  // Memory (MEMORY_BLOCKS-byte aligned)
-  fprintf(fout, "\nNon-zero memory:\n");
-  for (int idx = 0; idx < MAX_MEMORY; idx += MEMORY_BLOCKS)
+  // Memory (MEMORY_BLOCKS-byte aligned), little-endian as load_mem() reads it
+  append_str(buf, "\nNon-zero memory:\n");
+  for (ulong addr = next_nonzero_block(state, 0); addr < MAX_MEMORY;
+       addr = next_nonzero_block(state, addr + MEMORY_BLOCKS))
   {
-    // Check all bytes in block for non-zero values.
-    bool non_zero = false;
-    for (int b = 0; !non_zero && b < MEMORY_BLOCKS; b++)
-    {
-      non_zero = state->memory[idx + b] != 0;
-    }
-    if (non_zero)
+    append_str(buf, "0x");
+    append_hex(buf, addr, 8);
+    append_str(buf, ": 0x");
+    append_hex(buf, load_mem(state, false, addr), 8);
+    append_str(buf, "\n");
+  }
+  // Without a colon or an equals sign, so that readers of the state skip it
+  if (state->exhausted != NULL)
+  {
+    append_str(buf, "Budget exhausted (");
+    append_str(buf, state->exhausted);
+    append_str(buf, " limit)\n");
+  }
+  buffer_write(buf, fout);
+  buffer_free(buf);
+}
+
+// Appends a 64-bit value in little-endian byte order
+static void append_dword(buffer_t buf, ullong value)
+{
+  buffer_append_word(buf, value & SF_MASK);
+  buffer_append_word(buf, value >> 32);
+}
+
+// Write emulator state to file in the binary dump format (see emulator.h).
+void fwrite_emulstate_bin(FILE *fout, emulstate state)
+{
+  buffer_t buf = buffer_init(DUMP_INIT_CAP);
+  buffer_append(buf, DUMP_BIN_MAGIC, DUMP_BIN_MAGIC_LEN);
+  buffer_append_word(buf, DUMP_BIN_VERSION);
+  for (int i = 0; i < GENERAL_REGS; i++)
+  {
+    append_dword(buf, state->regs[i]);
+  }
+  append_dword(buf, state->pc);
+  buffer_append_word(buf, (state->exhausted != NULL ? DUMP_BIN_EXHAUSTED : 0) |
+                              state->pstate.negative << 3 | state->pstate.zero << 2 |
+                              state->pstate.carry << 1 | state->pstate.overflow);
+  // Runs of consecutive non-zero blocks. Memory already holds them in little-endian order.
+  ulong addr = next_nonzero_block(state, 0);
+  while (addr < MAX_MEMORY)
+  {
+    ulong end = addr + MEMORY_BLOCKS;
+    while (end < MAX_MEMORY && load_mem(state, false, end) != 0)
+      end += MEMORY_BLOCKS;
+    buffer_append_word(buf, addr);
+    buffer_append_word(buf, (end - addr) / MEMORY_BLOCKS);
+    buffer_append(buf, state->memory + addr, end - addr);
+    addr = next_nonzero_block(state, end);
+  }
+  buffer_write(buf, fout);
+  buffer_free(buf);
+}
+
+// Print emulator state to file as a JSON object (see emulator.h).
+void fprint_emulstate_json(FILE *fout, emulstate state)
+{
+  buffer_t buf = buffer_init(DUMP_INIT_CAP);
+  append_str(buf, "{\n  \"status\": ");
+  if (state->exhausted != NULL)
+  {
+    append_str(buf, "\"exhausted\", \"budget\": \"");
+    append_str(buf, state->exhausted);
+    append_str(buf, "\",");
+  }
+  else
+  {
+    append_str(buf, "\"halted\",");
+  }
+  append_str(buf, "\n  \"registers\": {");
+  for (int i = 0; i < GENERAL_REGS; i++)
+  {
+    char name[] = {'X', '0' + i / 10, '0' + i % 10, '\0'};
+    append_str(buf, "\n    \"");
+    append_str(buf, name);
+    append_str(buf, "\": \"0x");
+    append_hex(buf, state->regs[i], 16);
+    append_str(buf, "\",");
+  }
+  append_str(buf, "\n    \"PC\": \"0x");
+  append_hex(buf, state->pc, 16);
+  append_str(buf, "\"\n  },\n  \"pstate\": {");
+  append_str(buf, state->pstate.negative ? "\"N\": true" : "\"N\": false");
+  append_str(buf, state->pstate.zero ? ", \"Z\": true" : ", \"Z\": false");
+  append_str(buf, state->pstate.carry ? ", \"C\": true" : ", \"C\": false");
+  append_str(buf, state->pstate.overflow ? ", \"V\": true" : ", \"V\": false");
+  append_str(buf, "},\n  \"memory\": {");
+  const char *sep = "\n    \"0x";
+  for (ulong addr = next_nonzero_block(state, 0); addr < MAX_MEMORY;
+       addr = next_nonzero_block(state, addr + MEMORY_BLOCKS))
+  {
+    append_str(buf, sep);
+    append_hex(buf, addr, 8);
+    append_str(buf, "\": \"0x");
+    append_hex(buf, load_mem(state, false, addr), 8);
+    append_str(buf, "\"");
+    sep = ",\n    \"0x";
+  }
+  append_str(buf, "\n  }\n}\n");
+  buffer_write(buf, fout);
+  buffer_free(buf);
+}
+
+// Handlers for instructions without specialised variants, which still decode on every execution.
+static void exec_halt(emulstate state, const decoded_t *d)
+{
+}
+
+static void exec_unknown(emulstate state, const decoded_t *d)
+{
+  unknown_instr(state, d->raw);
+}
+
+static void exec_simd_fp(emulstate state, const decoded_t *d)
+{
+  if (!exec_simd_fp_instr(state, d->raw))
+    unknown_instr(state, d->raw);
+  state->pc += INSTR_SIZE;
+}
+
+// Decoders of the instructions executed by the generic handlers
+static bool decode_halt(ulong raw, decoded_t *d, isa_op op)
+{
+  d->exec = exec_halt;
+  return true;
+}
+
+static bool decode_simd_fp(ulong raw, decoded_t *d, isa_op op)
+{
+  d->exec = exec_simd_fp;
+  return true;
+}
+
+// The encodings of isa.def, indexed by isa_op
+static const struct
+{
+  ulong mask;
+  ulong match;
+  decode_fn decode;
+  fuse_fn fuse;
+} isa[ISA_OPS] = {
+#define ISA(name, mask, match, decoder, fuser) {mask, match, decoder, fuser},
+#include "isa.def"
+#undef ISA
+};
+
+// For each value of the top bits, the isa_ops that can match in isa.def order, NO_ENTRY terminated
+static byte decode_table[DECODE_BUCKETS][BUCKET_ENTRIES];
+static pthread_once_t decode_table_once = PTHREAD_ONCE_INIT;
+
+static void fill_decode_table(void)
+{
+  for (ulong bucket = 0; bucket < DECODE_BUCKETS; bucket++)
+  {
+    ulong top = bucket << DECODE_SHIFT;
+    int count = 0;
+    for (int op = 0; op < ISA_OPS; op++)
     {
-      fprintf(fout, "0x%08x: 0x", idx);
-      // Loop is reversed since little-endian byte order
-      for (int b = MEMORY_BLOCKS - 1; b >= 0; b--)
+      ulong top_mask = isa[op].mask & DECODE_TOP_MASK;
+      if ((top & top_mask) != (isa[op].match & top_mask))
+        continue;
+      if (count == BUCKET_ENTRIES - 1)
       {
-        fprintf(fout, "%02x", state->memory[idx + b]);
+        fprintf(stderr, "Error: Too many encodings overlap in decode table bucket 0x%03lx\n", bucket);
+        exit(1);
       }
-      fputc('\n', fout);
+      decode_table[bucket][count++] = op;
+      // Entries after one decided by the top bits alone can never match
+      if (top_mask == isa[op].mask)
+        break;
     }
+    decode_table[bucket][count] = NO_ENTRY;
+  }
+}
+
+// Builds the table once, also when states are created on several threads at once
+static void build_decode_table(void)
+{
+  pthread_once(&decode_table_once, fill_decode_table);
+}
+
+// Returns the isa.def entry an instruction belongs to, or ISA_OPS if there is none
+static isa_op match_instr(ulong instr)
+{
+  for (const byte *op = decode_table[instr >> DECODE_SHIFT]; *op != NO_ENTRY; op++)
+  {
+    if ((instr & isa[*op].mask) == isa[*op].match)
+      return *op;
   }
+  return ISA_OPS;
+}
+
+// Decode an instruction, selecting the handler that executes it
+static void decode_instr(ulong instr, decoded_t *d)
+{
+  isa_op op = match_instr(instr);
+  d->raw = instr;
+  d->insns = 0;
+  if (op == ISA_OPS || !isa[op].decode(instr, d, op))
+    d->exec = exec_unknown;
+}
+
+bool decode_raw(ulong raw, decoded_t *d, isa_op *op)
+{
+  build_decode_table();
+  *op = match_instr(raw);
+  decode_instr(raw, d);
+  return d->exec != exec_unknown;
+}
+
+// Fuses a decoded instruction with the next one where the pair has a fused handler. The next
+// word is decoded if needed, and invalidate_decoded() discards the pair when it changes.
+static void fuse_instr(emulstate state, decoded_t *d, bool cached)
+{
+  d->insns = 1;
+  isa_op op = match_instr(d->raw);
+  if (!cached || d->exec == exec_unknown || isa[op].fuse == NULL)
+    return;
+  ulong next_word = d - state->dcache + 1;
+  if (next_word >= DCACHE_ENTRIES)
+    return;
+  decoded_t *next = &state->dcache[next_word];
+  if (next->exec == NULL)
+    decode_instr(load_mem(state, false, next_word * INSTR_SIZE), next);
+  if (next->exec != exec_unknown)
+    isa[op].fuse(d, op, match_instr(next->raw));
+}
+
+// Executes the next instruction, with the events due already run
+static inline bool step_instr(emulstate state)
+{
+  // Instructions are decoded once per word, unless the PC is misaligned.
+  decoded_t uncached = {NULL};
+  decoded_t *d = &uncached;
+  if ((state->pc & (INSTR_SIZE - 1)) == 0 && state->pc < MAX_MEMORY)
+    d = &state->dcache[state->pc / INSTR_SIZE];
+  if (d->exec == NULL)
+    decode_instr(load_mem(state, false, state->pc), d);
+  if (d->insns == 0)
+    fuse_instr(state, d, d != &uncached);
+
+  if (d->exec == exec_halt || state->exited)
+    return false;
+  state->insns += d->insns;
+  d->exec(state, d);
+  return true;
 }
 
 // Execute a single emulation step
 bool emulstep(emulstate state)
 {
-  ulong instr = load_mem(state, false, state->pc);
-  // Custom HALT instruction (spec 1.9)
-  if (instr == 0x8a000000)
-    return false;
+  if (state->insns >= state->next_event)
+    events_run(state);
+  return step_instr(state);
+}
 
-  // Extract op0 to determine exec instruction structure
-  char op0 = (instr >> 25) & 0xf;
-  switch (op0)
+bool emulrun(emulstate state, ullong limit)
+{
+  ullong outer = state->insn_limit;
+  set_insn_limit(state, limit);
+  bool running = true;
+  // The limit is folded into next_event, so that it costs no compare of its own per instruction.
+  // A device may lower it during the run (see set_insn_limit()).
+  while (running)
   {
-  case 0x8:
-  case 0x9: // Data Proccessing Immediate
-    if (!exec_dpimm_instr(state, instr))
-      unknown_instr(state, instr);
-    state->pc += INSTR_SIZE;
-    break;
-  case 0x5:
-  case 0xd: // Data Proccessing Register
-    if (((instr >> 21) & 0xff) == 0xd4) {
-      exec_cond_instr(state, instr);
+    if (state->insns >= state->next_event)
+    {
+      if (state->insns >= state->insn_limit)
+        break;
+      events_run(state);
     }
-    else if (!exec_dpreg_instr(state, instr))
-      unknown_instr(state, instr);
-    state->pc += INSTR_SIZE;
-    break;
-  case 0x4:
-  case 0x6:
-  case 0xc:
-  case 0xe:                            // Loads and Stores
-    if (!exec_sdt_instr(state, instr)) // DONE
-      unknown_instr(state, instr);
-    state->pc += INSTR_SIZE;
-    break;
-  case 0xa:
-  case 0xb: // Branches
-    if (!exec_branch_instr(state, instr))
-      unknown_instr(state, instr);
-    // Branch instructions update PC directly
-    break;
-  case 0x7:
-  case 0xf: // SIMD and Floating Point
-    if (!exec_simd_fp_instr(state, instr))
-      unknown_instr(state, instr);
-    state->pc += INSTR_SIZE;
-    break;
-  default:
-    unknown_instr(state, instr);
+    running = step_instr(state);
   }
+  set_insn_limit(state, outer);
+  return running;
+}
 
-  return true;
+void invalidate_decoded(emulstate state, ulong address, ulong len)
+{
+  if (len == 0)
+    return;
+  for (ulong page = address / DIRTY_PAGE_SIZE; page <= (address + len - 1) / DIRTY_PAGE_SIZE && page < DIRTY_PAGES; page++)
+  {
+    state->dirty[page] = true;
+  }
+  // The word before may be fused with the first word changed
+  ulong first = address / INSTR_SIZE;
+  if (first > 0)
+    first--;
+  for (ulong word = first; word <= (address + len - 1) / INSTR_SIZE && word < DCACHE_ENTRIES; word++)
+  {
+    state->dcache[word].exec = NULL;
+  }
 }
 
 // Utility function to get a range from a ulong. Useful for unpacking an instruction.
@@ -163,10 +521,10 @@ ulong get_value(ulong from, uint offset, uint size)
 // Utility function to set a register value, and correct for 32/64 bit mode.
 void set_reg(emulstate state, bool sf, byte rg, ullong value)
 {
-  if (rg > GENERAL_REGS)
+  if (rg > SP_REG)
   {
-    fprintf(stderr, "Error: Out of bounds register number %d\n", rg);
-    exit(1);
+    error_report("Error: Out of bounds register number %d\n", rg);
+    error_fail();
   }
   else if (rg == GENERAL_REGS)
   {
@@ -177,10 +535,10 @@ void set_reg(emulstate state, bool sf, byte rg, ullong value)
 
 ullong get_reg(emulstate state, bool sf, byte rg)
 {
-  if (rg > GENERAL_REGS)
+  if (rg > SP_REG)
   {
-    fprintf(stderr, "Error: Out of bounds register number %d\n", rg);
-    exit(1);
+    error_report("Error: Out of bounds register number %d\n", rg);
+    error_fail();
   }
   return sf_checker(state->regs[(int)rg], sf);
 }
@@ -189,8 +547,8 @@ void set_simd_reg(emulstate state, byte rg, byte ftype, double value)
 {
   if (rg > SIMD_REGS)
   {
-    fprintf(stderr, "Error: Out of bounds SIMD register number %d\n", rg);
-    exit(1);
+    error_report("Error: Out of bounds SIMD register number %d\n", rg);
+    error_fail();
   }
   ullong *ptr = (ullong *)(&value);
   switch (ftype)
@@ -205,8 +563,8 @@ void set_simd_reg(emulstate state, byte rg, byte ftype, double value)
   case F64:
     break;
   default:
-    fprintf(stderr, "Error: Unsupported SIMD ftype %d\n", ftype);
-    exit(1);
+    error_report("Error: Unsupported SIMD ftype %d\n", ftype);
+    error_fail();
   }
   state->simd_regs[(int)rg] = value;
 }
@@ -215,8 +573,8 @@ double get_simd_reg(emulstate state, byte rg, byte ftype)
 {
   if (rg > SIMD_REGS)
   {
-    fprintf(stderr, "Error: Out of bounds SIMD register number %d\n", rg);
-    exit(1);
+    error_report("Error: Out of bounds SIMD register number %d\n", rg);
+    error_fail();
   }
   double value = state->simd_regs[(int)rg];
   ullong *ptr = (ullong *)(&value);
@@ -229,35 +587,100 @@ double get_simd_reg(emulstate state, byte rg, byte ftype)
   case F64:
     return value;
   default:
-    fprintf(stderr, "Error: Unsupported SIMD ftype %d\n", ftype);
-    exit(1);
+    error_report("Error: Unsupported SIMD ftype %d\n", ftype);
+    error_fail();
   }
 }
 
-ullong load_mem(emulstate state, bool sf, ulong address)
+// Fails unless `size` bytes from `address`, past the end of memory, are UART registers
+static void check_device(emulstate state, ulong address, int size)
 {
-  int size = 4;
-  if (sf)
-    size = 8;
-  // Convert little-endian memory to ullong
-  ullong data = 0;
-  for (int idx = 0; idx < size; idx++)
+  if (state->uart == NULL || address < state->uart_base || address - state->uart_base > UART_SIZE - size)
   {
-    data |= (ullong)(state->memory[address + idx]) << (idx * 8);
+    error_report("Error: Out of bounds memory access 0x%lx\n", address);
+    error_fail();
   }
-  return data;
 }
 
-void store_mem(emulstate state, bool sf, ulong address, ullong value)
+// Guest memory is little-endian, so accesses are single host loads and stores of that order
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Guest memory accesses assume a little-endian host"
+#endif
+
+ullong load_mem_size(emulstate state, int size, ulong address)
+{
+  if (address > MAX_MEMORY - size)
+  {
+    check_device(state, address, size);
+    return uart_load(state->uart, state->core, address - state->uart_base) & (~0ull >> (64 - size * 8));
+  }
+  const byte *from = state->memory + address;
+  switch (size)
+  {
+  case 1:
+    return *from;
+  case 2:
+  {
+    unsigned short data;
+    memcpy(&data, from, sizeof(data));
+    return data;
+  }
+  case 4:
+  {
+    uint data;
+    memcpy(&data, from, sizeof(data));
+    return data;
+  }
+  default:
+  {
+    ullong data;
+    memcpy(&data, from, sizeof(data));
+    return data;
+  }
+  }
+}
+
+void store_mem_size(emulstate state, int size, ulong address, ullong value)
 {
-  int size = 4;
-  if (sf)
-    size = 8;
-  // Convert ullong to little-endian memory
-  for (int idx = 0; idx < size; idx++)
+  if (address > MAX_MEMORY - size)
   {
-    state->memory[address + idx] = (value >> (idx * 8)) & 0xff;
+    check_device(state, address, size);
+    uart_store(state->uart, state->core, address - state->uart_base, value);
+    return;
+  }
+  byte *to = state->memory + address;
+  switch (size)
+  {
+  case 1:
+    *to = value;
+    break;
+  case 2:
+  {
+    unsigned short data = value;
+    memcpy(to, &data, sizeof(data));
+    break;
+  }
+  case 4:
+  {
+    uint data = value;
+    memcpy(to, &data, sizeof(data));
+    break;
   }
+  default:
+    memcpy(to, &value, sizeof(value));
+    break;
+  }
+  invalidate_decoded(state, address, size);
+}
+
+ullong load_mem(emulstate state, bool sf, ulong address)
+{
+  return load_mem_size(state, sf ? 8 : 4, address);
+}
+
+void store_mem(emulstate state, bool sf, ulong address, ullong value)
+{
+  store_mem_size(state, sf ? 8 : 4, address, value);
 }
 
 ullong sf_checker(ullong value, bool sf)
@@ -2,11 +2,17 @@
 #include <stdio.h>
 #define MAX_MEMORY 2097152 // 2 MB (spec 1.1)
 #define GENERAL_REGS 31    // (spec 1.1)
+#define SP_REG (GENERAL_REGS + 1) // index of SP in regs, after the zero register
 #define SIMD_REGS 32
 
 #ifndef EMULATOR_H
 #define EMULATOR_H
 #define INSTR_SIZE 4
+#define DIRTY_PAGE_SIZE 4096
+#define DIRTY_PAGES (MAX_MEMORY / DIRTY_PAGE_SIZE)
+#define NO_INSN_LIMIT ((ullong)-1)
+#define MAX_EVENTS 4
+#define CORE_STACK_SIZE 65536 // SP of core n starts n stacks below the top of memory
 typedef unsigned char byte;
 typedef unsigned int uint;
 typedef unsigned long ulong;
@@ -22,29 +28,101 @@ typedef struct
   bool overflow;
 } pstate_t;
 
+struct decoded;
+struct emulstate;
+
+// An event of a core, see interrupt.h
+typedef void (*event_fn)(struct emulstate *state);
+typedef struct
+{
+  ullong deadline; // instruction count the event is due at
+  event_fn fn;
+} event_t;
+
 struct emulstate
 {
-  byte memory[MAX_MEMORY];
-  ullong regs[GENERAL_REGS + 1]; // last is 0 register
+  byte *memory; // MAX_MEMORY bytes, shared by the cores of a machine
+  ullong regs[GENERAL_REGS + 2]; // X0..X30, the zero register, then SP
   ldouble simd_regs[SIMD_REGS];  // 128-bit SIMD registers
   ullong pc;
   pstate_t pstate;
-  // reg sp; // (spec 1.1 - "stack pointer can be ignored for this exercise")
+  ullong insns;           // guest instructions executed
+  ullong insn_limit;      // emulrun() stops here, and busy-wait loops are not fast-forwarded past it
+  bool dirty[DIRTY_PAGES]; // pages of memory written since the state was reset
+  struct decoded *dcache; // decoded instructions, one per word of memory
+  uint core;              // number of the core in its machine, 0 for the one owning memory
+  // Exclusive monitor: the access of the last LDXR, until a STXR closes it
+  byte excl_size; // bytes loaded, 0 if the monitor is closed
+  ulong excl_address;
+  ullong excl_value;
+  struct semihost *semihost; // buffered output of semihosting calls, NULL before the first
+  bool exited;               // the program made a semihosting exit call
+  int exit_code;             // of that call
+  const char *exhausted;     // the budget that ran out before the program halted, or NULL
+  // Events, ordered by deadline, and interrupts, see interrupt.h
+  ullong next_event; // deadline of the first event, or insn_limit if it comes first
+  event_t events[MAX_EVENTS];
+  int num_events;
+  byte daif;         // PSTATE.DAIF, as bits 9..6 of SPSR_EL1
+  ullong vbar;       // VBAR_EL1
+  ullong elr;        // ELR_EL1
+  ullong spsr;       // SPSR_EL1
+  ullong cntv_ctl;   // CNTV_CTL_EL0, without ISTATUS
+  ullong cntv_cval;  // CNTV_CVAL_EL0
+  bool irq_enabled;  // ICC_IGRPEN1_EL1
+  uint irq_active;   // interrupts acknowledged and not ended, by INTID
+  struct uart *uart; // mapped at uart_base, shared by the cores of a machine, or NULL (uart.h)
+  ulong uart_base;
 };
 typedef struct emulstate *emulstate;
 
 extern emulstate emulstate_init();
+// Creates another core of the machine of `primary`, numbered `core` (1-255) in MPIDR_EL1. The
+// cores share memory and the UART, and each has its own registers, decoded instructions and
+// exclusive monitor, so they can run on separate threads (see scheduler.h). The SP of each
+// starts CORE_STACK_SIZE bytes below that of the core before. Loads and stores are plain host
+// accesses, and only the instructions of instr_atomic.c and DMB order memory between cores. A
+// store invalidates the decoded instructions of the storing core only: like on hardware
+// without cache maintenance, code written by one core is not guaranteed to be seen by the
+// others. `primary` must be freed last.
+extern emulstate emulstate_init_core(emulstate primary, uint core);
 extern void emulstate_free(emulstate state);
+// Resets the registers, and zeroes the memory written since the last reset, so that a state can be
+// reused for another program. The cores of a machine are reset together, each zeroing what it
+// wrote.
+extern void emulstate_reset(emulstate state);
+// Prints the state as text, ending with a "Budget exhausted" line if a budget ran out.
 extern void fprint_emulstate(FILE *stream, emulstate state);
-// Returns true if program should continue (no halt)
+// Writes the state in binary, all values little-endian: "A8SD", version (u32), X00..X30 (u64),
+// PC (u64), NZCV (u32, N in bit 3, and bit 31 set if a budget ran out), then runs of non-zero
+// memory until the end of the file, each an address (u32), a word count (u32) and that many
+// 32-bit words.
+extern void fwrite_emulstate_bin(FILE *stream, emulstate state);
+// Prints the state as a JSON object with "status" ("halted", or "exhausted" with the name of
+// the budget in "budget"), "registers" and "memory" (hex strings keyed by register name and
+// address) and "pstate" (booleans keyed N, Z, C and V).
+extern void fprint_emulstate_json(FILE *stream, emulstate state);
+// Executes the next instruction, or the next pair of instructions with a fused handler.
+// Returns true if program should continue (no halt, and no semihosting exit, see semihost.h)
+// Events due run first, see interrupt.h.
 extern bool emulstep(emulstate state);
+// Executes instructions until the program halts or `limit` instructions ran since the state
+// was reset. The limit is folded into the deadline of the next event, which each step checks
+// anyway, so it costs nothing per step, and busy-wait loops are fast-forwarded only up to it.
+// A fused pair can end one instruction past it. Returns true if the program should continue
+// (no halt).
+extern bool emulrun(emulstate state, ullong limit);
+// Discards decoded instructions overlapping `len` bytes of memory from `address`,
+// after that memory was modified. Every write to memory must be followed by this.
+extern void invalidate_decoded(emulstate state, ulong address, ulong len);
 
 #define F64 1
 #define F32 0
 
 // Utility function to get a range from a ulong. Useful for unpacking an instruction.
 extern ulong get_value(ulong from, uint offset, uint size);
-// Utility function to set a register value, and correct for 32/64 bit mode.
+// Utility function to set a register value, and correct for 32/64 bit mode. Register numbers
+// go up to SP_REG, and writes to the zero register are dropped.
 extern void set_reg(emulstate state, bool sf, byte rg, ullong value);
 // Utility function to get a register value, and correct for 32/64 bit mode.
 extern ullong get_reg(emulstate state, bool sf, byte rg);
@@ -53,10 +131,17 @@ extern void set_simd_reg(emulstate state, byte rg, byte ftype, double value);
 // Utility function to get a SIMD register value, and correct for float type.
 extern double get_simd_reg(emulstate state, byte rg, byte ftype);
 // Utility function to load a value from memory, and correct for 32/64 bit mode.
-// If 32-bit, rest of ullong is zeroed out.
+// If 32-bit, rest of ullong is zeroed out. Accesses outside of memory are errors (see error.h),
+// except those of the UART.
 extern ullong load_mem(emulstate state, bool sf, ulong address);
 // Utility function to store a value to memory, and correct for 32/64 bit mode.
+// Accesses outside of memory are errors, except those of the UART.
 extern void store_mem(emulstate state, bool sf, ulong address, ullong value);
+// Loads `size` (1, 2, 4 or 8) bytes of memory with a single host access, zero-extended.
+// Accesses outside of memory are errors, except those of the UART.
+extern ullong load_mem_size(emulstate state, int size, ulong address);
+// Stores the low `size` (1, 2, 4 or 8) bytes of `value` with a single host access.
+extern void store_mem_size(emulstate state, int size, ulong address, ullong value);
 // Utility function for masking 32-bits
 extern ullong sf_checker(ullong value, bool sf);
 #endif
\ No newline at end of file
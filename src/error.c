@@ -0,0 +1,30 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "error.h"
+
+_Thread_local jmp_buf *error_recovery = NULL;
+static _Thread_local char message[ERROR_MESSAGE_SIZE];
+
+void error_report(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  if (error_recovery == NULL)
+    vfprintf(stderr, format, args);
+  else
+    vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+}
+
+void error_fail(void)
+{
+  if (error_recovery == NULL)
+    exit(1);
+  longjmp(*error_recovery, 1);
+}
+
+const char *error_message(void)
+{
+  return message;
+}
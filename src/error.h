@@ -0,0 +1,21 @@
+#include <setjmp.h>
+#include <stdbool.h>
+
+#ifndef ERROR_H
+#define ERROR_H
+
+#define ERROR_MESSAGE_SIZE 256
+
+// Errors in the input (assembly source or guest program) normally exit the program. A caller
+// that wants to carry on, like the fuzz targets, sets a recovery point with setjmp, and errors
+// on the same thread longjmp back to it instead, keeping the message for error_message().
+
+// Recovery point of the calling thread, NULL if errors exit the program.
+extern _Thread_local jmp_buf *error_recovery;
+// Formats an error message, printing it to stderr unless a recovery point is set.
+extern void error_report(const char *format, ...);
+// Ends the operation that failed: longjmps to the recovery point, or exits with status 1.
+extern _Noreturn void error_fail(void);
+// Returns the last message reported on the calling thread while a recovery point was set.
+extern const char *error_message(void);
+#endif
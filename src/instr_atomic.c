@@ -0,0 +1,131 @@
+#include <stdbool.h>
+#include "instr_atomic.h"
+#include "error.h"
+
+// Guest memory is accessed in place with the host atomics, which read it in host byte order
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Atomic instructions need a little-endian host"
+#endif
+
+// The handlers take the access size in bytes from d->imm, rt in d->rd and rs in d->rm. Every
+// access is sequentially consistent, which covers the acquire and release variants.
+
+// Returns the host memory of the naturally aligned access at the address in rn
+static byte *atomic_address(emulstate state, const decoded_t *d, ulong *address)
+{
+  *address = state->regs[d->rn];
+  if (*address > MAX_MEMORY - d->imm || *address % d->imm != 0)
+  {
+    error_report("Error: Unaligned or out of bounds atomic access 0x%lx\n", *address);
+    error_fail();
+  }
+  return state->memory + *address;
+}
+
+static ullong load_word(const byte *mem, ullong size)
+{
+  if (size == 8)
+    return __atomic_load_n((const ullong *)mem, __ATOMIC_SEQ_CST);
+  return __atomic_load_n((const uint *)mem, __ATOMIC_SEQ_CST);
+}
+
+// Replaces *expected by `value` if memory holds it, otherwise stores what memory holds
+// in *expected. Returns true if it stored `value`.
+static bool cas_word(byte *mem, ullong size, ullong *expected, ullong value)
+{
+  if (size == 8)
+    return __atomic_compare_exchange_n((ullong *)mem, expected, value, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  uint expected32 = *expected;
+  bool stored = __atomic_compare_exchange_n((uint *)mem, &expected32, (uint)value, false,
+                                            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  *expected = expected32;
+  return stored;
+}
+
+static ullong fetch_add_word(byte *mem, ullong size, ullong value)
+{
+  if (size == 8)
+    return __atomic_fetch_add((ullong *)mem, value, __ATOMIC_SEQ_CST);
+  return __atomic_fetch_add((uint *)mem, (uint)value, __ATOMIC_SEQ_CST);
+}
+
+// Load exclusive, opening the monitor on the value loaded
+static void exec_ldxr(emulstate state, const decoded_t *d)
+{
+  ulong address;
+  ullong value = load_word(atomic_address(state, d, &address), d->imm);
+  state->excl_size = d->imm;
+  state->excl_address = address;
+  state->excl_value = value;
+  set_reg(state, true, d->rd, value);
+  state->pc += INSTR_SIZE;
+}
+
+// Store exclusive, writing 0 to rs if it stored and 1 if not. The store is a compare-and-swap
+// with the value LDXR loaded, so any other store to the address in between makes it fail,
+// except one that wrote the same value back.
+static void exec_stxr(emulstate state, const decoded_t *d)
+{
+  ulong address;
+  byte *mem = atomic_address(state, d, &address);
+  ullong expected = state->excl_value;
+  bool stored = state->excl_size == d->imm && state->excl_address == address &&
+                cas_word(mem, d->imm, &expected, get_reg(state, d->imm == 8, d->rd));
+  state->excl_size = 0;
+  if (stored)
+    invalidate_decoded(state, address, d->imm);
+  set_reg(state, false, d->rm, !stored);
+  state->pc += INSTR_SIZE;
+}
+
+// Atomic add of rs to memory, loading the old value into rt
+static void exec_ldadd(emulstate state, const decoded_t *d)
+{
+  ulong address;
+  byte *mem = atomic_address(state, d, &address);
+  ullong old = fetch_add_word(mem, d->imm, state->regs[d->rm]);
+  invalidate_decoded(state, address, d->imm);
+  set_reg(state, true, d->rd, old);
+  state->pc += INSTR_SIZE;
+}
+
+// Compare-and-swap: stores rt if memory holds rs, and loads the old value into rs
+static void exec_cas(emulstate state, const decoded_t *d)
+{
+  ulong address;
+  byte *mem = atomic_address(state, d, &address);
+  bool sf = d->imm == 8;
+  ullong expected = get_reg(state, sf, d->rm);
+  if (cas_word(mem, d->imm, &expected, get_reg(state, sf, d->rd)))
+    invalidate_decoded(state, address, d->imm);
+  set_reg(state, true, d->rm, expected);
+  state->pc += INSTR_SIZE;
+}
+
+bool decode_atomic_instr(ulong raw, decoded_t *d, isa_op op)
+{
+  d->imm = get_value(raw, 30, 1) ? 8 : 4;
+  d->rd = get_value(raw, 0, 5);
+  d->rn = get_value(raw, 5, 5);
+  d->rm = get_value(raw, 16, 5);
+  if (d->rn == GENERAL_REGS) // the base is SP
+    d->rn = SP_REG;
+  switch (op)
+  {
+  case OP_LDXR:
+    d->exec = exec_ldxr;
+    return true;
+  case OP_STXR:
+    d->exec = exec_stxr;
+    return true;
+  case OP_LDADD:
+    d->exec = exec_ldadd;
+    return true;
+  case OP_CAS:
+    d->exec = exec_cas;
+    return true;
+  default:
+    return false;
+  }
+}
@@ -0,0 +1,6 @@
+#include "emulator.h"
+#include "decode.h"
+
+typedef unsigned long ulong;
+
+extern bool decode_atomic_instr(ulong raw, decoded_t *d, isa_op op);
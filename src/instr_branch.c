@@ -1,15 +1,6 @@
 #include "instr_branch.h"
 #include <stdbool.h>
 
-#define UncondTest 0xFC000000
-#define UncondExpected 0x14000000
-
-#define RegisterTest 0xFFFFFC1F
-#define RegisterExpected 0xD61F0000
-
-#define CondTest 0xFF000010
-#define CondExpected 0x54000000
-
 #define EQ 0x0
 #define NE 0x1
 #define GE 0xA
@@ -17,68 +8,99 @@
 #define GT 0xC
 #define LE 0xD
 #define AL 0xE
+#define LINK_REG 30
 
-bool exec_branch_instr(emulstate state, ulong raw)
+// Unconditional branch, with the offset sign-extended at decode time
+static void exec_b(emulstate state, const decoded_t *d)
 {
-  // Unconditional branch
-  if ((raw & UncondTest) == UncondExpected){
-    ulong simm26 = get_value(raw,0,26);
-    ullong offset = sign_extend_64bit(simm26 * INSTR_SIZE, 25);
-    state->pc += offset;
-  }
+  state->pc += d->imm;
+}
 
-  // Register branch
-  else if ((raw & RegisterTest) == RegisterExpected){ 
-    byte xn = get_value(raw,5,5);
-    state->pc = get_reg(state, 1, xn);
-  }
+// Register branch
+static void exec_br(emulstate state, const decoded_t *d)
+{
+  state->pc = state->regs[d->rn];
+}
 
-  // Conditional branch
-  else if ((raw & CondTest) == CondExpected) {
-    ulong simm19 = get_value(raw,5,19);
-    ullong offset = sign_extend_64bit(simm19 * INSTR_SIZE, 18);
-    byte cond = get_value(raw,0,4);
-    bool execute = 0;
+// Branch with link, to a call returning to the next instruction
+static void exec_bl(emulstate state, const decoded_t *d)
+{
+  state->regs[LINK_REG] = state->pc + INSTR_SIZE;
+  state->pc += d->imm;
+}
+
+// Register branch with link, reading the target before the link is written, as for BLR X30
+static void exec_blr(emulstate state, const decoded_t *d)
+{
+  ullong target = state->regs[d->rn];
+  state->regs[LINK_REG] = state->pc + INSTR_SIZE;
+  state->pc = target;
+}
 
+// Conditional branch
+static void exec_bcond(emulstate state, const decoded_t *d)
+{
+  if (cond_holds(&state->pstate, d->cond))
+  {
+    state->pc += d->imm;
+  }
+  else
+  {
+    state->pc += INSTR_SIZE;
+  }
+}
+
+bool decode_branch_instr(ulong raw, decoded_t *d, isa_op op)
+{
+  switch (op)
+  {
+  case OP_B:
+  {
+    ulong simm26 = get_value(raw, 0, 26);
+    d->imm = sign_extend_64bit(simm26 * INSTR_SIZE, 25);
+    d->exec = exec_b;
+    return true;
+  }
+  case OP_BL:
+  {
+    ulong simm26 = get_value(raw, 0, 26);
+    d->imm = sign_extend_64bit(simm26 * INSTR_SIZE, 25);
+    d->exec = exec_bl;
+    return true;
+  }
+  case OP_BR:
+  case OP_RET: // a BR hinting at a return
+    d->rn = get_value(raw, 5, 5);
+    d->exec = exec_br;
+    return true;
+  case OP_BLR:
+    d->rn = get_value(raw, 5, 5);
+    d->exec = exec_blr;
+    return true;
+  case OP_BCOND:
+  {
+    ulong simm19 = get_value(raw, 5, 19);
+    d->imm = sign_extend_64bit(simm19 * INSTR_SIZE, 18);
+    d->cond = get_value(raw, 0, 4);
     // Determining conditions
-    switch (cond){
-      case EQ:
-        {execute = (state->pstate.zero == 1);
-        break;}
-      case NE:
-        {execute = (state->pstate.zero == 0);
-        break;}
-      case GE:
-        {execute = (state->pstate.negative == state->pstate.overflow);
-        break;}
-      case LT:
-        {execute = (state->pstate.negative != state->pstate.overflow);
-        break;}
-      case GT:
-        {execute = (state->pstate.zero == 0) && (state->pstate.negative == state->pstate.overflow);
-        break;}
-      case LE:
-        {execute = !((state->pstate.zero == 0) && (state->pstate.negative == state->pstate.overflow));
-        break;}
-      case AL:
-        {execute = 1;
-        break;}
-      default:
-        return false;
-    }
-    if (execute) {
-      state->pc += offset;
-    }
-    else{ 
-      state->pc += INSTR_SIZE;
+    switch (d->cond)
+    {
+    case EQ:
+    case NE:
+    case GE:
+    case LT:
+    case GT:
+    case LE:
+    case AL:
+      d->exec = exec_bcond;
+      return true;
+    default:
+      return false;
     }
   }
-
-  else {
+  default:
     return false;
   }
-
-  return true;
 }
 
 ullong sign_extend_64bit(ullong n, int sign_bit)
@@ -1,7 +1,8 @@
 #include "emulator.h"
+#include "decode.h"
 
 typedef unsigned long ulong;
 
-extern bool exec_branch_instr(emulstate state, ulong raw);
+extern bool decode_branch_instr(ulong raw, decoded_t *d, isa_op op);
 
 extern ullong sign_extend_64bit(ullong n, int sign_bit);
\ No newline at end of file
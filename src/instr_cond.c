@@ -1,33 +1,6 @@
-#include "instr_dpreg.h"
+#include "instr_cond.h"
 #include <stdbool.h>
 
-// Initialising Masks
-
-// 0b01111111111000000000110000000000
-#define CSEL_TEST 0x7FE00C00
-// 0b00011010100000000000000000000000
-#define CSEL_EXPECTED 0x1A800000
-// 0b01111111111111110000111111100000
-#define CSET_TEST 0x7FFF0FE0
-// 0b00011010100111110000011111100000
-#define CSET_EXPECTED 0x1A9F07E0
-// 0b01111111111111110000111111100000
-#define CSETM_TEST 0x7FFF0FE0
-// 0b01011010100111110000001111100000
-#define CSETM_EXPECTED 0x5A9F03E0
-// 0b01111111111000000000110000000000
-#define CSINC_TEST 0x7FE00C00
-// 0b00011010100000000000010000000000
-#define CSINC_EXPECTED 0x1A800400
-// 0b01111111111000000000110000000000
-#define CSINV_TEST 0x7FE00C00
-// 0b01011010100000000000000000000000
-#define CSINV_EXPECTED 0x5A800000
-// 0b01111111111000000000110000000000
-#define CSNEG_TEST 0x7FE00C00
-// 0b01011010100000000000010000000000
-#define CSNEG_EXPECTED 0x5A800400
-
 // Initializing conditions
 #define EQ 0x0
 #define NE 0x1
@@ -37,132 +10,99 @@
 #define LE 0xD
 #define AL 0xE
 
-#define MSB_64_BIT 0x8000000000000000;
-#define MSB_32_BIT 0x80000000;
 
-bool exec_cond_instr(emulstate state, ulong raw) {
+// Conditional selects: rd = cond ? rn : f(rm), or the constants of CSET/CSETM.
+#define DEFINE_CSEL(name, width, dest, else_value)                 \
+  static void name##_##width##_##dest(emulstate state, const decoded_t *d) \
+  {                                                                 \
+    ullong rm_value = REG(state, width, d->rm);                     \
+    if (cond_holds(&state->pstate, d->cond))                        \
+      SET_##dest(state, d, REG(state, width, d->rn));               \
+    else                                                            \
+      SET_##dest(state, d, W##width(else_value(rm_value, width)));  \
+    state->pc += INSTR_SIZE;                                        \
+  }
+#define DEFINE_CSET(name, width, dest, set_value)                  \
+  static void name##_##width##_##dest(emulstate state, const decoded_t *d) \
+  {                                                                 \
+    SET_##dest(state, d, cond_holds(&state->pstate, d->cond) ? W##width(set_value) : 0); \
+    state->pc += INSTR_SIZE;                                        \
+  }
+
+#define ELSE_csel(rm, width) (rm)
+#define ELSE_csinc(rm, width) ((rm) + 1)
+#define ELSE_csinv(rm, width) (~(rm))
+#define ELSE_csneg(rm, width) ((rm) ^ (1ull << (width - 1)))
+
+DEFINE_VARIANTS(DEFINE_CSEL, csel, ELSE_csel)
+DEFINE_VARIANTS(DEFINE_CSEL, csinc, ELSE_csinc)
+DEFINE_VARIANTS(DEFINE_CSEL, csinv, ELSE_csinv)
+DEFINE_VARIANTS(DEFINE_CSEL, csneg, ELSE_csneg)
+DEFINE_VARIANTS(DEFINE_CSET, cset, 1)
+DEFINE_VARIANTS(DEFINE_CSET, csetm, ~0ull)
+
+// Invalid conditional selects are ignored
+static void ignore_cond(emulstate state, const decoded_t *d)
+{
+    state->pc += INSTR_SIZE;
+}
+
+static const exec_fn csel_handlers[2][2] = VARIANTS(csel);
+static const exec_fn cset_handlers[2][2] = VARIANTS(cset);
+static const exec_fn csetm_handlers[2][2] = VARIANTS(csetm);
+static const exec_fn csinc_handlers[2][2] = VARIANTS(csinc);
+static const exec_fn csinv_handlers[2][2] = VARIANTS(csinv);
+static const exec_fn csneg_handlers[2][2] = VARIANTS(csneg);
+
+bool decode_cond_instr(ulong raw, decoded_t *d, isa_op op)
+{
     bool sf = get_value(raw, 31, 1);
-    byte condition = get_value(raw, 12, 4);
-    byte rd_addr = get_value(raw, 0, 5);
-    bool execute = 0;
+    d->cond = get_value(raw, 12, 4);
+    d->rd = get_value(raw, 0, 5);
+    d->rn = get_value(raw, 5, 5);
+    d->rm = get_value(raw, 16, 5);
+    bool zr = d->rd == GENERAL_REGS;
+    d->exec = ignore_cond;
 
     // Determining conditions
-    switch (condition){
+    switch (d->cond){
     case EQ:
-        {execute = (state->pstate.zero == 1);
-        break;}
     case NE:
-        {execute = (state->pstate.zero == 0);
-        break;}
     case GE:
-        {execute = (state->pstate.negative == state->pstate.overflow);
-        break;}
     case LT:
-        {execute = (state->pstate.negative != state->pstate.overflow);
-        break;}
     case GT:
-        {execute = (state->pstate.zero == 0) && (state->pstate.negative == state->pstate.overflow);
-        break;}
     case LE:
-        {execute = !((state->pstate.zero == 0) && (state->pstate.negative == state->pstate.overflow));
-        break;}
     case AL:
-        {execute = 1;
-        break;}
+        break;
     default:
-        return false;
-    }
-
-    bool csel = (raw & CSEL_TEST) == CSEL_EXPECTED;
-    bool cset = (raw & CSET_TEST) == CSET_EXPECTED;
-    bool csetm = (raw & CSETM_TEST) == CSETM_EXPECTED;
-    bool csinc = (raw & CSINC_TEST) == CSINC_EXPECTED;
-    bool csinv = (raw & CSINV_TEST) == CSINV_EXPECTED;
-    bool csneg = (raw & CSNEG_TEST) == CSNEG_EXPECTED;
-
-    if (csel) {
-        byte rn_addr = get_value(raw, 5, 5);
-        byte rm_addr = get_value(raw, 16, 5);
-        ullong rn_value = get_reg(state, sf, rn_addr);
-        ullong rm_value = get_reg(state, sf, rm_addr);
-
-        if (execute) {
-            set_reg(state, sf, rd_addr, rn_value);
-        }
-        else{ 
-            set_reg(state, sf, rd_addr, rm_value);
-        }
-    }
-    else if (cset) {
-        if (condition == AL) {
-            return false;
-        }
-        if (execute) {
-            set_reg(state, sf, rd_addr, 0x1);
-        }
-        else{ 
-            set_reg(state, sf, rd_addr, 0x0);
-        }
-    }
-    else if (csetm) {
-        if (condition == AL) {
-            return false;
-        }
-        if (execute) {
-            set_reg(state, sf, rd_addr, ~((ullong) 0x0));
-        }
-        else{ 
-            set_reg(state, sf, rd_addr, 0x0);
-        }
-    }
-    else if (csinc) {
-        byte rn_addr = get_value(raw, 5, 5);
-        byte rm_addr = get_value(raw, 16, 5);
-        ullong rn_value = get_reg(state, sf, rn_addr);
-        ullong rm_value = get_reg(state, sf, rm_addr);
-
-        if (execute) {
-            set_reg(state, sf, rd_addr, rn_value);
-        }
-        else{ 
-            set_reg(state, sf, rd_addr, (rm_value + 1));
-        }
-    }
-    else if (csinv) {
-        byte rn_addr = get_value(raw, 5, 5);
-        byte rm_addr = get_value(raw, 16, 5);
-        ullong rn_value = get_reg(state, sf, rn_addr);
-        ullong rm_value = get_reg(state, sf, rm_addr);
-
-        if (execute) {
-            set_reg(state, sf, rd_addr, rn_value);
-        }
-        else{ 
-            set_reg(state, sf, rd_addr, ~rm_value);
-        }
+        return true;
     }
-    else if (csneg) {
-        byte rn_addr = get_value(raw, 5, 5);
-        byte rm_addr = get_value(raw, 16, 5);
-        ullong rn_value = get_reg(state, sf, rn_addr);
-        ullong rm_value = get_reg(state, sf, rm_addr);
 
-        if (execute) {
-            set_reg(state, sf, rd_addr, rn_value);
+    switch (op) {
+    case OP_CSEL:
+        d->exec = csel_handlers[sf][zr];
+        break;
+    case OP_CSET:
+        if (d->cond != AL) {
+            d->exec = cset_handlers[sf][zr];
         }
-        else{
-            ullong new_rm_value = rm_value;
-            if (sf) {
-                new_rm_value ^= MSB_64_BIT;
-            }
-            else {
-                new_rm_value ^= MSB_32_BIT;
-            }
-            set_reg(state, sf, rd_addr, new_rm_value);
+        break;
+    case OP_CSETM:
+        if (d->cond != AL) {
+            d->exec = csetm_handlers[sf][zr];
         }
-    }
-    else {
-        return false;
+        break;
+    case OP_CSINC:
+        d->exec = csinc_handlers[sf][zr];
+        break;
+    case OP_CSINV:
+        d->exec = csinv_handlers[sf][zr];
+        break;
+    case OP_CSNEG:
+        d->exec = csneg_handlers[sf][zr];
+        break;
+    default:
+        break;
     }
     return true;
 }
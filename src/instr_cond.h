@@ -1,5 +1,6 @@
 #include "emulator.h"
+#include "decode.h"
 
 typedef unsigned long ulong;
 
-extern bool exec_cond_instr(emulstate state, ulong raw);
\ No newline at end of file
+extern bool decode_cond_instr(ulong raw, decoded_t *d, isa_op op);
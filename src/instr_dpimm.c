@@ -2,8 +2,6 @@
 #include <stdint.h>
 #include "instr_dpimm.h"
 
-#define arith_instr 2
-#define wide_move_instr 5
 #define ADD 0
 #define ADDS 1
 #define SUB 2
@@ -11,89 +9,166 @@
 #define MOVN 0
 #define MOVZ 2
 #define MOVK 3
+#define NE 0x1
 
-bool exec_dpimm_instr(emulstate state, ulong raw)
+// Condition flags of the arithmetic instructions, computed from the full (unmasked) result,
+// so a carry out of a 32-bit ADDS also sets N. Note ADDS leaves V unchanged, and SUBS clears it.
+#define NO_FLAGS(width)
+#define ADD_FLAGS(width)                          \
+  state->pstate.negative = (result >> (width - 1)) != 0; \
+  state->pstate.zero = result == 0;               \
+  state->pstate.carry = result < rn_val;
+#define SUB_FLAGS(width)                          \
+  state->pstate.negative = (result >> (width - 1)) != 0; \
+  state->pstate.zero = result == 0;               \
+  state->pstate.carry = rn_val >= d->imm;         \
+  state->pstate.overflow = 0;
+
+// rd = rn (+|-) imm, with the shift of imm12 applied at decode time
+#define DEFINE_ARITH_PC(name, width, dest, op_flags, pc)             \
+  static void name##_##width##_##dest(emulstate state, const decoded_t *d) \
+  {                                                                 \
+    ullong rn_val = REG(state, width, d->rn);                       \
+    ullong result = rn_val ARITH_##op_flags;                        \
+    SET_##dest(state, d, W##width(result));                         \
+    FLAGS_##op_flags(width)                                         \
+    pc(state, d);                                                   \
+  }
+#define DEFINE_ARITH(name, width, dest, op_flags) DEFINE_ARITH_PC(name, width, dest, op_flags, PC_NEXT)
+// ADDS/SUBS fused with the B.cond after them, as in compare-and-branch loops
+#define DEFINE_ARITH_BCOND(name, width, dest, op_flags) DEFINE_ARITH_PC(name, width, dest, op_flags, PC_BCOND)
+#define ARITH_add + d->imm
+#define ARITH_adds + d->imm
+#define ARITH_sub - d->imm
+#define ARITH_subs - d->imm
+#define FLAGS_add NO_FLAGS
+#define FLAGS_adds ADD_FLAGS
+#define FLAGS_sub NO_FLAGS
+#define FLAGS_subs SUB_FLAGS
+
+DEFINE_VARIANTS(DEFINE_ARITH, add_imm, add)
+DEFINE_VARIANTS(DEFINE_ARITH, adds_imm, adds)
+DEFINE_VARIANTS(DEFINE_ARITH, sub_imm, sub)
+DEFINE_VARIANTS(DEFINE_ARITH, subs_imm, subs)
+DEFINE_VARIANTS(DEFINE_ARITH_BCOND, adds_imm_bcond, adds)
+DEFINE_VARIANTS(DEFINE_ARITH_BCOND, subs_imm_bcond, subs)
+
+// SUBS counting a register down to zero in a B.NE loop to itself, as in busy-wait loops.
+// When the count is exact, the remaining iterations are skipped, leaving registers, flags
+// and the instruction count as the last iteration would. Iterations past the instruction
+// limit of the state or its next event are left to run, so budgets stop busy-waits too, and
+// timer interrupts are taken on time.
+#define DEFINE_IDLE_LOOP(name, width, dest, unused)                \
+  static void name##_##width##_##dest(emulstate state, const decoded_t *d) \
+  {                                                                 \
+    ullong rn_val = REG(state, width, d->rn);                       \
+    if (rn_val == 0 || rn_val % d->imm != 0)                        \
+    {                                                               \
+      subs_imm_bcond_##width##_##dest(state, d);                    \
+      return;                                                       \
+    }                                                               \
+    ullong skip = rn_val / d->imm - 1;                              \
+    ullong stop = state->next_event; /* or the limit, if first */   \
+    ullong left = state->insns < stop                               \
+                      ? (stop - state->insns) / 2                   \
+                      : 0;                                          \
+    if (skip > left)                                                \
+    {                                                               \
+      /* rd is rn, and not the zero register as rn_val != 0 */      \
+      state->insns += 2 * left;                                     \
+      SET_##dest(state, d, W##width(rn_val - left * d->imm));       \
+      subs_imm_bcond_##width##_##dest(state, d);                    \
+      return;                                                       \
+    }                                                               \
+    state->insns += 2 * skip;                                       \
+    SET_##dest(state, d, 0);                                        \
+    state->pstate.negative = 0;                                     \
+    state->pstate.zero = 1;                                         \
+    state->pstate.carry = 1;                                        \
+    state->pstate.overflow = 0;                                     \
+    state->pc += 2 * INSTR_SIZE;                                    \
+  }
+
+DEFINE_VARIANTS(DEFINE_IDLE_LOOP, idle_loop, 0)
+
+// MOVZ and MOVN, with the inverted operand of MOVN computed at decode time.
+// A MOVK following them is folded into the constant by the PC_PAIR variant.
+#define DEFINE_MOV(name, width, dest, pc)                          \
+  static void name##_##width##_##dest(emulstate state, const decoded_t *d) \
+  {                                                                 \
+    SET_##dest(state, d, W##width(d->imm));                         \
+    pc(state, d);                                                   \
+  }
+
+// MOVK keeps the bits of rd outside the 16-bit field at `shift`
+#define DEFINE_MOVK(name, width, dest, unused)                     \
+  static void name##_##width##_##dest(emulstate state, const decoded_t *d) \
+  {                                                                 \
+    ullong rd_val = REG(state, width, d->rd);                       \
+    rd_val &= ~(0xFFFFull << d->shift);                             \
+    SET_##dest(state, d, W##width(rd_val | d->imm));                \
+    state->pc += INSTR_SIZE;                                        \
+  }
+
+DEFINE_VARIANTS(DEFINE_MOV, mov_imm, PC_NEXT)
+DEFINE_VARIANTS(DEFINE_MOV, mov_imm_pair, PC_PAIR)
+DEFINE_VARIANTS(DEFINE_MOVK, movk, 0)
+
+static const exec_fn arith_handlers[4][2][2] = {
+    VARIANTS(add_imm), VARIANTS(adds_imm), VARIANTS(sub_imm), VARIANTS(subs_imm)};
+// Indexed by [opc == SUBS][sf][rd == ZR]
+static const exec_fn arith_bcond_handlers[2][2][2] = {VARIANTS(adds_imm_bcond), VARIANTS(subs_imm_bcond)};
+static const exec_fn idle_loop_handlers[2][2] = VARIANTS(idle_loop);
+static const exec_fn mov_imm_handlers[2][2] = VARIANTS(mov_imm);
+static const exec_fn mov_imm_pair_handlers[2][2] = VARIANTS(mov_imm_pair);
+static const exec_fn movk_handlers[2][2] = VARIANTS(movk);
+
+bool decode_dpimm_instr(ulong raw, decoded_t *d, isa_op op)
 {
   bool sf = get_value(raw, 31, 1); // 0=32-bit, 1=64-bit
   ulong rd = get_value(raw, 0, 5); // 11111=Zero Register
   ulong opc = get_value(raw, 29, 2);
-  ulong operand = get_value(raw, 5, 18);
-  ulong opi = get_value(raw, 23, 3);
+  bool zr = rd == GENERAL_REGS;
+  d->rd = rd;
 
-  if (opi == arith_instr)
+  if (op == OP_ARITH_IMM)
   {
     // Arithmetic instructions
     bool sh = get_value(raw, 22, 1);
     ulong imm12 = get_value(raw, 10, 12);
-    ulong rn = get_value(raw, 5, 5);
-    ullong rn_val = get_reg(state, sf, rn);
-    ullong result;
-
-    if (sh)
-    {
-      imm12 <<= 12;
-    }
-
-    switch (opc)
-    {
-    case ADD:
-    {
-      result = rn_val + imm12;
-      set_reg(state, sf, rd, result);
-      return true;
-    }
-    case ADDS:
+    d->rn = get_value(raw, 5, 5);
+    d->imm = sh ? imm12 << 12 : imm12;
+    // Register 31 is SP, but for the destination of ADDS and SUBS
+    if (d->rn == GENERAL_REGS)
+      d->rn = SP_REG;
+    if (zr && (opc == ADD || opc == SUB))
     {
-      result = rn_val + imm12;
-      set_reg(state, sf, rd, result);
-      set_pstate_flags(state, sf, result, rn_val, imm12, true); // update condition flags
-      return true;
-    }
-    case SUB:
-    {
-      result = rn_val - imm12;
-      set_reg(state, sf, rd, result);
-      return true;
-    }
-    case SUBS:
-    {
-      result = rn_val - imm12;
-      set_reg(state, sf, rd, result);
-      set_pstate_flags(state, sf, result, rn_val, imm12, false);
-      return true;
-    }
-    default:
-      return false;
+      d->rd = SP_REG;
+      zr = false;
     }
+    d->exec = arith_handlers[opc][sf][zr];
+    return true;
   }
-  else if (opi == wide_move_instr)
+  else if (op == OP_WIDE_MOVE)
   {
     // Wide move instructions
     ulong hw = get_value(raw, 21, 2);
     ulong imm16 = get_value(raw, 5, 16);
-    operand = imm16 << (hw * 16);
+    d->shift = hw * 16;
+    d->imm = (ullong)imm16 << d->shift;
 
     switch (opc)
     {
     case MOVN:
-    {
-      operand = ~operand;
-      set_reg(state, sf, rd, operand);
+      d->imm = ~d->imm;
+      d->exec = mov_imm_handlers[sf][zr];
       return true;
-    }
     case MOVZ:
-      set_reg(state, sf, rd, operand);
+      d->exec = mov_imm_handlers[sf][zr];
       return true;
     case MOVK:
-    {
-      ullong rd_val = get_reg(state, sf, rd);
-      ulong shift = hw * 16;
-      ulong mask = 0xFFFFul << shift;
-      rd_val &= ~(mask);
-      rd_val |= (imm16 << shift); // (rd_val & ~mask) | (imm16 << shift)
-      set_reg(state, sf, rd, rd_val);
+      d->exec = movk_handlers[sf][zr];
       return true;
-    }
     default:
       return false;
     }
@@ -101,32 +176,33 @@ bool exec_dpimm_instr(emulstate state, ulong raw)
   return false;
 }
 
-void set_pstate_flags(emulstate state, bool sf, ullong result, ullong rn, ullong op2, bool add)
+void fuse_dpimm_instr(decoded_t *d, isa_op op, isa_op next_op)
 {
-  // Set flags
-  if (sf)
-  {
-    state->pstate.negative = (result >> 63) != 0;
-  }
-  else
-  {
-    state->pstate.negative = (result >> 31) != 0;
-  }
-  state->pstate.zero = (result == 0);
-  if (add)
+  const decoded_t *next = d + 1;
+  bool sf = get_value(d->raw, 31, 1);
+  ulong opc = get_value(d->raw, 29, 2);
+  bool zr = d->rd == GENERAL_REGS;
+
+  if (op == OP_ARITH_IMM && (opc == ADDS || opc == SUBS) && next_op == OP_BCOND)
   {
-    state->pstate.carry = (result < rn);
-    if (((rn ^ op2) >= 0) && ((rn ^ result) < 0))
+    // Compare and branch
+    d->exec = arith_bcond_handlers[opc == SUBS][sf][zr];
+    d->insns = 2;
+    if (opc == SUBS && d->rd == d->rn && d->imm != 0 && next->cond == NE &&
+        next->imm == (ullong)-INSTR_SIZE)
     {
-      state->pstate.overflow = 1;
+      d->exec = idle_loop_handlers[sf][zr];
     }
-  } else
+  }
+  else if (op == OP_WIDE_MOVE && opc != MOVK && next_op == OP_WIDE_MOVE &&
+           get_value(next->raw, 29, 2) == MOVK && get_value(next->raw, 31, 1) == sf &&
+           next->rd == d->rd)
   {
-    state->pstate.carry = (rn >= op2);
-    state->pstate.overflow = 0;
-    if (((rn ^ op2) < 0) && ((rn ^ result) < 0))
-    {
-      state->pstate.overflow = 1;
-    }
+    // MOVZ/MOVN then MOVK of the same register load a constant
+    ullong value = sf ? W64(d->imm) : W32(d->imm);
+    value &= ~(0xFFFFull << next->shift);
+    d->imm = value | next->imm;
+    d->exec = mov_imm_pair_handlers[sf][zr];
+    d->insns = 2;
   }
 }
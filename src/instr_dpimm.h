@@ -1,6 +1,7 @@
 #include "emulator.h"
+#include "decode.h"
 
 typedef unsigned long ulong;
 
-extern void set_pstate_flags(emulstate state, bool sf, ullong result, ullong rn, ullong op2, bool add);
-extern bool exec_dpimm_instr(emulstate state, ulong raw);
\ No newline at end of file
+extern bool decode_dpimm_instr(ulong raw, decoded_t *d, isa_op op);
+extern void fuse_dpimm_instr(decoded_t *d, isa_op op, isa_op next_op);
@@ -1,44 +1,183 @@
 #include "instr_dpreg.h"
 #include <stdbool.h>
 
-// Initialising Masks
-
-// 0b1001
-#define ARITHMETIC_TEST 9
-// 0b1000
-#define ARITHMETIC_EXPECTED 8
-// 0b1000
-#define BIT_LOGIC_TEST 8
-// 0b0000
-#define BIT_LOGIC_EXPECTED 0
-// 0b1111
-#define MULTIPLY_TEST 15
-// 0b1000
-#define MULTIPLY_EXPECTED 8
-// 0b1
-#define LSB_MASK 1
-#define ASR_32BIT_MASK 0xFFFFFFFF
-#define ASR_64BIT_MASK 0xFFFFFFFFFFFFFFFF
-
-bool exec_dpreg_instr(emulstate state, ulong raw)
-{
+#define LSL 0
+#define LSR 1
+#define ASR 2
+#define ROR 3
+
+#define ANDS 3
+#define ADDS 1
+#define SUBS 3
+
+// Applies the shift of a shifted register operand, within the register width.
+#define DEFINE_SHIFT(width, int_type)                              \
+  static ullong shift_##width(ullong rm, byte stype, byte amount)  \
+  {                                                                \
+    switch (stype)                                                 \
+    {                                                              \
+    case LSL:                                                      \
+      return W##width(rm << amount);                               \
+    case LSR:                                                      \
+      return rm >> amount;                                         \
+    case ASR:                                                      \
+      return W##width((int_type)rm >> amount);                     \
+    default:                                                       \
+      if (amount == 0)                                             \
+        return rm;                                                 \
+      return W##width((rm >> amount) | (rm << (width - amount)));  \
+    }                                                              \
+  }
+DEFINE_SHIFT(32, int)
+DEFINE_SHIFT(64, llong)
+
+// Condition flags of the flag-setting instructions, computed from the masked result.
+// Note V is always cleared.
+#define NO_FLAGS(width)
+#define LOGIC_FLAGS(width)                          \
+  state->pstate.negative = MSB##width(rd_value);    \
+  state->pstate.zero = rd_value == 0;               \
+  state->pstate.carry = 0;                          \
+  state->pstate.overflow = 0;
+#define ADD_FLAGS(width)                            \
+  state->pstate.negative = MSB##width(rd_value);    \
+  state->pstate.zero = rd_value == 0;               \
+  state->pstate.carry = rd_value < rn_value;        \
+  state->pstate.overflow = 0;
+#define SUB_FLAGS(width)                            \
+  state->pstate.negative = MSB##width(rd_value);    \
+  state->pstate.zero = rd_value == 0;               \
+  state->pstate.carry = rd_value <= rn_value;       \
+  state->pstate.overflow = 0;
+
+// Operations on (rn, rm) of the logical and arithmetic instructions, and their flags
+#define OP_and(rn, rm) ((rn) & (rm))
+#define OP_bic(rn, rm) ((rn) & ~(rm))
+#define OP_orr(rn, rm) ((rn) | (rm))
+#define OP_orn(rn, rm) ((rn) | ~(rm))
+#define OP_eor(rn, rm) ((rn) ^ (rm))
+#define OP_eon(rn, rm) ((rn) ^ ~(rm))
+#define OP_ands OP_and
+#define OP_bics OP_bic
+#define OP_add(rn, rm) ((rn) + (rm))
+#define OP_adds OP_add
+#define OP_sub(rn, rm) ((rn) - (rm))
+#define OP_subs OP_sub
+#define FLAGS_and NO_FLAGS
+#define FLAGS_bic NO_FLAGS
+#define FLAGS_orr NO_FLAGS
+#define FLAGS_orn NO_FLAGS
+#define FLAGS_eor NO_FLAGS
+#define FLAGS_eon NO_FLAGS
+#define FLAGS_ands LOGIC_FLAGS
+#define FLAGS_bics LOGIC_FLAGS
+#define FLAGS_add NO_FLAGS
+#define FLAGS_adds ADD_FLAGS
+#define FLAGS_sub NO_FLAGS
+#define FLAGS_subs SUB_FLAGS
+
+// rd = rn op rm, with rm used as is
+#define DEFINE_REG_OP_PC(name, width, dest, op, pc)                \
+  static void name##_##width##_##dest(emulstate state, const decoded_t *d) \
+  {                                                                 \
+    ullong rn_value = REG(state, width, d->rn);                     \
+    ullong rd_value = W##width(OP_##op(rn_value, REG(state, width, d->rm))); \
+    SET_##dest(state, d, rd_value);                                 \
+    FLAGS_##op(width)                                               \
+    pc(state, d);                                                   \
+  }
+
+// rd = rn op shift(rm)
+#define DEFINE_SHIFTED_OP_PC(name, width, dest, op, pc)            \
+  static void name##_##width##_##dest(emulstate state, const decoded_t *d) \
+  {                                                                 \
+    ullong rn_value = REG(state, width, d->rn);                     \
+    ullong rm_value = shift_##width(REG(state, width, d->rm), d->stype, d->shift); \
+    ullong rd_value = W##width(OP_##op(rn_value, rm_value));        \
+    SET_##dest(state, d, rd_value);                                 \
+    FLAGS_##op(width)                                               \
+    pc(state, d);                                                   \
+  }
+
+#define DEFINE_REG_OP(name, width, dest, op) DEFINE_REG_OP_PC(name, width, dest, op, PC_NEXT)
+#define DEFINE_SHIFTED_OP(name, width, dest, op) DEFINE_SHIFTED_OP_PC(name, width, dest, op, PC_NEXT)
+#define DEFINE_REG_OP_BCOND(name, width, dest, op) DEFINE_REG_OP_PC(name, width, dest, op, PC_BCOND)
+#define DEFINE_SHIFTED_OP_BCOND(name, width, dest, op) DEFINE_SHIFTED_OP_PC(name, width, dest, op, PC_BCOND)
+
+// Handlers of an operation, in both operand forms
+#define DEFINE_OP(op)                                \
+  DEFINE_VARIANTS(DEFINE_REG_OP, op##_reg, op)       \
+  DEFINE_VARIANTS(DEFINE_SHIFTED_OP, op##_shifted, op)
+#define OP_VARIANTS(op) {VARIANTS(op##_reg), VARIANTS(op##_shifted)}
+// Flag-setting operations also have handlers fused with the B.cond after them
+#define DEFINE_FLAG_OP(op)                                         \
+  DEFINE_OP(op)                                                    \
+  DEFINE_VARIANTS(DEFINE_REG_OP_BCOND, op##_reg_bcond, op)         \
+  DEFINE_VARIANTS(DEFINE_SHIFTED_OP_BCOND, op##_shifted_bcond, op)
+#define BCOND_VARIANTS(op) {VARIANTS(op##_reg_bcond), VARIANTS(op##_shifted_bcond)}
 
+DEFINE_OP(and)
+DEFINE_OP(bic)
+DEFINE_OP(orr)
+DEFINE_OP(orn)
+DEFINE_OP(eor)
+DEFINE_OP(eon)
+DEFINE_FLAG_OP(ands)
+DEFINE_FLAG_OP(bics)
+DEFINE_OP(add)
+DEFINE_FLAG_OP(adds)
+DEFINE_OP(sub)
+DEFINE_FLAG_OP(subs)
+
+// rd = ra (+|-) rn * rm
+#define DEFINE_MULTIPLY(name, width, dest, op)                     \
+  static void name##_##width##_##dest(emulstate state, const decoded_t *d) \
+  {                                                                 \
+    ullong product = REG(state, width, d->rn) * REG(state, width, d->rm); \
+    SET_##dest(state, d, W##width(REG(state, width, d->ra) op product)); \
+    state->pc += INSTR_SIZE;                                        \
+  }
+
+DEFINE_VARIANTS(DEFINE_MULTIPLY, madd, +)
+DEFINE_VARIANTS(DEFINE_MULTIPLY, msub, -)
+
+// Encodings that are neither logical, arithmetic nor multiply only truncate rd to the width.
+#define DEFINE_KEEP_RD(name, width, dest, unused)                  \
+  static void name##_##width##_##dest(emulstate state, const decoded_t *d) \
+  {                                                                 \
+    SET_##dest(state, d, REG(state, width, d->rd));                 \
+    state->pc += INSTR_SIZE;                                        \
+  }
+
+DEFINE_VARIANTS(DEFINE_KEEP_RD, keep_rd, 0)
+
+// Indexed by [N][opc][shifted][sf][rd == ZR]
+static const exec_fn logic_handlers[2][4][2][2][2] = {
+    {OP_VARIANTS(and), OP_VARIANTS(orr), OP_VARIANTS(eor), OP_VARIANTS(ands)},
+    {OP_VARIANTS(bic), OP_VARIANTS(orn), OP_VARIANTS(eon), OP_VARIANTS(bics)}};
+// Indexed by [opc][shifted][sf][rd == ZR]
+static const exec_fn arith_handlers[4][2][2][2] = {
+    OP_VARIANTS(add), OP_VARIANTS(adds), OP_VARIANTS(sub), OP_VARIANTS(subs)};
+// Indexed by [N][shifted][sf][rd == ZR]
+static const exec_fn logic_bcond_handlers[2][2][2][2] = {BCOND_VARIANTS(ands), BCOND_VARIANTS(bics)};
+// Indexed by [opc == SUBS][shifted][sf][rd == ZR]
+static const exec_fn arith_bcond_handlers[2][2][2][2] = {BCOND_VARIANTS(adds), BCOND_VARIANTS(subs)};
+static const exec_fn multiply_handlers[2][2][2] = {VARIANTS(madd), VARIANTS(msub)};
+static const exec_fn keep_rd_handlers[2][2] = VARIANTS(keep_rd);
+
+bool decode_dpreg_instr(ulong raw, decoded_t *d, isa_op op)
+{
   bool sf = get_value(raw, 31, 1);
   bool M = get_value(raw, 28, 1);
-  byte rd_addr = get_value(raw, 0, 5);
-  byte rn_addr = get_value(raw, 5, 5);
-  byte rm_addr = get_value(raw, 16, 5);
   byte operand = get_value(raw, 10, 6);
   byte opr = get_value(raw, 21, 4);
   byte opc = get_value(raw, 29, 2);
-  ullong rd_value = get_reg(state, sf, rd_addr);
-  ullong rn_value = get_reg(state, sf, rn_addr);
-  ullong rm_value = get_reg(state, sf, rm_addr);
-
-  // Define operation
-  bool arithmetic = (opr & ARITHMETIC_TEST) == ARITHMETIC_EXPECTED;
-  bool bit_logic = (opr & BIT_LOGIC_TEST) == BIT_LOGIC_EXPECTED;
-  bool multiply = (opr & MULTIPLY_TEST) == MULTIPLY_EXPECTED;
+  d->rd = get_value(raw, 0, 5);
+  d->rn = get_value(raw, 5, 5);
+  d->rm = get_value(raw, 16, 5);
+  bool zr = d->rd == GENERAL_REGS;
+  bool N = get_value(opr, 0, 1);
+  bool shifted = operand != 0;
 
   if (!M)
   {
@@ -46,196 +185,58 @@ bool exec_dpreg_instr(emulstate state, ulong raw)
     {
       return false;
     }
-    
-    byte shift = get_value(opr, 1, 2);
-    bool N = get_value(opr, 0, 1);
-
-    // Shifts
-    switch (shift)
-    {
-      // LSL
-      case 0:
-        {rm_value <<= operand;
-        break;}
-      // LSR
-      case 1:
-        {rm_value >>= operand;
-        break;}
-      // ASR
-      case 2:
-        {bool MSB = 0;
-        if (sf) 
-        {
-          MSB = (rm_value >> 63) == 1;
-          rm_value >>= operand;
-          if (MSB)
-          {
-            rm_value |= (ASR_64BIT_MASK << (64 - operand));
-          }
-        }
-        else
-        {
-          MSB = (rm_value >> 31) == 1;
-          rm_value >>= operand;
-          if (MSB)
-          {
-            rm_value |= (ASR_32BIT_MASK << (32 - operand));
-          }
-        }
-        break;}
-      // ROR
-      case 3:
-        {if (!bit_logic)
-        {
-          return false;
-        }
-
-        for (int i = 0; i < operand; i++)
-        {
-          bool LSB = rm_value & LSB_MASK;
-          rm_value >>= 1;
-          if (LSB)
-          {
-            if (sf)
-            {
-              rm_value |= ((ullong) 1 << 63);
-            }
-            else 
-            {
-              rm_value |= ((ullong) 1 << 31);
-            }
-          }
-        }
-        break;}
-      default:
-        {return false;}
-    }
 
-    // Checking N (negate)
-    if (bit_logic && N) 
-    {
-      rm_value = ~rm_value;
-    }
+    d->stype = get_value(opr, 1, 2);
+    d->shift = operand;
 
-    if (bit_logic)
+    if (d->stype == ROR && op != OP_LOGIC_REG)
     {
-      switch (opc)
-      {
-      // and
-      case 0:
-        {rd_value = rn_value & rm_value;
-        rd_value = sf_checker(rd_value, sf);
-        break;}
-      // or
-      case 1:
-        {rd_value = rn_value | rm_value;
-        rd_value = sf_checker(rd_value, sf);
-        break;}
-      // xor
-      case 2:
-        {rd_value = rn_value ^ rm_value;
-        rd_value = sf_checker(rd_value, sf);
-        break;}
-      // and (setting flags)
-      case 3:
-        {rd_value = rn_value & rm_value;
-        rd_value = sf_checker(rd_value, sf);
-        if (sf) 
-        {
-          state->pstate.negative = (rd_value >> 63) == 1;
-        }
-        else 
-        {
-          state->pstate.negative = (rd_value >> 31) == 1;
-        }
-        state->pstate.zero = rd_value == 0;
-        state->pstate.carry = 0;
-        state->pstate.overflow = 0;
-        break;}
-      default:
-        {return false;}
-      }
-    }
-    else if (arithmetic)
-    {
-      switch (opc)
-      {
-      // add
-      case 0:
-        {rd_value = rn_value + rm_value;
-        rd_value = sf_checker(rd_value, sf);
-        break;}
-      // add (setting flags)
-      case 1:
-        {rd_value = rn_value + rm_value;
-        rd_value = sf_checker(rd_value, sf);
-        if (sf) 
-        {
-          state->pstate.negative = (rd_value >> 63) == 1;
-        }
-        else 
-        {
-          state->pstate.negative = (rd_value >> 31) == 1;
-        }
-        state->pstate.zero = rd_value == 0;
-        state->pstate.carry = rd_value < rn_value;
-        state->pstate.overflow = 0;
-        if (((rn_value ^ rm_value) >= 0) && ((rn_value ^ rd_value) < 0))
-        {
-          state->pstate.overflow = 1;
-        }
-        break;}
-      // subtract
-      case 2:
-        {rd_value = rn_value - rm_value;
-        rd_value = sf_checker(rd_value, sf);
-        break;}
-      // subtract (setting flags)
-      case 3:
-        {rd_value = rn_value - rm_value;
-        rd_value = sf_checker(rd_value, sf);
-        if (sf) 
-        {
-          state->pstate.negative = (rd_value >> 63) == 1;
-        }
-        else 
-        {
-          state->pstate.negative = (rd_value >> 31) == 1;
-        }
-        state->pstate.zero = rd_value == 0;
-        state->pstate.carry = rd_value <= rn_value;
-        state->pstate.overflow = 0;
-        if (((rn_value ^ rm_value) < 0) && ((rn_value ^ rd_value) < 0))
-        {
-          state->pstate.overflow = 1;
-        }
-        break;}
-      default:
-        {return false;}
-      }
+      return false;
     }
   }
-  else if (M && multiply)
+
+  switch (op)
+  {
+  case OP_LOGIC_REG:
+    d->exec = logic_handlers[N][opc][shifted][sf][zr];
+    break;
+  case OP_ARITH_REG:
+    d->exec = arith_handlers[opc][shifted][sf][zr];
+    break;
+  case OP_MULTIPLY:
   {
-    bool x = get_value(operand , 5, 1);
-    byte ra_addr = get_value(operand, 0, 5);
-    ullong ra_value = get_reg(state, sf, ra_addr);
+    bool x = get_value(operand, 5, 1);
+    d->ra = get_value(operand, 0, 5);
+    d->exec = multiply_handlers[x][sf][zr];
+    break;
+  }
+  default:
+    d->exec = keep_rd_handlers[sf][zr];
+  }
+  return true;
+}
 
-    // multiply-subtract
-    if (x)
-    {
+void fuse_dpreg_instr(decoded_t *d, isa_op op, isa_op next_op)
+{
+  bool sf = get_value(d->raw, 31, 1);
+  bool N = get_value(d->raw, 21, 1);
+  byte opc = get_value(d->raw, 29, 2);
+  bool zr = d->rd == GENERAL_REGS;
+  bool shifted = d->shift != 0;
 
-      rd_value = ra_value - (rn_value * rm_value);
-      rd_value = sf_checker(rd_value, sf);
-    }
-    // multiply - add
-    else 
-    {
-      rd_value = ra_value + (rn_value * rm_value);
-      rd_value = sf_checker(rd_value, sf);
-    }
+  if (next_op != OP_BCOND)
+  {
+    return;
+  }
+  // Compare (or test) and branch
+  if (op == OP_LOGIC_REG && opc == ANDS)
+  {
+    d->exec = logic_bcond_handlers[N][shifted][sf][zr];
+    d->insns = 2;
+  }
+  else if (op == OP_ARITH_REG && (opc == ADDS || opc == SUBS))
+  {
+    d->exec = arith_bcond_handlers[opc == SUBS][shifted][sf][zr];
+    d->insns = 2;
   }
-
-  set_reg(state, sf, rd_addr, rd_value);
-  return true;
 }
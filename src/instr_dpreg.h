@@ -1,5 +1,7 @@
 #include "emulator.h"
+#include "decode.h"
 
 typedef unsigned long ulong;
 
-extern bool exec_dpreg_instr(emulstate state, ulong raw);
\ No newline at end of file
+extern bool decode_dpreg_instr(ulong raw, decoded_t *d, isa_op op);
+extern void fuse_dpreg_instr(decoded_t *d, isa_op op, isa_op next_op);
@@ -1,106 +1,233 @@
 #include <stdbool.h>
 #include "instr_sdt.h"
+#include "instr_branch.h"
+#include "isa.h"
 
-// Testing masks
-// 0b101111101 << 23
-#define SDT_TEST 3196059648
-// 0b101110000 << 23
-#define SDT_EXPECTED 3087007744
-// 0b10111111 << 24
-#define LOAD_LITERAL_TEST 3204448256
-// 0b00011000 << 24
-#define LOAD_LITERAL_EXPECTED 402653184
-// 0b100000111111 << 10
-#define REG_OFFSET_TEST 2161664
-// 0b100000011010 << 10
-#define REG_OFFSET_EXPECTED 2123776
-// 0b100000000001 << 10
-#define INDEX_TEST 2098176
-// 0b000000000001 << 10
-#define INDEX_EXPECTED 1024
+// Indexing of loads and stores with an immediate offset (bits 11..10)
+#define INDEX_UNSCALED 0
+#define INDEX_POST 1
+#define INDEX_REGISTER 2 // with bit 21 set, else the unprivileged LDTR and STTR
+#define INDEX_PRE 3
+// opc of loads and stores (bits 23..22): sign-extending loads into X and W registers
+#define OPC_SIGNED_64 2
+#define OPC_SIGNED_32 3
+// opc of LDR (literal) (bits 31..30)
+#define LITERAL_OPC_64 1
+#define LITERAL_OPC_LDRSW 2
+#define LITERAL_OPC_PRFM 3
+// Addressing modes of LDP and STP (bits 24..23)
+#define PAIR_NO_ALLOCATE 0
+#define PAIR_POST 1
+#define PAIR_OFFSET 2
+#define PAIR_PRE 3
+// opc of LDP and STP (bits 31..30)
+#define PAIR_OPC_32 0
+#define PAIR_OPC_SIGNED 1 // LDPSW
+#define PAIR_OPC_64 2
 
-ulong sign_extend(ulong n, int sign_bit)
+// Extends the index register of the register offset mode by `option`
+static ullong extend_index(ullong index, byte option)
 {
-  if (n & (1 << sign_bit))
+  switch (option)
   {
-    // (ulong)(-1) gets all 1s with correct length of ulong
-    n |= (ulong)(-1) << (sign_bit + 1);
+  case EXTEND_UXTW:
+    return W32(index);
+  case EXTEND_SXTW:
+    return sign_extend_64bit(W32(index), 31);
+  default: // LSL and SXTX leave all 64 bits
+    return index;
   }
-  return n;
 }
 
-bool exec_sdt_instr(emulstate state, ulong raw)
+// Address of a transfer, in the addressing mode decoded in d->stype. The pre and
+// post-indexed modes write the offset address back to the base.
+static ullong sdt_address(emulstate state, const decoded_t *d)
 {
-  bool sf = get_value(raw, 30, 1);
-  bool L = true;
-  bool addr_set = false;
-  ullong addr = 0;
-  byte rt = get_value(raw, 0, 5);
+  ullong base = state->regs[d->rn];
+  switch (d->stype)
+  {
+  case SDT_REGISTER:
+    return base + (extend_index(state->regs[d->rm], d->cond) << d->imm);
+  case SDT_PRE:
+    state->regs[d->rn] = base + d->imm;
+    return base + d->imm;
+  case SDT_POST:
+    state->regs[d->rn] = base + d->imm;
+    return base;
+  case SDT_LITERAL:
+    return state->pc + d->imm;
+  default:
+    return base + d->imm;
+  }
+}
+
+// Loads d->shift bytes, sign-extended into a d->ra-bit register by signed loads
+static ullong load_value(emulstate state, const decoded_t *d, ullong address)
+{
+  ullong value = load_mem_size(state, d->shift, address);
+  if (d->ra == 0)
+    return value;
+  value = sign_extend_64bit(value, d->shift * 8 - 1);
+  return d->ra == 32 ? W32(value) : value;
+}
+
+static void exec_load(emulstate state, const decoded_t *d)
+{
+  ullong value = load_value(state, d, sdt_address(state, d));
+  set_reg(state, true, d->rd, value);
+  state->pc += INSTR_SIZE;
+}
+
+// Stores the register as it was before the base is written back
+static void exec_store(emulstate state, const decoded_t *d)
+{
+  ullong value = state->regs[d->rd];
+  store_mem_size(state, d->shift, sdt_address(state, d), value);
+  state->pc += INSTR_SIZE;
+}
+
+// LDP and LDPSW, of registers d->rd and d->rm, each d->shift bytes
+static void exec_ldp(emulstate state, const decoded_t *d)
+{
+  ullong address = sdt_address(state, d);
+  ullong first = load_value(state, d, address);
+  ullong second = load_value(state, d, address + d->shift);
+  set_reg(state, true, d->rd, first);
+  set_reg(state, true, d->rm, second);
+  state->pc += INSTR_SIZE;
+}
 
-  // Calculate offset
-  if ((raw & SDT_TEST) == SDT_EXPECTED)
+// STP, storing the registers as they were before the base is written back
+static void exec_stp(emulstate state, const decoded_t *d)
+{
+  ullong first = state->regs[d->rd];
+  ullong second = state->regs[d->rm];
+  ullong address = sdt_address(state, d);
+  store_mem_size(state, d->shift, address, first);
+  store_mem_size(state, d->shift, address + d->shift, second);
+  state->pc += INSTR_SIZE;
+}
+
+// Decodes the addressing mode of a load or store with register base, of size 1 << `size`
+static bool decode_sdt_mode(ulong raw, decoded_t *d, ulong size)
+{
+  if (get_value(raw, 24, 1))
+  {
+    d->stype = SDT_OFFSET;
+    d->imm = get_value(raw, 10, 12) << size;
+    return true;
+  }
+  ulong index = get_value(raw, 10, 2);
+  if (get_value(raw, 21, 1))
   {
-    bool U = get_value(raw, 24, 1);
-    L = get_value(raw, 22, 1);
-    byte xn = get_value(raw, 5, 5);
-    if (U)
-    {
-      // Unsigned offset
-      ulong imm12 = get_value(raw, 10, 12);
-      if (sf)
-      {
-        imm12 *= 8;
-      }
-      else
-      {
-        imm12 *= 4;
-      }
-      addr = get_reg(state, sf, xn) + imm12;
-      addr_set = true;
-    }
-    else if ((raw & REG_OFFSET_TEST) == REG_OFFSET_EXPECTED)
-    {
-      // Register offset
-      byte xm = get_value(raw, 16, 5);
-      addr = get_reg(state, sf, xn) + get_reg(state, sf, xm);
-      addr_set = true;
-    }
-    else if ((raw & INDEX_TEST) == INDEX_EXPECTED)
-    {
-      // Pre/post indexed offset
-      long simm9 = sign_extend(get_value(raw, 12, 9), 8);
-      bool I = get_value(raw, 11, 1);
-      addr = get_reg(state, sf, xn);
-      set_reg(state, sf, xn, addr + simm9);
-      if (I)
-      {
-        addr += simm9;
-      }
-      addr_set = true;
-    }
+    // Register offset, with a W index register extended, or an X one
+    d->cond = get_value(raw, 13, 3);
+    if (index != INDEX_REGISTER || !(d->cond & 2))
+      return false;
+    d->stype = SDT_REGISTER;
+    d->rm = get_value(raw, 16, 5);
+    d->imm = get_value(raw, 12, 1) ? size : 0;
+    return true;
   }
-  else if ((raw & LOAD_LITERAL_TEST) == LOAD_LITERAL_EXPECTED)
+  d->imm = sign_extend_64bit(get_value(raw, 12, 9), 8);
+  switch (index)
   {
-    // Literal Address
-    long simm19 = sign_extend(get_value(raw, 5, 19), 18);
-    addr = state->pc + simm19 * 4;
-    addr_set = true;
+  case INDEX_UNSCALED:
+    d->stype = SDT_OFFSET;
+    return true;
+  case INDEX_POST:
+    d->stype = SDT_POST;
+    return true;
+  case INDEX_PRE:
+    d->stype = SDT_PRE;
+    return true;
+  default: // LDTR and STTR
+    return false;
   }
+}
 
-  // Apply load/store
-  if (addr_set)
+bool decode_sdt_instr(ulong raw, decoded_t *d, isa_op op)
+{
+  d->rd = get_value(raw, 0, 5);
+  d->rn = get_value(raw, 5, 5);
+  if (d->rn == GENERAL_REGS) // the base is SP
+    d->rn = SP_REG;
+  d->ra = 0;
+  if (op == OP_LOAD_LITERAL)
   {
-    if (L)
-    {
-      ullong value = load_mem(state, sf, addr);
-      set_reg(state, sf, rt, value);
-    }
-    else
-    {
-      ullong value = get_reg(state, sf, rt);
-      store_mem(state, sf, addr, value);
-    }
+    ulong opc = get_value(raw, 30, 2);
+    if (opc == LITERAL_OPC_PRFM)
+      return false;
+    d->shift = opc == LITERAL_OPC_64 ? 8 : 4;
+    if (opc == LITERAL_OPC_LDRSW)
+      d->ra = 64;
+    d->stype = SDT_LITERAL;
+    d->imm = sign_extend_64bit(get_value(raw, 5, 19) * INSTR_SIZE, 20);
+    d->exec = exec_load;
     return true;
   }
-  return false;
+
+  ulong size = get_value(raw, 30, 2);
+  ulong opc = get_value(raw, 22, 2);
+  d->shift = 1 << size;
+  if (opc == OPC_SIGNED_64 || opc == OPC_SIGNED_32)
+  {
+    // Sign-extending loads are narrower than their register, the others PRFM or unallocated
+    if (size == 3 || (size == 2 && opc == OPC_SIGNED_32))
+      return false;
+    d->ra = opc == OPC_SIGNED_64 ? 64 : 32;
+  }
+  if (!decode_sdt_mode(raw, d, size))
+    return false;
+  d->exec = opc == 0 ? exec_store : exec_load;
+  return true;
+}
+
+// A load fused with the ADD after it, which is executed by its own handler in d[1]
+static void exec_load_add(emulstate state, const decoded_t *d)
+{
+  exec_load(state, d);
+  d[1].exec(state, d + 1);
+}
+
+void fuse_sdt_instr(decoded_t *d, isa_op op, isa_op next_op)
+{
+  // ADD (immediate or register) without flags, which is never fused itself
+  bool add = (next_op == OP_ARITH_IMM || next_op == OP_ARITH_REG) && get_value(d[1].raw, 29, 2) == 0;
+  if (d->exec == exec_load && add)
+  {
+    d->exec = exec_load_add;
+    d->insns = 2;
+  }
+}
+
+bool decode_sdt_pair(ulong raw, decoded_t *d, isa_op op)
+{
+  ulong opc = get_value(raw, 30, 2);
+  bool load = get_value(raw, 22, 1);
+  if (opc != PAIR_OPC_32 && opc != PAIR_OPC_64 && !(opc == PAIR_OPC_SIGNED && load))
+    return false;
+  d->shift = opc == PAIR_OPC_64 ? 8 : 4;
+  d->ra = opc == PAIR_OPC_SIGNED ? 64 : 0;
+  switch (get_value(raw, 23, 2))
+  {
+  case PAIR_POST:
+    d->stype = SDT_POST;
+    break;
+  case PAIR_PRE:
+    d->stype = SDT_PRE;
+    break;
+  case PAIR_OFFSET:
+  case PAIR_NO_ALLOCATE: // LDNP and STNP only hint at the caches
+    d->stype = SDT_OFFSET;
+    break;
+  }
+  d->imm = sign_extend_64bit(get_value(raw, 15, 7), 6) * d->shift;
+  d->rd = get_value(raw, 0, 5);
+  d->rm = get_value(raw, 10, 5);
+  d->rn = get_value(raw, 5, 5);
+  if (d->rn == GENERAL_REGS) // the base is SP
+    d->rn = SP_REG;
+  d->exec = load ? exec_ldp : exec_stp;
+  return true;
 }
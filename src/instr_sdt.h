@@ -1,5 +1,27 @@
 #include "emulator.h"
+#include "decode.h"
 
 typedef unsigned long ulong;
 
-extern bool exec_sdt_instr(emulstate state, ulong raw);
\ No newline at end of file
+// Addressing modes of decoded loads and stores (decoded_t.stype), with the offset in imm
+#define SDT_OFFSET 0   // base + offset, scaled (LDR) or not (LDUR)
+#define SDT_REGISTER 1 // base + index register rm, extended by option cond, shifted left by imm
+#define SDT_PRE 2      // base + offset, written back to the base first
+#define SDT_POST 3     // base, then base + offset written back
+#define SDT_LITERAL 4  // PC + offset
+// Extensions of the index register (option, bits 15..13), LSL being UXTX
+#define EXTEND_UXTW 2
+#define EXTEND_LSL 3
+#define EXTEND_SXTW 6
+#define EXTEND_SXTX 7
+
+// Decodes the loads and stores of one register: LDR, LDRB, LDRH, LDRSB, LDRSH, LDRSW, STR,
+// STRB and STRH, with unsigned and unscaled offsets, extended register offsets, pre and
+// post-indexing, and from a literal (LDR and LDRSW). d->shift is the size of the access in
+// bytes, and d->ra the width of the register a signed load extends into (0 if unsigned).
+extern bool decode_sdt_instr(ulong raw, decoded_t *d, isa_op op);
+// Fuses a load with the ADD after it.
+extern void fuse_sdt_instr(decoded_t *d, isa_op op, isa_op next_op);
+// Decodes LDP, LDPSW and STP of 32 and 64-bit registers, in the offset, pre and post-indexed
+// modes, with the fields of decode_sdt_instr() and the second register in d->rm.
+extern bool decode_sdt_pair(ulong raw, decoded_t *d, isa_op op);
@@ -1,11 +1,8 @@
 #include <float.h>
 #include "instr_simd_fp.h"
+#include "isa.h"
 
 // Testing masks
-// 0b1111111001 << 21
-#define FDP_TEST 0x7f200000
-// 0b0011110001 << 21
-#define FDP_EXPECTED 0x1e200000
 // 0b10111
 #define CMP_TEST 0x17
 #define CMP_EXPECTED 0
@@ -30,7 +27,7 @@
 
 bool exec_simd_fp_instr(emulstate state, ulong raw)
 {
-  if ((raw & FDP_TEST) == FDP_EXPECTED)
+  if ((raw & FP_DP_MASK) == FP_DP_MATCH)
   {
     // Extract fields
     byte rd = get_value(raw, 0, 5);
@@ -107,7 +104,7 @@ bool exec_simd_fp_instr(emulstate state, ulong raw)
           {
             result -= m;
           }
-          ldouble min, max;
+          ldouble min = 0, max = 0;
           switch (ftype)
           {
           case 0:
@@ -0,0 +1,170 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "instr_system.h"
+#include "interrupt.h"
+
+// MPIDR_EL1 bit 31 is RES1, and the core number is affinity level 0
+#define MPIDR_RES1 (1ull << 31)
+#define DAIF_SHIFT 6  // of DAIF in the DAIF register
+#define DAIF_CLEAR 5  // bit of MSR DAIFClr, clear in MSR DAIFSet
+
+// Data memory barrier. Every option is a full barrier here.
+static void exec_dmb(emulstate state, const decoded_t *d)
+{
+  atomic_thread_fence(memory_order_seq_cst);
+  state->pc += INSTR_SIZE;
+}
+
+static void exec_wfi(emulstate state, const decoded_t *d)
+{
+  wait_for_interrupt(state);
+}
+
+// MSR DAIFSet and DAIFClr, with the bits in d->imm
+static void exec_msr_daif(emulstate state, const decoded_t *d)
+{
+  if (get_value(d->raw, DAIF_CLEAR, 1))
+    state->daif &= ~d->imm;
+  else
+    state->daif |= d->imm;
+  interrupts_changed(state);
+  state->pc += INSTR_SIZE;
+}
+
+// MRS of the system register in d->imm
+static void exec_mrs(emulstate state, const decoded_t *d)
+{
+  ullong value = 0;
+  switch (d->imm)
+  {
+  case SYSREG_MPIDR_EL1:
+    value = MPIDR_RES1 | state->core;
+    break;
+  case SYSREG_SPSR_EL1:
+    value = state->spsr;
+    break;
+  case SYSREG_ELR_EL1:
+    value = state->elr;
+    break;
+  case SYSREG_VBAR_EL1:
+    value = state->vbar;
+    break;
+  case SYSREG_ICC_IAR1_EL1:
+    value = interrupt_acknowledge(state);
+    break;
+  case SYSREG_ICC_IGRPEN1_EL1:
+    value = state->irq_enabled;
+    break;
+  case SYSREG_DAIF:
+    value = (ullong)state->daif << DAIF_SHIFT;
+    break;
+  case SYSREG_CNTFRQ_EL0:
+    value = TIMER_FREQ;
+    break;
+  case SYSREG_CNTVCT_EL0:
+    value = state->insns;
+    break;
+  case SYSREG_CNTV_CTL_EL0:
+    value = timer_ctl(state);
+    break;
+  case SYSREG_CNTV_CVAL_EL0:
+    value = state->cntv_cval;
+    break;
+  }
+  set_reg(state, true, d->rd, value);
+  state->pc += INSTR_SIZE;
+}
+
+// MSR of the system register in d->imm
+static void exec_msr(emulstate state, const decoded_t *d)
+{
+  ullong value = get_reg(state, true, d->rd);
+  switch (d->imm)
+  {
+  case SYSREG_SPSR_EL1:
+    state->spsr = value;
+    break;
+  case SYSREG_ELR_EL1:
+    state->elr = value;
+    break;
+  case SYSREG_VBAR_EL1:
+    state->vbar = value;
+    break;
+  case SYSREG_ICC_EOIR1_EL1:
+    interrupt_end(state, value);
+    break;
+  case SYSREG_ICC_IGRPEN1_EL1:
+    state->irq_enabled = value & 1;
+    interrupts_changed(state);
+    break;
+  case SYSREG_DAIF:
+    state->daif = (value >> DAIF_SHIFT) & 0xF;
+    interrupts_changed(state);
+    break;
+  case SYSREG_CNTV_CTL_EL0:
+    timer_set(state, value, state->cntv_cval);
+    break;
+  case SYSREG_CNTV_CVAL_EL0:
+    timer_set(state, state->cntv_ctl, value);
+    break;
+  }
+  state->pc += INSTR_SIZE;
+}
+
+static void exec_eret(emulstate state, const decoded_t *d)
+{
+  exception_return(state);
+}
+
+// Whether MRS (or MSR, if `write`) of `sysreg` is supported
+static bool sysreg_supported(ulong sysreg, bool write)
+{
+  switch (sysreg)
+  {
+  case SYSREG_SPSR_EL1:
+  case SYSREG_ELR_EL1:
+  case SYSREG_VBAR_EL1:
+  case SYSREG_ICC_IGRPEN1_EL1:
+  case SYSREG_DAIF:
+  case SYSREG_CNTV_CTL_EL0:
+  case SYSREG_CNTV_CVAL_EL0:
+    return true;
+  case SYSREG_MPIDR_EL1:
+  case SYSREG_ICC_IAR1_EL1:
+  case SYSREG_CNTFRQ_EL0:
+  case SYSREG_CNTVCT_EL0:
+    return !write;
+  case SYSREG_ICC_EOIR1_EL1:
+    return write;
+  default:
+    return false;
+  }
+}
+
+bool decode_system_instr(ulong raw, decoded_t *d, isa_op op)
+{
+  switch (op)
+  {
+  case OP_DMB:
+    d->exec = exec_dmb;
+    return true;
+  case OP_WFI:
+    d->exec = exec_wfi;
+    return true;
+  case OP_MSR_DAIF:
+    d->imm = get_value(raw, 8, 4);
+    d->exec = exec_msr_daif;
+    return true;
+  case OP_MSR:
+  case OP_MRS:
+    d->rd = get_value(raw, 0, 5);
+    d->imm = get_value(raw, 5, 15);
+    d->exec = op == OP_MSR ? exec_msr : exec_mrs;
+    return sysreg_supported(d->imm, op == OP_MSR);
+  case OP_ERET:
+    d->exec = exec_eret;
+    return true;
+  default:
+    return false;
+  }
+}
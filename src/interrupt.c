@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include "interrupt.h"
+#include "error.h"
+
+#define CTL_ENABLE 1
+#define CTL_IMASK 2
+#define CTL_ISTATUS 4
+#define CTL_WRITABLE (CTL_ENABLE | CTL_IMASK)
+#define DAIF_I 2 // in state->daif
+#define DAIF_ALL 0xF
+#define DAIF_SHIFT 6 // of DAIF in SPSR_EL1
+#define SPSR_EL1H 0x5 // exception level 1, SP_EL1
+#define NZCV_SHIFT 28
+
+// Sets the deadline emulstep() checks: the first event's, or the limit if it comes first
+static void update_next_event(emulstate state)
+{
+  ullong deadline = state->num_events > 0 ? state->events[0].deadline : NO_INSN_LIMIT;
+  state->next_event = deadline < state->insn_limit ? deadline : state->insn_limit;
+}
+
+void set_insn_limit(emulstate state, ullong limit)
+{
+  state->insn_limit = limit;
+  update_next_event(state);
+}
+
+void event_cancel(emulstate state, event_fn fn)
+{
+  int idx = 0;
+  while (idx < state->num_events && state->events[idx].fn != fn)
+  {
+    idx++;
+  }
+  if (idx == state->num_events)
+    return;
+  state->num_events--;
+  for (; idx < state->num_events; idx++)
+  {
+    state->events[idx] = state->events[idx + 1];
+  }
+  update_next_event(state);
+}
+
+void event_schedule(emulstate state, event_fn fn, ullong deadline)
+{
+  event_cancel(state, fn);
+  if (state->num_events == MAX_EVENTS)
+  {
+    fprintf(stderr, "Error: Too many events scheduled\n");
+    exit(1);
+  }
+  // Insertion into the sorted queue, which holds an event per source
+  int idx = state->num_events++;
+  for (; idx > 0 && state->events[idx - 1].deadline > deadline; idx--)
+  {
+    state->events[idx] = state->events[idx - 1];
+  }
+  state->events[idx] = (event_t){deadline, fn};
+  update_next_event(state);
+}
+
+void events_run(emulstate state)
+{
+  while (state->num_events > 0 && state->events[0].deadline <= state->insns)
+  {
+    event_fn fn = state->events[0].fn;
+    event_cancel(state, fn);
+    fn(state);
+  }
+}
+
+ullong nzcv_bits(emulstate state)
+{
+  pstate_t p = state->pstate;
+  return ((ullong)p.negative << 3 | p.zero << 2 | p.carry << 1 | p.overflow) << NZCV_SHIFT;
+}
+
+// Whether the timer condition holds, CNTVCT_EL0 >= CNTV_CVAL_EL0 while enabled
+static bool timer_status(emulstate state)
+{
+  return (state->cntv_ctl & CTL_ENABLE) && state->insns >= state->cntv_cval;
+}
+
+uint interrupts_pending(emulstate state)
+{
+  uint asserted = timer_status(state) && !(state->cntv_ctl & CTL_IMASK) ? 1u << INTID_VTIMER : 0;
+  return state->irq_enabled ? asserted & ~state->irq_active : 0;
+}
+
+// Takes an interrupt exception if an interrupt is pending, none is active and PSTATE.I is clear
+static void check_interrupts(emulstate state)
+{
+  if (state->irq_active != 0 || (state->daif & DAIF_I) || interrupts_pending(state) == 0)
+    return;
+  state->spsr = nzcv_bits(state) | (ullong)state->daif << DAIF_SHIFT | SPSR_EL1H;
+  state->elr = state->pc;
+  state->daif = DAIF_ALL;
+  state->excl_size = 0;
+  state->pc = state->vbar + IRQ_VECTOR;
+}
+
+// The event of the timer deadline
+static void timer_expired(emulstate state)
+{
+  check_interrupts(state);
+}
+
+void interrupts_changed(emulstate state)
+{
+  event_schedule(state, check_interrupts, state->insns);
+}
+
+ullong interrupt_acknowledge(emulstate state)
+{
+  uint pending = interrupts_pending(state);
+  if (pending == 0)
+    return INTID_SPURIOUS;
+  int intid = __builtin_ctz(pending);
+  state->irq_active |= 1u << intid;
+  return intid;
+}
+
+void interrupt_end(emulstate state, ullong intid)
+{
+  if (intid < 32)
+    state->irq_active &= ~(1u << intid);
+  interrupts_changed(state);
+}
+
+ullong timer_ctl(emulstate state)
+{
+  return state->cntv_ctl | (timer_status(state) ? CTL_ISTATUS : 0);
+}
+
+void timer_set(emulstate state, ullong ctl, ullong cval)
+{
+  state->cntv_ctl = ctl & CTL_WRITABLE;
+  state->cntv_cval = cval;
+  // The interrupt may be taken from the deadline on
+  if ((ctl & CTL_ENABLE) && !(ctl & CTL_IMASK))
+    event_schedule(state, timer_expired, cval);
+  else
+    event_cancel(state, timer_expired);
+  interrupts_changed(state);
+}
+
+void wait_for_interrupt(emulstate state)
+{
+  if (interrupts_pending(state) != 0)
+  {
+    state->pc += INSTR_SIZE;
+    return;
+  }
+  ullong wake = state->next_event; // or the limit, if it comes first
+  if (wake == NO_INSN_LIMIT)
+  {
+    error_report("Error: WFI with no event to wait for at 0x%llx\n", state->pc);
+    error_fail();
+  }
+  if (wake > state->insns)
+    state->insns = wake;
+  // Like on hardware, WFI completes on events that raise no interrupt too, and an interrupt
+  // taken next returns after it. Stopped by the limit instead, it waits again when resumed.
+  if (state->num_events > 0 && state->events[0].deadline == wake)
+    state->pc += INSTR_SIZE;
+}
+
+void exception_return(emulstate state)
+{
+  state->pstate.negative = (state->spsr >> (NZCV_SHIFT + 3)) & 1;
+  state->pstate.zero = (state->spsr >> (NZCV_SHIFT + 2)) & 1;
+  state->pstate.carry = (state->spsr >> (NZCV_SHIFT + 1)) & 1;
+  state->pstate.overflow = (state->spsr >> NZCV_SHIFT) & 1;
+  state->daif = (state->spsr >> DAIF_SHIFT) & DAIF_ALL;
+  state->excl_size = 0;
+  state->pc = state->elr;
+  interrupts_changed(state);
+}
@@ -0,0 +1,62 @@
+#include <stdbool.h>
+#include "emulator.h"
+
+#ifndef INTERRUPT_H
+#define INTERRUPT_H
+
+// Events, the generic timer, the interrupt controller and interrupt exceptions of a core.
+//
+// Time is the instruction count: CNTVCT_EL0 reads state->insns, and CNTFRQ_EL0 reports a
+// nominal TIMER_FREQ. Work due at a later count is an event, kept in a queue ordered by
+// deadline, and emulstep() compares the count against the first deadline only, or against
+// the instruction limit of emulrun() if that comes first, so that a run checks its limit at
+// no extra cost per instruction (see set_insn_limit()). WFI skips the
+// count ahead to the next event instead of stepping to it, so a guest waiting for its timer
+// runs in time proportional to its work, not to the time it waits.
+//
+// The virtual timer raises INTID_VTIMER while it is enabled, not masked and
+// CNTVCT_EL0 >= CNTV_CVAL_EL0, like the level-sensitive interrupt of the Arm timer. The
+// interrupt controller is the system register interface of a GICv3 CPU interface, reduced to
+// ICC_IGRPEN1_EL1 (enable), ICC_IAR1_EL1 (acknowledge the lowest pending INTID, or
+// INTID_SPURIOUS) and ICC_EOIR1_EL1 (end it). No interrupt is taken while one is active.
+// There is a single exception level: an interrupt not masked by PSTATE.I is taken at
+// VBAR_EL1 + IRQ_VECTOR, with the return address in ELR_EL1 and NZCV and DAIF in SPSR_EL1, and
+// ERET returns. WFI completes once an interrupt is pending, even with PSTATE.I set, so guests
+// can also wait for the timer without a vector table. PSTATE.DAIF is set at reset.
+
+#define TIMER_FREQ 100000000 // reported by CNTFRQ_EL0, counting an instruction per tick
+#define INTID_VTIMER 27
+#define INTID_SPURIOUS 1023
+#define IRQ_VECTOR 0x280 // IRQ from the current exception level, using SP_ELx
+
+// Runs `fn` once the instruction count reaches `deadline`, replacing the event of `fn` if
+// one is scheduled.
+extern void event_schedule(emulstate state, event_fn fn, ullong deadline);
+// Removes the event of `fn`, if one is scheduled.
+extern void event_cancel(emulstate state, event_fn fn);
+// Runs the events due. Called by emulstep() before the next instruction.
+extern void events_run(emulstate state);
+// Sets state->insn_limit, where emulrun() stops. A device lowering it to the instruction count
+// ends the run after the current instruction.
+extern void set_insn_limit(emulstate state, ullong limit);
+// Takes a pending interrupt before the next instruction, if it can be. Called after a change to
+// the timer, the interrupt controller or PSTATE.DAIF.
+extern void interrupts_changed(emulstate state);
+// Returns the interrupts pending and not active, a bit per INTID.
+extern uint interrupts_pending(emulstate state);
+// Reads ICC_IAR1_EL1, making the interrupt returned active.
+extern ullong interrupt_acknowledge(emulstate state);
+// Writes ICC_EOIR1_EL1.
+extern void interrupt_end(emulstate state, ullong intid);
+// Reads CNTV_CTL_EL0, with its ISTATUS bit.
+extern ullong timer_ctl(emulstate state);
+// Writes CNTV_CTL_EL0 and CNTV_CVAL_EL0.
+extern void timer_set(emulstate state, ullong ctl, ullong cval);
+// WFI: completes if an interrupt is pending, and otherwise skips to the next event and
+// completes then. Stopped by the instruction limit first, it is executed again.
+extern void wait_for_interrupt(emulstate state);
+// ERET
+extern void exception_return(emulstate state);
+// Returns NZCV as in bits 31..28 of SPSR_EL1.
+extern ullong nzcv_bits(emulstate state);
+#endif
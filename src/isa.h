@@ -0,0 +1,35 @@
+#ifndef ISA_H
+#define ISA_H
+
+typedef unsigned long ulong;
+
+// Instruction encodings described in isa.def, one per entry
+typedef enum
+{
+#define ISA(name, mask, match, decoder, fuser) OP_##name,
+#include "isa.def"
+#undef ISA
+  ISA_OPS
+} isa_op;
+
+// <name>_MASK and <name>_MATCH: the bits identifying an encoding, and their expected value
+#define ISA(name, mask, match, decoder, fuser)    \
+  static const ulong name##_MASK = mask; \
+  static const ulong name##_MATCH = match;
+#include "isa.def"
+#undef ISA
+
+// System registers of MRS and MSR, by their o0:op1:CRn:CRm:op2 operand (bits 19..5)
+#define SYSREG_MPIDR_EL1 0x4005       // 3:0:0:0:5, multiprocessor affinity
+#define SYSREG_SPSR_EL1 0x4200        // 3:0:4:0:0, saved program status
+#define SYSREG_ELR_EL1 0x4201         // 3:0:4:0:1, exception link register
+#define SYSREG_VBAR_EL1 0x4600        // 3:0:12:0:0, vector base address
+#define SYSREG_ICC_IAR1_EL1 0x4660    // 3:0:12:12:0, interrupt acknowledge
+#define SYSREG_ICC_EOIR1_EL1 0x4661   // 3:0:12:12:1, end of interrupt
+#define SYSREG_ICC_IGRPEN1_EL1 0x4667 // 3:0:12:12:7, interrupt enable
+#define SYSREG_DAIF 0x5A11            // 3:3:4:2:1, interrupt masks
+#define SYSREG_CNTFRQ_EL0 0x5F00      // 3:3:14:0:0, counter frequency
+#define SYSREG_CNTVCT_EL0 0x5F02      // 3:3:14:0:2, virtual counter
+#define SYSREG_CNTV_CTL_EL0 0x5F19    // 3:3:14:3:1, virtual timer control
+#define SYSREG_CNTV_CVAL_EL0 0x5F1A   // 3:3:14:3:2, virtual timer compare value
+#endif
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include "error.h"
 #include "parse_utils.h"
 #include "symbol_table.h"
 
@@ -28,13 +29,21 @@ char *finish_parse_operand(char *str)
   }
   else
   {
-    fprintf(stderr, "Error: Invalid characters after complete operand %s\n", str);
-    exit(1);
+    error_report("Error: Invalid characters after complete operand %s\n", str);
+    error_fail();
   }
 }
 
 char *parse_register(char *str, ulong *reg, bool *sf, bool *sp_used)
 {
+  // SP, which is encoded as register 31 like the zero register
+  if (strncmp(str, "sp", 2) == 0)
+  {
+    *sf = true;
+    *sp_used = true;
+    *reg = MAX_REG;
+    return str + 2;
+  }
   // Set sf flag (true = 64-bit mode = x)
   if (str[0] == 'x')
   {
@@ -46,8 +55,8 @@ char *parse_register(char *str, ulong *reg, bool *sf, bool *sp_used)
   }
   else
   {
-    fprintf(stderr, "Error: Invalid register specifier %c\n", str[0]);
-    exit(1);
+    error_report("Error: Invalid register specifier %c\n", str[0]);
+    error_fail();
   }
   str++;
 
@@ -64,8 +73,8 @@ char *parse_register(char *str, ulong *reg, bool *sf, bool *sp_used)
   *reg = strtoul(str, &str, 10);
   if (*reg > MAX_REG)
   {
-    fprintf(stderr, "Error: Register number out of bounds %lu\n", *reg);
-    exit(1);
+    error_report("Error: Register number out of bounds %lu\n", *reg);
+    error_fail();
   }
   return str;
 }
@@ -78,8 +87,8 @@ char *parse_reg_or_simd(char *str, ulong *reg, bool *sf, bool *sp_used, char *ft
   case 'w':
     if (sf == NULL || sp_used == NULL)
     {
-      fprintf(stderr, "Error: General register specifier not allowed here\n");
-      exit(1);
+      error_report("Error: General register specifier not allowed here\n");
+      error_fail();
     }
     *ftype = -1;
     return parse_register(str, reg, sf, sp_used);
@@ -90,8 +99,8 @@ char *parse_reg_or_simd(char *str, ulong *reg, bool *sf, bool *sp_used, char *ft
     *ftype = 0;
     break;
   default: // quod,half-precision and vectors are unsupported
-    fprintf(stderr, "Error: Invalid SIMD register specifier %c\n", str[0]);
-    exit(1);
+    error_report("Error: Invalid SIMD register specifier %c\n", str[0]);
+    error_fail();
   }
   str++;
 
@@ -99,8 +108,8 @@ char *parse_reg_or_simd(char *str, ulong *reg, bool *sf, bool *sp_used, char *ft
   *reg = strtoul(str, &str, 10);
   if (*reg > MAX_REG)
   {
-    fprintf(stderr, "Error: Register number out of bounds %lu\n", *reg);
-    exit(1);
+    error_report("Error: Register number out of bounds %lu\n", *reg);
+    error_fail();
   }
   return str;
 }
@@ -140,8 +149,8 @@ char *parse_literal(char *str, ulong *lit, symbol_table_t st)
   long address = symbol_table_find(st, str, end - str);
   if (address < 0)
   {
-    fprintf(stderr, "Error: Undefined label %.*s\n", (int)(end - str), str);
-    exit(1);
+    error_report("Error: Undefined label %.*s\n", (int)(end - str), str);
+    error_fail();
   }
   *lit = address;
   return end;
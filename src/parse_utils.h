@@ -13,7 +13,8 @@ typedef unsigned long ulong;
 extern char *trim_left(char *str);
 // Finishes parsing an operand by looking for '\0' or ',' and returns the remaining substring.
 extern char *finish_parse_operand(char *str);
-// Parses a register from the argument string and returns the remaining substring.
+// Parses a register (x<n>, w<n>, xzr, wzr, sp, xsp or wsp) from the argument string and returns
+// the remaining substring. SP and the zero register are register MAX_REG, told apart by `sp_used`.
 extern char *parse_register(char *str, ulong *reg, bool *sf, bool *sp_used);
 // Parses a register or SIMD register from the argument string and returns the remaining substring.
 extern char *parse_reg_or_simd(char *str, ulong *reg, bool *sf, bool *sp_used, char *ftype);
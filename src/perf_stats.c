@@ -0,0 +1,257 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf_stats.h"
+
+#define CALIBRATION_ROUNDS 1000
+#define TOP_SYMBOLS 10
+
+static const char *class_names[PERF_CLASSES] = {
+    "dp-imm", "dp-reg", "load/store", "branch", "simd/fp"};
+
+static const char *counter_names[PERF_COUNTERS] = {
+    "cycles", "instrs", "br-miss", "l1d-miss", "llc-miss"};
+
+static const struct
+{
+  uint type;
+  ullong config;
+} counter_events[PERF_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+};
+
+// Maps an instruction to its class by op0.
+static int instr_class(ulong instr)
+{
+  switch ((instr >> 25) & 0xf)
+  {
+  case 0x8:
+  case 0x9:
+    return 0;
+  case 0x5:
+  case 0xd:
+    return 1;
+  case 0x4:
+  case 0x6:
+  case 0xc:
+  case 0xe:
+    return 2;
+  case 0xa:
+  case 0xb:
+    return 3;
+  default:
+    return 4;
+  }
+}
+
+static int open_counter(uint type, ullong config, int group)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.read_format = PERF_FORMAT_GROUP;
+  // Only count the emulator itself, so the read() syscalls do not pollute the counts.
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+// Takes a snapshot of the clock and all open counters.
+static void sample(perf_stats_t ps, ullong *ns, ullong *counts)
+{
+  if (ps->leader >= 0)
+  {
+    ullong values[PERF_COUNTERS + 1]; // PERF_FORMAT_GROUP: count, then values
+    if (read(ps->leader, values, sizeof(values)) > 0)
+    {
+      int idx = 1;
+      for (int i = 0; i < PERF_COUNTERS; i++)
+      {
+        counts[i] = ps->fds[i] >= 0 ? values[idx++] : 0;
+      }
+    }
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  *ns = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Measures the cheapest back to back sample, which is subtracted from every step.
+static void calibrate(perf_stats_t ps)
+{
+  ullong ns0, ns1, counts0[PERF_COUNTERS] = {0}, counts1[PERF_COUNTERS] = {0};
+  ps->overhead_ns = ~0ull;
+  for (int i = 0; i < PERF_COUNTERS; i++)
+  {
+    ps->overhead[i] = ~0ull;
+  }
+  for (int round = 0; round < CALIBRATION_ROUNDS; round++)
+  {
+    sample(ps, &ns0, counts0);
+    sample(ps, &ns1, counts1);
+    if (ns1 - ns0 < ps->overhead_ns)
+      ps->overhead_ns = ns1 - ns0;
+    for (int i = 0; i < PERF_COUNTERS; i++)
+    {
+      if (counts1[i] - counts0[i] < ps->overhead[i])
+        ps->overhead[i] = counts1[i] - counts0[i];
+    }
+  }
+}
+
+perf_stats_t perf_stats_init(void)
+{
+  perf_stats_t ps = calloc(1, sizeof(struct perf_stats_t));
+  ps->leader = -1;
+  for (int i = 0; i < PERF_COUNTERS; i++)
+  {
+    ps->fds[i] = open_counter(counter_events[i].type, counter_events[i].config, ps->leader);
+    if (ps->fds[i] >= 0)
+    {
+      ps->num_open++;
+      if (ps->leader < 0)
+        ps->leader = ps->fds[i];
+    }
+  }
+  calibrate(ps);
+  return ps;
+}
+
+void perf_stats_free(perf_stats_t ps)
+{
+  for (int i = 0; i < PERF_COUNTERS; i++)
+  {
+    if (ps->fds[i] >= 0)
+      close(ps->fds[i]);
+  }
+  free(ps->sym_steps);
+  free(ps->sym_ns);
+  free(ps);
+}
+
+void perf_stats_symbolize(perf_stats_t ps, symbols_t symbols)
+{
+  ps->symbols = symbols;
+  ps->sym_steps = calloc(symbols_count(symbols), sizeof(ullong));
+  ps->sym_ns = calloc(symbols_count(symbols), sizeof(ullong));
+}
+
+bool perf_stats_step(perf_stats_t ps, emulstate state)
+{
+  int class_idx = instr_class(load_mem(state, false, state->pc));
+  long sym = ps->symbols != NULL ? symbols_find(ps->symbols, state->pc) : -1;
+  ullong ns0, ns1, counts0[PERF_COUNTERS] = {0}, counts1[PERF_COUNTERS] = {0};
+
+  ullong insns = state->insns;
+
+  sample(ps, &ns0, counts0);
+  bool running = emulstep(state);
+  sample(ps, &ns1, counts1);
+
+  if (running) // the HALT instruction is not an executed instruction
+  {
+    // A fused pair is attributed to the class of its first instruction
+    ps->steps[class_idx] += state->insns - insns;
+    ps->ns[class_idx] += ns1 - ns0;
+    for (int i = 0; i < PERF_COUNTERS; i++)
+    {
+      ps->counts[class_idx][i] += counts1[i] - counts0[i];
+    }
+    if (sym >= 0)
+    {
+      ps->sym_steps[sym] += state->insns - insns;
+      ps->sym_ns[sym] += ns1 - ns0;
+    }
+  }
+  return running;
+}
+
+// Prints the cost per instruction, with the measurement overhead removed.
+static void print_cost(FILE *stream, ullong total, ullong overhead, ullong steps, bool available)
+{
+  if (!available || steps == 0)
+  {
+    fprintf(stream, " %10s", "-");
+    return;
+  }
+  ullong adjusted = total > overhead * steps ? total - overhead * steps : 0;
+  fprintf(stream, " %10.2f", (double)adjusted / steps);
+}
+
+static void print_row(perf_stats_t ps, FILE *stream, const char *name,
+                      ullong steps, ullong ns, ullong *counts, ullong total_steps)
+{
+  fprintf(stream, "%-10s %12llu %6.2f%%", name, steps, total_steps ? 100.0 * steps / total_steps : 0);
+  print_cost(stream, ns, ps->overhead_ns, steps, true);
+  for (int i = 0; i < PERF_COUNTERS; i++)
+  {
+    print_cost(stream, counts[i], ps->overhead[i], steps, ps->fds[i] >= 0);
+  }
+  fprintf(stream, "\n");
+}
+
+// Prints the TOP_SYMBOLS symbols that ran the most instructions
+static void report_symbols(perf_stats_t ps, FILE *stream, ullong total_steps)
+{
+  fprintf(stream, "Symbols by instructions:\n%-24s %12s %7s %10s\n", "symbol", "insns", "share", "ns");
+  bool *shown = calloc(symbols_count(ps->symbols), sizeof(bool));
+  for (int rank = 0; rank < TOP_SYMBOLS; rank++)
+  {
+    long top = -1;
+    for (size_t sym = 0; sym < symbols_count(ps->symbols); sym++)
+    {
+      if (!shown[sym] && ps->sym_steps[sym] > 0 && (top < 0 || ps->sym_steps[sym] > ps->sym_steps[top]))
+        top = sym;
+    }
+    if (top < 0)
+      break;
+    shown[top] = true;
+    fprintf(stream, "%-24s %12llu %6.2f%%", symbols_name(ps->symbols, top), ps->sym_steps[top],
+            100.0 * ps->sym_steps[top] / total_steps);
+    print_cost(stream, ps->sym_ns[top], ps->overhead_ns, ps->sym_steps[top], true);
+    fprintf(stream, "\n");
+  }
+  free(shown);
+}
+
+void perf_stats_report(perf_stats_t ps, FILE *stream)
+{
+  if (ps->num_open == 0)
+    fprintf(stream, "Perf stats: perf events unavailable, using clock_gettime only\n");
+  fprintf(stream, "Host cost per guest instruction (measurement overhead of %llu ns removed):\n",
+          ps->overhead_ns);
+  fprintf(stream, "%-10s %12s %7s %10s", "class", "insns", "share", "ns");
+  for (int i = 0; i < PERF_COUNTERS; i++)
+  {
+    fprintf(stream, " %10s", counter_names[i]);
+  }
+  fprintf(stream, "\n");
+
+  ullong total_steps = 0, total_ns = 0, total_counts[PERF_COUNTERS] = {0};
+  for (int c = 0; c < PERF_CLASSES; c++)
+  {
+    total_steps += ps->steps[c];
+    total_ns += ps->ns[c];
+    for (int i = 0; i < PERF_COUNTERS; i++)
+    {
+      total_counts[i] += ps->counts[c][i];
+    }
+  }
+  for (int c = 0; c < PERF_CLASSES; c++)
+  {
+    print_row(ps, stream, class_names[c], ps->steps[c], ps->ns[c], ps->counts[c], total_steps);
+  }
+  print_row(ps, stream, "total", total_steps, total_ns, total_counts, total_steps);
+  if (ps->symbols != NULL)
+    report_symbols(ps, stream, total_steps);
+}
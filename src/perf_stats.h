@@ -0,0 +1,44 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include "emulator.h"
+#include "elf_loader.h"
+
+#ifndef PERF_STATS_H
+#define PERF_STATS_H
+
+// Instruction classes by op0: dp-imm, dp-reg, load/store, branch, simd/fp
+#define PERF_CLASSES 5
+// Host hardware counters: cycles, instructions, branch misses, L1D misses, LLC misses
+#define PERF_COUNTERS 5
+
+struct perf_stats_t
+{
+  int fds[PERF_COUNTERS]; // -1 if the counter is unavailable
+  int leader;             // counter group leader, -1 if no counters opened
+  int num_open;
+  ullong steps[PERF_CLASSES];
+  ullong ns[PERF_CLASSES];
+  ullong counts[PERF_CLASSES][PERF_COUNTERS];
+  ullong overhead_ns;                   // calibrated cost of one measurement
+  ullong overhead[PERF_COUNTERS];
+  symbols_t symbols;  // of the program, or NULL
+  ullong *sym_steps;  // by symbol
+  ullong *sym_ns;
+};
+// Host cost accounting for `emulate --perf-stats`
+typedef struct perf_stats_t *perf_stats_t;
+
+// Opens the hardware counters that are available and calibrates the measurement overhead.
+// Falls back to clock_gettime timing only if perf events are unavailable.
+extern perf_stats_t perf_stats_init(void);
+// Frees the counters.
+extern void perf_stats_free(perf_stats_t ps);
+// Also attributes the cost to the symbols of the program, for a profile by function.
+extern void perf_stats_symbolize(perf_stats_t ps, symbols_t symbols);
+// Executes a single emulation step, attributing its host cost to the instruction class.
+// Returns the result of emulstep().
+extern bool perf_stats_step(perf_stats_t ps, emulstate state);
+// Prints the host cost per guest instruction, broken down by instruction class, and the
+// symbols that ran the most instructions.
+extern void perf_stats_report(perf_stats_t ps, FILE *stream);
+#endif
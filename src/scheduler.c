@@ -0,0 +1,467 @@
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "scheduler.h"
+#include "error.h"
+#include "interrupt.h"
+
+#define INIT_GUESTS 16
+#define INIT_WAITING 4
+
+struct guest
+{
+  scheduler_t sched;
+  emulstate state;
+  _Atomic guest_status status;
+  char *error;  // message of the error that faulted the guest
+  ullong limit; // instruction count of the state the guest is stopped at
+  _Atomic(waitlist_t) list; // the list the guest waits on, or NULL
+  // Under the lock of the scheduler
+  bool parking; // scheduler_wait() was called in the current slice
+  bool woken;   // the list was woken since
+};
+
+struct waitlist
+{
+  pthread_mutex_t lock;
+  struct guest **guests;
+  size_t count;
+  size_t cap;
+};
+
+struct scheduler
+{
+  struct guest *guests;
+  size_t count;
+  size_t cap;
+  ullong slice;
+  // Of the current run
+  ullong budget;          // 0 for no limit
+  _Atomic ullong claimed; // instructions given to slices so far
+  _Atomic size_t next;    // the guest to try first, round robin, modulo the count
+  _Atomic size_t live;    // guests that did not halt, fault or reach their limit
+  _Atomic bool stopping;  // the budget ran out
+  _Atomic ullong changes; // guests unparked or finished, and the budget running out
+  bool timed;               // the runs end at the deadline
+  struct timespec deadline; // of CLOCK_MONOTONIC
+  pthread_mutex_t lock;
+  pthread_cond_t changed; // for the threads with no guest to run
+};
+
+// A host thread of a run, and the instructions its guests ran
+typedef struct
+{
+  scheduler_t sched;
+  ullong executed;
+} worker_t;
+
+// The guest running on this thread, for scheduler_wait()
+static _Thread_local struct guest *current = NULL;
+
+scheduler_t scheduler_init(ullong slice)
+{
+  scheduler_t sched = malloc(sizeof(struct scheduler));
+  assert(sched != NULL);
+  sched->guests = malloc(INIT_GUESTS * sizeof(struct guest));
+  assert(sched->guests != NULL);
+  sched->count = 0;
+  sched->cap = INIT_GUESTS;
+  sched->slice = slice > 0 ? slice : 1;
+  sched->budget = 0;
+  atomic_init(&sched->claimed, 0);
+  atomic_init(&sched->next, 0);
+  atomic_init(&sched->live, 0);
+  atomic_init(&sched->stopping, false);
+  atomic_init(&sched->changes, 0);
+  sched->timed = false;
+  pthread_mutex_init(&sched->lock, NULL);
+  // Timed waits are measured against the deadline
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&sched->changed, &attr);
+  pthread_condattr_destroy(&attr);
+  return sched;
+}
+
+void scheduler_free(scheduler_t sched)
+{
+  for (size_t i = 0; i < sched->count; i++)
+  {
+    free(sched->guests[i].error);
+  }
+  pthread_cond_destroy(&sched->changed);
+  pthread_mutex_destroy(&sched->lock);
+  free(sched->guests);
+  free(sched);
+}
+
+size_t scheduler_add(scheduler_t sched, emulstate state)
+{
+  if (sched->count == sched->cap)
+  {
+    sched->cap <<= 1;
+    sched->guests = realloc(sched->guests, sched->cap * sizeof(struct guest));
+    assert(sched->guests != NULL);
+  }
+  struct guest *g = &sched->guests[sched->count];
+  g->sched = sched;
+  g->state = state;
+  atomic_init(&g->status, GUEST_RUNNABLE);
+  g->error = NULL;
+  g->limit = NO_INSN_LIMIT;
+  atomic_init(&g->list, NULL);
+  g->parking = false;
+  g->woken = false;
+  return sched->count++;
+}
+
+void scheduler_deadline(scheduler_t sched, ullong ms)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  ullong nsec = now.tv_nsec + ms % 1000 * 1000000;
+  sched->timed = ms > 0;
+  sched->deadline.tv_sec = now.tv_sec + ms / 1000 + nsec / 1000000000;
+  sched->deadline.tv_nsec = nsec % 1000000000;
+}
+
+void scheduler_limit(scheduler_t sched, size_t guest, ullong max_insns)
+{
+  struct guest *g = &sched->guests[guest];
+  ullong start = g->state->insns;
+  if (max_insns == 0 || max_insns >= NO_INSN_LIMIT - start)
+    g->limit = NO_INSN_LIMIT;
+  else
+    g->limit = start + max_insns;
+}
+
+// Wakes the threads waiting for a guest to run, after a change they may be waiting for
+static void notify_change(scheduler_t sched)
+{
+  atomic_fetch_add(&sched->changes, 1);
+  pthread_mutex_lock(&sched->lock);
+  pthread_cond_broadcast(&sched->changed);
+  pthread_mutex_unlock(&sched->lock);
+}
+
+waitlist_t waitlist_init(void)
+{
+  waitlist_t list = malloc(sizeof(struct waitlist));
+  assert(list != NULL);
+  pthread_mutex_init(&list->lock, NULL);
+  list->guests = malloc(INIT_WAITING * sizeof(struct guest *));
+  assert(list->guests != NULL);
+  list->count = 0;
+  list->cap = INIT_WAITING;
+  return list;
+}
+
+void waitlist_free(waitlist_t list)
+{
+  pthread_mutex_destroy(&list->lock);
+  free(list->guests);
+  free(list);
+}
+
+bool scheduler_wait(waitlist_t list)
+{
+  struct guest *g = current;
+  if (g == NULL)
+    return false;
+  // Parking first, so that waking the list from now on is seen when the slice ends
+  pthread_mutex_lock(&g->sched->lock);
+  g->parking = true;
+  g->woken = false;
+  pthread_mutex_unlock(&g->sched->lock);
+
+  pthread_mutex_lock(&list->lock);
+  if (list->count == list->cap)
+  {
+    list->cap <<= 1;
+    list->guests = realloc(list->guests, list->cap * sizeof(struct guest *));
+    assert(list->guests != NULL);
+  }
+  list->guests[list->count++] = g;
+  atomic_store(&g->list, list);
+  pthread_mutex_unlock(&list->lock);
+
+  // Ends the slice after this instruction
+  set_insn_limit(g->state, g->state->insns);
+  return true;
+}
+
+// Makes a parked guest runnable again, or keeps it from being parked at the end of its slice
+static void unpark(struct guest *g)
+{
+  scheduler_t sched = g->sched;
+  pthread_mutex_lock(&sched->lock);
+  if (atomic_load(&g->status) == GUEST_PARKED)
+  {
+    atomic_store(&g->status, GUEST_RUNNABLE);
+    atomic_fetch_add(&sched->changes, 1);
+    pthread_cond_broadcast(&sched->changed);
+  }
+  else
+  {
+    g->woken = true;
+  }
+  pthread_mutex_unlock(&sched->lock);
+}
+
+void scheduler_wake(waitlist_t list)
+{
+  pthread_mutex_lock(&list->lock);
+  for (size_t i = 0; i < list->count; i++)
+  {
+    atomic_store(&list->guests[i]->list, NULL);
+    unpark(list->guests[i]);
+  }
+  list->count = 0;
+  pthread_mutex_unlock(&list->lock);
+}
+
+// Takes a guest off the list it waits on, if any, once the run ended
+static void stop_waiting(struct guest *g)
+{
+  waitlist_t list = atomic_load(&g->list);
+  if (list == NULL)
+    return;
+  pthread_mutex_lock(&list->lock);
+  for (size_t i = 0; i < list->count; i++)
+  {
+    if (list->guests[i] == g)
+    {
+      list->guests[i] = list->guests[--list->count];
+      break;
+    }
+  }
+  atomic_store(&g->list, NULL);
+  pthread_mutex_unlock(&list->lock);
+  if (atomic_load(&g->status) == GUEST_PARKED)
+    atomic_store(&g->status, GUEST_RUNNABLE);
+}
+
+guest_status scheduler_status(scheduler_t sched, size_t guest)
+{
+  return atomic_load(&sched->guests[guest].status);
+}
+
+const char *scheduler_error(scheduler_t sched, size_t guest)
+{
+  return sched->guests[guest].error;
+}
+
+// Takes up to a slice of the budget, returning 0 once it is used up
+static ullong claim_slice(scheduler_t sched)
+{
+  if (sched->budget == 0)
+    return sched->slice;
+  ullong claimed = atomic_load(&sched->claimed);
+  ullong grant;
+  do
+  {
+    if (claimed >= sched->budget)
+      return 0;
+    grant = sched->budget - claimed < sched->slice ? sched->budget - claimed : sched->slice;
+  } while (!atomic_compare_exchange_weak(&sched->claimed, &claimed, claimed + grant));
+  return grant;
+}
+
+// Accounts for the instructions a slice of `grant` actually ran
+static void settle_slice(scheduler_t sched, ullong grant, ullong ran)
+{
+  if (sched->budget == 0)
+    return;
+  if (ran < grant)
+    atomic_fetch_sub(&sched->claimed, grant - ran);
+  else
+    atomic_fetch_add(&sched->claimed, ran - grant);
+}
+
+// Runs a guest for `grant` instructions, or until it halts, faults or reaches its limit.
+// Returns the instructions it ran.
+static ullong run_slice(struct guest *g, ullong grant)
+{
+  emulstate state = g->state;
+  ullong start = state->insns;
+  if (grant > g->limit - start)
+    grant = g->limit - start;
+  jmp_buf recovery;
+  jmp_buf *outer = error_recovery;
+  current = g;
+  if (setjmp(recovery) == 0)
+  {
+    error_recovery = &recovery;
+    if (!emulrun(state, start + grant))
+      atomic_store(&g->status, GUEST_HALTED);
+    else if (state->insns >= g->limit)
+      atomic_store(&g->status, GUEST_EXHAUSTED);
+  }
+  else
+  {
+    g->error = strdup(error_message());
+    atomic_store(&g->status, GUEST_FAULTED);
+  }
+  error_recovery = outer;
+  current = NULL;
+  return state->insns - start;
+}
+
+// Takes the next runnable guest, round robin, or returns NULL if there is none
+static struct guest *take_guest(scheduler_t sched)
+{
+  size_t start = atomic_fetch_add(&sched->next, 1);
+  for (size_t skipped = 0; skipped < sched->count; skipped++)
+  {
+    struct guest *g = &sched->guests[(start + skipped) % sched->count];
+    guest_status expected = GUEST_RUNNABLE;
+    if (atomic_compare_exchange_strong(&g->status, &expected, GUEST_RUNNING))
+    {
+      // The guests skipped get their turn after this one
+      atomic_fetch_add(&sched->next, skipped);
+      return g;
+    }
+  }
+  return NULL;
+}
+
+// Puts a guest back after its slice: runnable, parked, or out of the run if it finished
+static void release_guest(scheduler_t sched, struct guest *g)
+{
+  if (atomic_load(&g->status) != GUEST_RUNNING)
+  {
+    if (atomic_fetch_sub(&sched->live, 1) == 1)
+      notify_change(sched); // the threads waiting can return
+    return;
+  }
+  pthread_mutex_lock(&sched->lock);
+  bool park = g->parking && !g->woken;
+  g->parking = false;
+  atomic_store(&g->status, park ? GUEST_PARKED : GUEST_RUNNABLE);
+  pthread_mutex_unlock(&sched->lock);
+}
+
+// Ends the run, as the budget ran out or the deadline passed
+static void stop_run(scheduler_t sched)
+{
+  atomic_store(&sched->stopping, true);
+  notify_change(sched);
+}
+
+static bool deadline_passed(scheduler_t sched)
+{
+  if (!sched->timed)
+    return false;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec > sched->deadline.tv_sec ||
+         (now.tv_sec == sched->deadline.tv_sec && now.tv_nsec >= sched->deadline.tv_nsec);
+}
+
+// Waits for a change after the `seen`th, unless the run is over
+static void wait_for_change(scheduler_t sched, ullong seen)
+{
+  bool timed_out = false;
+  pthread_mutex_lock(&sched->lock);
+  while (atomic_load(&sched->changes) == seen && atomic_load(&sched->live) > 0 &&
+         !atomic_load(&sched->stopping) && !timed_out)
+  {
+    if (sched->timed)
+      timed_out = pthread_cond_timedwait(&sched->changed, &sched->lock, &sched->deadline) == ETIMEDOUT;
+    else
+      pthread_cond_wait(&sched->changed, &sched->lock);
+  }
+  pthread_mutex_unlock(&sched->lock);
+  if (timed_out)
+    stop_run(sched);
+}
+
+// Runs slices of the guests of the shared queue until the run is over. With no guest to run,
+// while others run on other threads or are parked, waits for one to be unparked or finish.
+static void *run_worker(void *arg)
+{
+  worker_t *worker = arg;
+  scheduler_t sched = worker->sched;
+  while (atomic_load(&sched->live) > 0 && !atomic_load(&sched->stopping))
+  {
+    if (deadline_passed(sched))
+    {
+      stop_run(sched);
+      break;
+    }
+    ullong seen = atomic_load(&sched->changes);
+    struct guest *g = take_guest(sched);
+    if (g == NULL)
+    {
+      wait_for_change(sched, seen);
+      continue;
+    }
+    ullong grant = claim_slice(sched);
+    if (grant == 0)
+    {
+      atomic_store(&g->status, GUEST_RUNNABLE);
+      stop_run(sched);
+      break;
+    }
+    ullong ran = run_slice(g, grant);
+    settle_slice(sched, grant, ran);
+    worker->executed += ran;
+    release_guest(sched, g);
+  }
+  return NULL;
+}
+
+ullong scheduler_run(scheduler_t sched, int threads, ullong budget)
+{
+  if (threads < 1)
+    threads = 1;
+  sched->budget = budget;
+  atomic_store(&sched->claimed, 0);
+  atomic_store(&sched->stopping, false);
+  size_t live = 0;
+  for (size_t i = 0; i < sched->count; i++)
+  {
+    guest_status status = atomic_load(&sched->guests[i].status);
+    live += status == GUEST_RUNNABLE || status == GUEST_PARKED;
+  }
+  atomic_store(&sched->live, live);
+
+  // The calling thread is the first worker
+  worker_t *workers = calloc(threads, sizeof(worker_t));
+  pthread_t *ids = malloc(threads * sizeof(pthread_t));
+  assert(workers != NULL && ids != NULL);
+  for (int i = 0; i < threads; i++)
+  {
+    workers[i].sched = sched;
+  }
+  for (int i = 1; i < threads; i++)
+  {
+    if (pthread_create(&ids[i], NULL, run_worker, &workers[i]) != 0)
+    {
+      fprintf(stderr, "Error: Could not create scheduler thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  run_worker(&workers[0]);
+
+  ullong executed = workers[0].executed;
+  for (int i = 1; i < threads; i++)
+  {
+    pthread_join(ids[i], NULL);
+    executed += workers[i].executed;
+  }
+  // Guests still parked are runnable in the next run, and access their device again
+  for (size_t i = 0; i < sched->count; i++)
+  {
+    stop_waiting(&sched->guests[i]);
+  }
+  free(ids);
+  free(workers);
+  return executed;
+}
@@ -0,0 +1,67 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include "emulator.h"
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Runs many emulator states ("guests") interleaved on a few host threads. The threads take
+// guests from one shared queue, round robin, and each guest runs for a time slice of
+// instructions before it goes back, so thousands of small programs share threads rather than
+// having a thread or a process each, and no thread idles while a guest is runnable. Errors in
+// a guest stop that guest only, and so does running out of its own instruction limit, if it
+// has one. A guest waiting on a device, like a UART with no input, is parked on a wait list
+// of the device: it is skipped until the device wakes the list, and threads with nothing to
+// run sleep meanwhile.
+
+typedef enum
+{
+  GUEST_RUNNABLE,
+  GUEST_RUNNING,   // on a host thread
+  GUEST_PARKED,    // waiting on a list, see scheduler_wait()
+  GUEST_HALTED,    // the program reached HALT
+  GUEST_FAULTED,   // the program failed, see scheduler_error()
+  GUEST_EXHAUSTED, // the program ran the instructions scheduler_limit() allowed it
+} guest_status;
+
+// Scheduler ADT
+typedef struct scheduler *scheduler_t;
+// Guests parked until a device has something for them, like input
+typedef struct waitlist *waitlist_t;
+
+// Creates a scheduler running guests `slice` instructions at a time.
+extern scheduler_t scheduler_init(ullong slice);
+// Frees the scheduler, but not the states of its guests.
+extern void scheduler_free(scheduler_t sched);
+// Adds a runnable guest, which continues from its current state. Returns its number, counting
+// from 0. Guests cannot be added while the scheduler runs.
+extern size_t scheduler_add(scheduler_t sched, emulstate state);
+// Ends runs of scheduler_run() once `ms` milliseconds passed from now (0 for no limit), like
+// the budget running out. The clock is read between slices, so a run can end up to a slice
+// later.
+extern void scheduler_deadline(scheduler_t sched, ullong ms);
+// Stops the guest once it ran `max_insns` more instructions (0 for no limit), whatever the
+// budget of scheduler_run() leaves. Like the budget, a slice can end a few instructions past it.
+extern void scheduler_limit(scheduler_t sched, size_t guest, ullong max_insns);
+// Parks the guest running on the calling thread on `list`, from a device it accesses: its
+// slice ends after the current instruction, and it is skipped until the list is woken, or the
+// run ends. Returns false if the calling thread runs no guest of a scheduler, in which case
+// nothing happens.
+extern bool scheduler_wait(waitlist_t list);
+// Makes the guests parked on `list` runnable again. May be called from any thread, also before
+// the slice of a guest ended, in which case it is not parked at all.
+extern void scheduler_wake(waitlist_t list);
+// Creates an empty wait list, for a device.
+extern waitlist_t waitlist_init(void);
+// Frees a list, which no guest waits on.
+extern void waitlist_free(waitlist_t list);
+extern guest_status scheduler_status(scheduler_t sched, size_t guest);
+// Returns the error message of a faulted guest, or NULL.
+extern const char *scheduler_error(scheduler_t sched, size_t guest);
+// Runs the guests on `threads` host threads until each halted, faulted or reached its limit,
+// or `budget` instructions (0 for no limit) ran in total, or the deadline passed. Parked guests
+// are waited for, and made runnable again if the budget runs out first. A slice can end a few instructions past
+// the budget, like emulstep() runs fused pairs whole.
+// Returns the number of instructions run.
+extern ullong scheduler_run(scheduler_t sched, int threads, ullong budget);
+#endif
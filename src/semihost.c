@@ -0,0 +1,270 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "semihost.h"
+#include "buffer.h"
+#include "error.h"
+
+#define SEMIHOST_IMM 0xF000
+#define OUTPUT_BUFFER_SIZE 65536
+#define HANDLES 3 // stdin, stdout and stderr
+#define CONSOLE ":tt"
+#define CONSOLE_LEN 3
+#define BLOCK_FIELD 8 // bytes per field of a parameter block
+#define ADP_STOPPED_APPLICATION_EXIT 0x20026
+
+// Operation numbers
+#define SYS_OPEN 0x01
+#define SYS_CLOSE 0x02
+#define SYS_WRITEC 0x03
+#define SYS_WRITE0 0x04
+#define SYS_WRITE 0x05
+#define SYS_READ 0x06
+#define SYS_READC 0x07
+#define SYS_ISTTY 0x09
+#define SYS_CLOCK 0x10
+#define SYS_EXIT 0x18
+#define SYS_EXIT_EXTENDED 0x20
+#define SYS_ELAPSED 0x30
+#define SYS_TICKFREQ 0x31
+
+struct semihost
+{
+  buffer_t out[HANDLES]; // output not written yet, for stdout and stderr
+  double start_ms;       // of the first call, for SYS_CLOCK
+};
+
+static FILE *handle_stream(ullong handle)
+{
+  FILE *streams[HANDLES] = {stdin, stdout, stderr};
+  return streams[handle];
+}
+
+static double now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static struct semihost *get_semihost(emulstate state)
+{
+  if (state->semihost == NULL)
+  {
+    struct semihost *host = malloc(sizeof(struct semihost));
+    if (host == NULL)
+    {
+      fprintf(stderr, "Error: Could not allocate semihosting state\n");
+      exit(1);
+    }
+    host->out[0] = NULL;
+    host->out[1] = buffer_init(OUTPUT_BUFFER_SIZE);
+    host->out[2] = buffer_init(OUTPUT_BUFFER_SIZE);
+    host->start_ms = now_ms();
+    state->semihost = host;
+  }
+  return state->semihost;
+}
+
+void semihost_flush(emulstate state)
+{
+  if (state->semihost == NULL)
+    return;
+  for (int handle = 1; handle < HANDLES; handle++)
+  {
+    buffer_t buf = state->semihost->out[handle];
+    buffer_write(buf, handle_stream(handle));
+    buf->len = 0;
+    fflush(handle_stream(handle));
+  }
+}
+
+void semihost_free(emulstate state)
+{
+  if (state->semihost == NULL)
+    return;
+  semihost_flush(state);
+  for (int handle = 1; handle < HANDLES; handle++)
+  {
+    buffer_free(state->semihost->out[handle]);
+  }
+  free(state->semihost);
+  state->semihost = NULL;
+}
+
+// Fails unless `len` bytes from `address` are all in memory
+static void check_range(ullong address, ullong len)
+{
+  if (address > MAX_MEMORY || len > MAX_MEMORY - address)
+  {
+    error_report("Error: Out of bounds memory access 0x%llx\n", address);
+    error_fail();
+  }
+}
+
+// Returns field `idx` of the parameter block at X1
+static ullong block_field(emulstate state, int idx)
+{
+  return load_mem(state, true, state->regs[1] + idx * BLOCK_FIELD);
+}
+
+// Buffers output for stdout or stderr. Output for the other stream is written first, so the
+// two stay in order.
+static void write_output(emulstate state, ullong handle, const byte *data, ullong len)
+{
+  struct semihost *host = get_semihost(state);
+  buffer_t other = host->out[handle == 1 ? 2 : 1];
+  if (other->len > 0)
+  {
+    buffer_write(other, handle_stream(handle == 1 ? 2 : 1));
+    other->len = 0;
+  }
+  buffer_t buf = host->out[handle];
+  if (buf->len + len > OUTPUT_BUFFER_SIZE)
+  {
+    buffer_write(buf, handle_stream(handle));
+    buf->len = 0;
+  }
+  if (len >= OUTPUT_BUFFER_SIZE)
+    fwrite(data, 1, len, handle_stream(handle));
+  else
+    buffer_append(buf, data, len);
+}
+
+// SYS_OPEN: the console only, whose handle depends on the mode (read, write or append)
+static ullong sys_open(emulstate state)
+{
+  ullong name = block_field(state, 0);
+  ullong mode = block_field(state, 1);
+  ullong len = block_field(state, 2);
+  check_range(name, len);
+  if (len != CONSOLE_LEN || memcmp(state->memory + name, CONSOLE, CONSOLE_LEN) != 0)
+    return -1;
+  return mode < 4 ? 0 : mode < 8 ? 1 : 2;
+}
+
+// SYS_WRITE0: a NUL-terminated string at X1
+static ullong sys_write0(emulstate state)
+{
+  ullong address = state->regs[1];
+  check_range(address, 0);
+  const byte *end = memchr(state->memory + address, '\0', MAX_MEMORY - address);
+  if (end == NULL)
+  {
+    error_report("Error: Out of bounds memory access 0x%lx\n", (ulong)MAX_MEMORY);
+    error_fail();
+  }
+  write_output(state, 1, state->memory + address, end - (state->memory + address));
+  return 0;
+}
+
+// SYS_WRITE and SYS_READ return the number of bytes not transferred
+static ullong sys_transfer(emulstate state, ullong op)
+{
+  ullong handle = block_field(state, 0);
+  ullong address = block_field(state, 1);
+  ullong len = block_field(state, 2);
+  check_range(address, len);
+  if (op == SYS_WRITE)
+  {
+    if (handle != 1 && handle != 2)
+      return len;
+    write_output(state, handle, state->memory + address, len);
+    return 0;
+  }
+  if (handle != 0)
+    return len;
+  semihost_flush(state); // prompts are shown before waiting for input
+  ullong read = fread(state->memory + address, 1, len, stdin);
+  invalidate_decoded(state, address, read);
+  return len - read;
+}
+
+// SYS_EXIT and SYS_EXIT_EXTENDED: a normal exit passes its code, anything else exits with 1
+static void sys_exit(emulstate state)
+{
+  ullong reason = block_field(state, 0);
+  state->exit_code = reason == ADP_STOPPED_APPLICATION_EXIT ? (int)block_field(state, 1) : 1;
+  state->exited = true;
+  semihost_flush(state);
+}
+
+// Runs the call. The PC stays on the HLT after an exit, as it does on HALT.
+static void exec_semihost(emulstate state, const decoded_t *d)
+{
+  ullong op = state->regs[0] & 0xFFFFFFFF;
+  ullong result = 0;
+  switch (op)
+  {
+  case SYS_OPEN:
+    result = sys_open(state);
+    break;
+  case SYS_CLOSE:
+    result = block_field(state, 0) < HANDLES ? 0 : -1;
+    break;
+  case SYS_WRITEC:
+    check_range(state->regs[1], 1);
+    write_output(state, 1, state->memory + state->regs[1], 1);
+    break;
+  case SYS_WRITE0:
+    result = sys_write0(state);
+    break;
+  case SYS_WRITE:
+  case SYS_READ:
+    result = sys_transfer(state, op);
+    break;
+  case SYS_READC:
+    semihost_flush(state);
+    result = (byte)getchar();
+    break;
+  case SYS_ISTTY:
+    result = block_field(state, 0) < HANDLES;
+    break;
+  case SYS_CLOCK:
+    result = (now_ms() - get_semihost(state)->start_ms) / 10;
+    break;
+  case SYS_ELAPSED:
+    // Ticks are instructions
+    store_mem(state, true, state->regs[1], state->insns);
+    break;
+  case SYS_TICKFREQ:
+    result = -1; // instructions have no fixed rate
+    break;
+  case SYS_EXIT:
+  case SYS_EXIT_EXTENDED:
+    sys_exit(state);
+    return;
+  default:
+    result = -1;
+  }
+  state->regs[0] = result;
+  state->pc += INSTR_SIZE;
+}
+
+bool semihost_writes(emulstate state, ullong op, ullong block, ullong *address, ullong *len)
+{
+  op &= 0xFFFFFFFF;
+  if (op == SYS_ELAPSED)
+  {
+    *address = block;
+    *len = BLOCK_FIELD;
+  }
+  else if (op == SYS_READ && block <= MAX_MEMORY - 3 * BLOCK_FIELD)
+  {
+    *address = load_mem(state, true, block + BLOCK_FIELD);
+    *len = load_mem(state, true, block + 2 * BLOCK_FIELD);
+  }
+  else
+  {
+    return false;
+  }
+  return *len > 0 && *address < MAX_MEMORY;
+}
+
+bool decode_semihost_instr(ulong raw, decoded_t *d, isa_op op)
+{
+  if (get_value(raw, 5, 16) != SEMIHOST_IMM)
+    return false;
+  d->exec = exec_semihost;
+  return true;
+}
@@ -0,0 +1,28 @@
+#include <stdbool.h>
+#include "emulator.h"
+#include "decode.h"
+
+#ifndef SEMIHOST_H
+#define SEMIHOST_H
+
+// Semihosting, after the Arm semihosting specification: HLT #0xF000 calls the host with the
+// operation in W0 and the address of its parameter block in X1, and returns the result in X0.
+//
+// The console is the only file: handles 0, 1 and 2 are stdin, stdout and stderr, and
+// SYS_OPEN of ":tt" returns one of them by mode. Output collects in a buffer per state, written
+// when it fills up, when the program exits and by semihost_flush(), so printing a character at
+// a time costs no system call each. SYS_CLOCK counts centiseconds from the first call of the
+// program, and SYS_ELAPSED its instructions, so programs can time themselves
+// deterministically. SYS_EXIT and SYS_EXIT_EXTENDED stop the program like HALT, with the exit
+// code in state->exit_code.
+
+extern bool decode_semihost_instr(ulong raw, decoded_t *d, isa_op op);
+// Sets the `len` bytes from `address` that the call `op` with the parameter block at `block`
+// writes to memory, so that translated code can tell if it is overwritten. Returns false if
+// the call writes no memory, or fails before writing.
+extern bool semihost_writes(emulstate state, ullong op, ullong block, ullong *address, ullong *len);
+// Writes the output the program of `state` buffered.
+extern void semihost_flush(emulstate state);
+// Flushes and frees the semihosting state of `state`.
+extern void semihost_free(emulstate state);
+#endif
@@ -55,7 +55,8 @@ long symbol_table_find(symbol_table_t st, char *label, int label_len)
   for (int i = 0; i < st->len; i++)
   {
     if (
-        (label_len >= 0 && strncmp(label, st->elements[i].label, label_len) == 0) ||
+        (label_len >= 0 && strncmp(label, st->elements[i].label, label_len) == 0 &&
+         st->elements[i].label[label_len] == '\0') ||
         (label_len < 0 && strcmp(label, st->elements[i].label) == 0))
     {
       return st->elements[i].address;
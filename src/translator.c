@@ -0,0 +1,850 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include "translator.h"
+#include "decode.h"
+#include "instr_branch.h"
+#include "instr_sdt.h"
+#include "isa.h"
+
+#define EQ 0x0
+#define NE 0x1
+#define GE 0xA
+#define LT 0xB
+#define GT 0xC
+#define LE 0xD
+#define AL 0xE
+
+#define ADDS 1
+#define SUBS 3
+#define ANDS 3
+#define MOVK 3
+#define LSL 0
+#define LSR 1
+#define ASR 2
+
+// How execution continues after a translated instruction
+typedef enum
+{
+  FLOW_NEXT,      // the next word
+  FLOW_B,         // a direct branch
+  FLOW_BCOND,     // a direct branch or the next word
+  FLOW_BR,        // a register branch
+  FLOW_BL,        // a direct call
+  FLOW_BLR,       // a register call
+  FLOW_RET,       // a return, predicted by the return-address stack
+  FLOW_HALT,      // the end of the program
+  FLOW_INTERPRET, // the instruction is run by the interpreter
+} flow_t;
+
+typedef struct
+{
+  FILE *out;
+  const byte *image;
+  ulong size;
+  ulong words;      // words of the image, the last one zero-padded
+  bool *translated; // words reached from a block start
+  bool *leader;     // words starting a block, which have a label and a case in the dispatch
+  bool halts;       // a HALT was translated, so run() has its exit
+  bool stores;      // a store was translated, so run() has the exit for stores into code
+  bool calls;       // a call or return is translated, so run() has the return-address stack
+  bool returns;     // a return is translated, so run() has the jump to predicted returns
+  ulong *sites;     // words calls return to, the return site numbered i + 1 is sites[i]
+  ulong num_sites;
+} translation_t;
+
+// Operand names in the generated code, where the zero register reads as 0
+static const char *const reg_names[SP_REG + 1] = {
+    "x0", "x1", "x2", "x3", "x4", "x5", "x6", "x7", "x8", "x9", "x10",
+    "x11", "x12", "x13", "x14", "x15", "x16", "x17", "x18", "x19", "x20",
+    "x21", "x22", "x23", "x24", "x25", "x26", "x27", "x28", "x29", "x30", "0", "sp"};
+
+// Conditions over the flags of the generated code, indexed by condition code
+static const char *const cond_exprs[AL + 1] = {
+    [EQ] = "z",
+    [NE] = "!z",
+    [GE] = "n == v",
+    [LT] = "n != v",
+    [GT] = "(!z && n == v)",
+    [LE] = "!(!z && n == v)",
+    [AL] = "1"};
+
+static bool valid_cond(byte cond)
+{
+  return cond <= AL && cond_exprs[cond] != NULL;
+}
+
+static ulong image_word(translation_t *t, ulong word)
+{
+  ulong value = 0;
+  for (int idx = 0; idx < INSTR_SIZE; idx++)
+  {
+    ulong offset = word * INSTR_SIZE + idx;
+    if (offset < t->size)
+      value |= (ulong)t->image[offset] << (idx * 8);
+  }
+  return value;
+}
+
+// Decodes a word of the image, and returns how execution continues after it
+static flow_t decode_word(translation_t *t, ulong word, decoded_t *d, isa_op *op)
+{
+  if (!decode_raw(image_word(t, word), d, op))
+    return FLOW_INTERPRET;
+  switch (*op)
+  {
+  case OP_HALT:
+    return FLOW_HALT;
+  case OP_B:
+    return FLOW_B;
+  case OP_BCOND:
+    return FLOW_BCOND;
+  case OP_BR:
+    return FLOW_BR;
+  case OP_BL:
+    return FLOW_BL;
+  case OP_BLR:
+    return FLOW_BLR;
+  case OP_RET:
+    return FLOW_RET;
+  case OP_LDADD:
+  case OP_LDXR:
+  case OP_STXR:
+  case OP_CAS:
+  case OP_DMB:
+  case OP_WFI:
+  case OP_MSR_DAIF:
+  case OP_MSR:
+  case OP_MRS:
+  case OP_ERET:
+  case OP_HLT:
+    return FLOW_INTERPRET;
+  default:
+    return FLOW_NEXT;
+  }
+}
+
+static void mark_leader(translation_t *t, ullong address, ulong *stack, ulong *top)
+{
+  if (address % INSTR_SIZE != 0 || address / INSTR_SIZE >= t->words)
+    return;
+  ulong word = address / INSTR_SIZE;
+  if (t->leader[word])
+    return;
+  t->leader[word] = true;
+  stack[(*top)++] = word;
+}
+
+// A word after a call is where it returns, if it holds an instruction. So is one after B or BR,
+// which make calls with the link set by hand.
+static void mark_return_site(translation_t *t, ulong word, ulong *stack, ulong *top)
+{
+  decoded_t d;
+  isa_op op;
+  if (word < t->words && decode_raw(image_word(t, word), &d, &op))
+    mark_leader(t, word * INSTR_SIZE, stack, top);
+}
+
+// Recovers the blocks reachable from address 0 through direct branches
+static void find_blocks(translation_t *t)
+{
+  ulong *stack = malloc((t->words + 1) * sizeof(ulong));
+  ulong top = 0;
+  mark_leader(t, 0, stack, &top);
+  while (top > 0)
+  {
+    bool block_ends = false;
+    for (ulong word = stack[--top]; !block_ends && word < t->words && !t->translated[word]; word++)
+    {
+      decoded_t d;
+      isa_op op;
+      ullong address = word * INSTR_SIZE;
+      t->translated[word] = true;
+      switch (decode_word(t, word, &d, &op))
+      {
+      case FLOW_NEXT:
+        break;
+      case FLOW_B:
+      case FLOW_BL:
+        t->calls |= op == OP_BL;
+        mark_leader(t, address + d.imm, stack, &top);
+        mark_return_site(t, word + 1, stack, &top);
+        block_ends = true;
+        break;
+      case FLOW_BCOND:
+        mark_leader(t, address + d.imm, stack, &top);
+        break;
+      case FLOW_BR:
+      case FLOW_BLR:
+        t->calls |= op == OP_BLR;
+        mark_return_site(t, word + 1, stack, &top);
+        block_ends = true;
+        break;
+      case FLOW_RET:
+        t->calls = true;
+        t->returns = true;
+        block_ends = true;
+        break;
+      case FLOW_HALT:
+        block_ends = true;
+        break;
+      case FLOW_INTERPRET:
+        mark_leader(t, address + INSTR_SIZE, stack, &top);
+        block_ends = true;
+        break;
+      }
+    }
+  }
+  free(stack);
+}
+
+// Emits a jump to a block, or through the dispatch if no block starts at `target`
+static void emit_jump(translation_t *t, ullong target)
+{
+  if (target % INSTR_SIZE == 0 && target / INSTR_SIZE < t->words && t->leader[target / INSTR_SIZE])
+    fprintf(t->out, "goto L%llx;", target);
+  else
+    fprintf(t->out, "{ s->pc = %#llxull; goto dispatch; }", target);
+}
+
+static void emit_set_rd(translation_t *t, byte rd, const char *value)
+{
+  if (rd != GENERAL_REGS)
+    fprintf(t->out, " %s = %s;", reg_names[rd], value);
+}
+
+// True if a word is SUBS counting a register down in a B.NE loop to itself, like the busy-wait
+// loops emulstep() fast-forwards
+static bool idle_loop(translation_t *t, ulong word, const decoded_t *d)
+{
+  decoded_t next;
+  isa_op next_op;
+  if (get_value(d->raw, 29, 2) != SUBS || d->rd != d->rn || d->rd == GENERAL_REGS || d->imm == 0)
+    return false;
+  return word + 1 < t->words && decode_raw(image_word(t, word + 1), &next, &next_op) &&
+         next_op == OP_BCOND && next.cond == NE && next.imm == (ullong)-INSTR_SIZE;
+}
+
+// ADD, ADDS, SUB and SUBS (immediate), with the flags of instr_dpimm.c
+static void emit_arith_imm(translation_t *t, const decoded_t *d, bool sf, const char *w, bool idle)
+{
+  ulong opc = get_value(d->raw, 29, 2);
+  // An exact count skips to the last iteration, which leaves the registers and flags
+  if (idle)
+    fprintf(t->out, "if (%s(%s) %% %#llxull == 0 && %s(%s) != 0) %s = %#llxull; ",
+            w, reg_names[d->rn], d->imm, w, reg_names[d->rn], reg_names[d->rd], d->imm);
+  fprintf(t->out, "{ ullong rn = %s(%s); ullong result = rn %c %#llxull;",
+          w, reg_names[d->rn], opc >= 2 ? '-' : '+', d->imm);
+  emit_set_rd(t, d->rd, sf ? "W64(result)" : "W32(result)");
+  if (opc == ADDS || opc == SUBS)
+    fprintf(t->out, " n = (result >> %d) != 0; z = result == 0;", sf ? 63 : 31);
+  if (opc == ADDS)
+    fprintf(t->out, " c = result < rn;");
+  else if (opc == SUBS)
+    fprintf(t->out, " c = rn >= %#llxull; v = 0;", d->imm);
+  fprintf(t->out, " }\n");
+}
+
+// MOVN, MOVZ and MOVK, whose operands were computed by decode_dpimm_instr()
+static void emit_wide_move(translation_t *t, const decoded_t *d, bool sf, const char *w)
+{
+  if (d->rd == GENERAL_REGS)
+  {
+    fprintf(t->out, "\n");
+    return;
+  }
+  const char *rd = reg_names[d->rd];
+  if (get_value(d->raw, 29, 2) == MOVK)
+    fprintf(t->out, "%s = %s((%s(%s) & %#llxull) | %#llxull);\n",
+            rd, w, w, rd, ~(0xFFFFull << d->shift), d->imm);
+  else
+    fprintf(t->out, "%s = %#llxull;\n", rd, sf ? W64(d->imm) : W32(d->imm));
+}
+
+// Logical and arithmetic (shifted register) instructions, with the flags of instr_dpreg.c
+static void emit_dpreg(translation_t *t, const decoded_t *d, isa_op op, bool sf, const char *w)
+{
+  int width = sf ? 64 : 32;
+  ulong opc = get_value(d->raw, 29, 2);
+  bool N = get_value(d->raw, 21, 1);
+  fprintf(t->out, "{ ullong rn = %s(%s); ullong rm = %s(%s);",
+          w, reg_names[d->rn], w, reg_names[d->rm]);
+  if (d->shift != 0)
+  {
+    switch (d->stype)
+    {
+    case LSL:
+      fprintf(t->out, " rm = %s(rm << %d);", w, d->shift);
+      break;
+    case LSR:
+      fprintf(t->out, " rm = rm >> %d;", d->shift);
+      break;
+    case ASR:
+      fprintf(t->out, " rm = %s((%s)rm >> %d);", w, sf ? "llong" : "int", d->shift);
+      break;
+    default:
+      fprintf(t->out, " rm = %s((rm >> %d) | (rm << %d));", w, d->shift, width - d->shift);
+    }
+  }
+  const char *flags = NULL;
+  if (op == OP_LOGIC_REG)
+  {
+    static const char *const logic_ops[4] = {"&", "|", "^", "&"};
+    fprintf(t->out, " ullong rd = %s(rn %s %srm);", w, logic_ops[opc], N ? "~" : "");
+    flags = opc == ANDS ? "c = 0;" : NULL;
+  }
+  else
+  {
+    fprintf(t->out, " ullong rd = %s(rn %c rm);", w, opc >= 2 ? '-' : '+');
+    flags = opc == ADDS ? "c = rd < rn;" : opc == SUBS ? "c = rd <= rn;" : NULL;
+  }
+  emit_set_rd(t, d->rd, "rd");
+  if (flags != NULL)
+    fprintf(t->out, " n = MSB%d(rd); z = rd == 0; %s v = 0;", width, flags);
+  fprintf(t->out, " }\n");
+}
+
+// MADD and MSUB
+static void emit_multiply(translation_t *t, const decoded_t *d, const char *w)
+{
+  if (d->rd == GENERAL_REGS)
+  {
+    fprintf(t->out, "\n");
+    return;
+  }
+  bool x = get_value(d->raw, 15, 1);
+  fprintf(t->out, "{ ullong product = %s(%s) * %s(%s); %s = %s(%s(%s) %c product); }\n",
+          w, reg_names[d->rn], w, reg_names[d->rm], reg_names[d->rd], w, w, reg_names[d->ra],
+          x ? '-' : '+');
+}
+
+// Conditional selects, of which those decode_cond_instr() ignores are dropped
+static void emit_cond(translation_t *t, const decoded_t *d, isa_op op, bool sf, const char *w)
+{
+  bool ignored = !valid_cond(d->cond) || op == OP_COND_OTHER ||
+                 ((op == OP_CSET || op == OP_CSETM) && d->cond == AL);
+  if (ignored || d->rd == GENERAL_REGS)
+  {
+    fprintf(t->out, "\n");
+    return;
+  }
+  const char *rd = reg_names[d->rd];
+  const char *cond = cond_exprs[d->cond];
+  switch (op)
+  {
+  case OP_CSET:
+    fprintf(t->out, "%s = %s ? 1 : 0;\n", rd, cond);
+    return;
+  case OP_CSETM:
+    fprintf(t->out, "%s = %s ? %#llxull : 0;\n", rd, cond, sf ? W64(~0ull) : W32(~0ull));
+    return;
+  default:
+    break;
+  }
+  const char *rm = op == OP_CSINC   ? "rm + 1"
+                   : op == OP_CSINV ? "~rm"
+                   : op == OP_CSNEG ? (sf ? "rm ^ (1ull << 63)" : "rm ^ (1ull << 31)")
+                                    : "rm";
+  fprintf(t->out, "{ ullong rm = %s(%s); %s = %s ? %s(%s) : %s(%s); }\n",
+          w, reg_names[d->rm], rd, cond, w, reg_names[d->rn], w, rm);
+}
+
+// The address of a load or store decoded by decode_sdt_instr() or decode_sdt_pair() at `pc`,
+// writing back the base first in the pre and post-indexed modes
+static void emit_sdt_address(translation_t *t, const decoded_t *d, ullong pc)
+{
+  const char *base = reg_names[d->rn];
+  switch (d->stype)
+  {
+  case SDT_LITERAL:
+    fprintf(t->out, "ullong address = %#llxull;", pc + d->imm);
+    break;
+  case SDT_REGISTER:
+  {
+    const char *index = reg_names[d->rm];
+    const char *extend = d->cond == EXTEND_UXTW   ? "W32"
+                         : d->cond == EXTEND_SXTW ? "(ullong)(int)"
+                                                  : "W64";
+    fprintf(t->out, "ullong address = %s + (%s(%s) << %llu);", base, extend, index, d->imm);
+    break;
+  }
+  case SDT_PRE:
+    fprintf(t->out, "ullong address = %s + %#llxull; %s = address;", base, d->imm, base);
+    break;
+  case SDT_POST:
+    fprintf(t->out, "ullong address = %s; %s = address + %#llxull;", base, base, d->imm);
+    break;
+  default:
+    fprintf(t->out, "ullong address = %s + %#llxull;", base, d->imm);
+    break;
+  }
+}
+
+// Loads into register `rt` the d->shift bytes at `address`, sign-extended as decoded in d->ra
+static void emit_load_value(translation_t *t, const decoded_t *d, byte rt, const char *address)
+{
+  static const char *const signed_types[] = {[1] = "signed char", [2] = "short", [4] = "int"};
+  char value[64];
+  if (d->ra == 0)
+    snprintf(value, sizeof(value), "load(s, %d, %s)", d->shift, address);
+  else
+    snprintf(value, sizeof(value), "(%s)(%s)load(s, %d, %s)", d->ra == 32 ? "uint" : "ullong",
+             signed_types[d->shift], d->shift, address);
+  if (rt != GENERAL_REGS)
+    fprintf(t->out, " %s = %s;", reg_names[rt], value);
+  else
+    fprintf(t->out, " %s;", value);
+}
+
+// Loads and stores of one register, decoded by decode_sdt_instr()
+static void emit_sdt(translation_t *t, const decoded_t *d, ullong address)
+{
+  bool load = d->stype == SDT_LITERAL || get_value(d->raw, 22, 2) != 0;
+
+  // The stored register is read before the base is written back
+  fprintf(t->out, "{ ");
+  if (!load)
+    fprintf(t->out, "ullong value = %s; ", reg_names[d->rd]);
+  emit_sdt_address(t, d, address);
+  if (load)
+    emit_load_value(t, d, d->rd, "address");
+  else
+  {
+    t->stores = true;
+    fprintf(t->out, " store_mem_size(s, %d, address, value);"
+                    " if (touches_code(address, %d)) { s->pc = %#llxull; goto stale; }",
+            d->shift, d->shift, address + INSTR_SIZE);
+  }
+  fprintf(t->out, " }\n");
+}
+
+// LDP, LDPSW and STP, decoded by decode_sdt_pair()
+static void emit_pair(translation_t *t, const decoded_t *d, ullong address)
+{
+  bool load = get_value(d->raw, 22, 1);
+
+  // Stored registers are read before the base is written back
+  fprintf(t->out, "{ ");
+  if (!load)
+    fprintf(t->out, "ullong first = %s; ullong second = %s; ", reg_names[d->rd], reg_names[d->rm]);
+  emit_sdt_address(t, d, address);
+
+  if (load)
+  {
+    char second[32];
+    snprintf(second, sizeof(second), "address + %d", d->shift);
+    emit_load_value(t, d, d->rd, "address");
+    emit_load_value(t, d, d->rm, second);
+  }
+  else
+  {
+    t->stores = true;
+    fprintf(t->out, " store_mem_size(s, %d, address, first); store_mem_size(s, %d, address + %d, second);"
+                    " if (touches_code(address, %d)) { s->pc = %#llxull; goto stale; }",
+            d->shift, d->shift, d->shift, 2 * d->shift, address + INSTR_SIZE);
+  }
+  fprintf(t->out, " }\n");
+}
+
+// Pushes the return address of a call at `address` on the return-address stack, with its
+// return site if the next word starts a block
+static void emit_push_return(translation_t *t, ulong word)
+{
+  ulong site = 0;
+  if (word + 1 < t->words && t->leader[word + 1])
+  {
+    t->sites[t->num_sites++] = word + 1;
+    site = t->num_sites;
+  }
+  fprintf(t->out, "x30 = %#lxull; RAS_PUSH(x30, %lu); ", (word + 1) * INSTR_SIZE, site);
+}
+
+// Floating point instructions, run by exec_simd_fp_instr() on the registers it reads and writes
+static void emit_simd_fp(translation_t *t, const decoded_t *d, ullong address)
+{
+  byte rd = get_value(d->raw, 0, 5);
+  byte rn = get_value(d->raw, 5, 5);
+  // Conversions read rn or write rd as general registers, and FCMP sets the flags
+  fprintf(t->out, "{ ");
+  if (rn != GENERAL_REGS)
+    fprintf(t->out, "s->regs[%d] = %s; ", rn, reg_names[rn]);
+  if (rd != GENERAL_REGS)
+    fprintf(t->out, "s->regs[%d] = %s; ", rd, reg_names[rd]);
+  fprintf(t->out, "SAVE_FLAGS(); if (!exec_simd_fp_instr(s, %#x)) { s->pc = %#llxull; goto interpret; } ",
+          d->raw, address);
+  if (rd != GENERAL_REGS)
+    fprintf(t->out, "%s = s->regs[%d]; ", reg_names[rd], rd);
+  fprintf(t->out, "LOAD_FLAGS(); }\n");
+}
+
+// Emits one instruction, and returns how execution continues after it
+static flow_t emit_instr(translation_t *t, ulong word)
+{
+  decoded_t d;
+  isa_op op;
+  ullong address = word * INSTR_SIZE;
+  flow_t flow = decode_word(t, word, &d, &op);
+  bool sf = get_value(d.raw, 31, 1);
+  const char *w = sf ? "W64" : "W32";
+
+  fprintf(t->out, "  /* %05llx: %08x */ ", address, d.raw);
+  switch (flow)
+  {
+  case FLOW_HALT:
+    fprintf(t->out, "{ s->pc = %#llxull; goto halt; }\n", address);
+    t->halts = true;
+    return flow;
+  case FLOW_INTERPRET:
+    // An atomic storing into translated code leaves the rest of the run to the interpreter
+    if (op == OP_LDADD || op == OP_STXR || op == OP_CAS)
+    {
+      t->stores = true;
+      fprintf(t->out, "if (touches_code(%s, 8)) { s->pc = %#llxull; goto stale; } ",
+              reg_names[d.rn], address);
+    }
+    // So does a semihosting call reading input or the instruction count into it
+    if (op == OP_HLT)
+    {
+      t->stores = true;
+      fprintf(t->out, "{ ullong a, n; if (semihost_writes(s, x0, x1, &a, &n) && touches_code(a, n)) "
+                      "{ s->pc = %#llxull; goto stale; } } ", address);
+    }
+    fprintf(t->out, "{ s->pc = %#llxull; goto interpret; }\n", address);
+    return flow;
+  case FLOW_B:
+    emit_jump(t, address + d.imm);
+    fprintf(t->out, "\n");
+    return flow;
+  case FLOW_BCOND:
+    fprintf(t->out, "if (%s) ", cond_exprs[d.cond]);
+    emit_jump(t, address + d.imm);
+    fprintf(t->out, "\n");
+    return flow;
+  case FLOW_BR:
+    fprintf(t->out, "{ s->pc = %s; goto dispatch; }\n", reg_names[d.rn]);
+    return flow;
+  case FLOW_BL:
+    fprintf(t->out, "{ ");
+    emit_push_return(t, word);
+    emit_jump(t, address + d.imm);
+    fprintf(t->out, " }\n");
+    return flow;
+  case FLOW_BLR:
+    fprintf(t->out, "{ ullong target = %s; ", reg_names[d.rn]);
+    emit_push_return(t, word);
+    fprintf(t->out, "s->pc = target; goto dispatch; }\n");
+    return flow;
+  case FLOW_RET:
+    fprintf(t->out, "{ s->pc = %s; RAS_POP(); }\n", reg_names[d.rn]);
+    return flow;
+  default:
+    break;
+  }
+
+  switch (op)
+  {
+  case OP_ARITH_IMM:
+    emit_arith_imm(t, &d, sf, w, idle_loop(t, word, &d));
+    break;
+  case OP_WIDE_MOVE:
+    emit_wide_move(t, &d, sf, w);
+    break;
+  case OP_LOGIC_REG:
+  case OP_ARITH_REG:
+    emit_dpreg(t, &d, op, sf, w);
+    break;
+  case OP_MULTIPLY:
+    emit_multiply(t, &d, w);
+    break;
+  case OP_DPREG_OTHER:
+    // Only truncates rd to the width
+    if (d.rd != GENERAL_REGS)
+      fprintf(t->out, "%s = %s(%s);\n", reg_names[d.rd], w, reg_names[d.rd]);
+    else
+      fprintf(t->out, "\n");
+    break;
+  case OP_LOAD_STORE:
+  case OP_LOAD_LITERAL:
+    emit_sdt(t, &d, address);
+    break;
+  case OP_LOAD_STORE_PAIR:
+    emit_pair(t, &d, address);
+    break;
+  case OP_FP_DP:
+    emit_simd_fp(t, &d, address);
+    break;
+  default:
+    emit_cond(t, &d, op, sf, w);
+  }
+  return flow;
+}
+
+// Copies between the flags, and with `regs` the registers, of the state and the locals of run()
+static void emit_copy_macro(translation_t *t, const char *name, bool save, bool regs)
+{
+  static const char *const flags[] = {"n", "negative", "z", "zero", "c", "carry", "v", "overflow"};
+  fprintf(t->out, "#define %s() \\\n  do \\\n  { \\\n", name);
+  for (int rg = 0; regs && rg < GENERAL_REGS; rg++)
+  {
+    if (save)
+      fprintf(t->out, "    s->regs[%d] = x%d; \\\n", rg, rg);
+    else
+      fprintf(t->out, "    x%d = s->regs[%d]; \\\n", rg, rg);
+  }
+  if (regs)
+    fprintf(t->out, save ? "    s->regs[%d] = sp; \\\n" : "    sp = s->regs[%d]; \\\n", SP_REG);
+  for (int flag = 0; flag < 8; flag += 2)
+  {
+    if (save)
+      fprintf(t->out, "    s->pstate.%s = %s; \\\n", flags[flag + 1], flags[flag]);
+    else
+      fprintf(t->out, "    %s = s->pstate.%s; \\\n", flags[flag], flags[flag + 1]);
+  }
+  fprintf(t->out, "  } while (0)\n\n");
+}
+
+static void emit_bytes(translation_t *t, const char *decl, ulong count, const byte *values,
+                       const bool *flags)
+{
+  // One extra zero, so that the array is never empty
+  fprintf(t->out, "%s[%lu] = {", decl, count + 1);
+  for (ulong idx = 0; idx < count; idx++)
+  {
+    if (idx % 16 == 0)
+      fprintf(t->out, "\n   ");
+    fprintf(t->out, " %d,", values != NULL ? values[idx] : flags[idx]);
+  }
+  fprintf(t->out, "\n    0};\n\n");
+}
+
+static const char prelude[] =
+    "#include <stdbool.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#include \"emulator.h\"\n"
+    "#include \"instr_simd_fp.h\"\n"
+    "#include \"interrupt.h\"\n"
+    "#include \"semihost.h\"\n"
+    "\n"
+    "#define W64(value) ((ullong)(value))\n"
+    "#define W32(value) ((ullong)(value) & 0xFFFFFFFF)\n"
+    "#define MSB64(value) (((value) >> 63) & 1)\n"
+    "#define MSB32(value) (((value) >> 31) & 1)\n"
+    "\n"
+    "// Return-address stack of calls, predicting the return site of a return without the dispatch\n"
+    "#define RAS_SIZE 16\n"
+    "#define RAS_PUSH(address, site) \\\n"
+    "  do \\\n"
+    "  { \\\n"
+    "    ras_address[ras_top % RAS_SIZE] = (address); \\\n"
+    "    ras_site[ras_top % RAS_SIZE] = (site); \\\n"
+    "    ras_top++; \\\n"
+    "  } while (0)\n"
+    "#define RAS_POP() \\\n"
+    "  do \\\n"
+    "  { \\\n"
+    "    ras_top--; \\\n"
+    "    if (ras_address[ras_top % RAS_SIZE] == s->pc) \\\n"
+    "      goto ras_return; \\\n"
+    "    goto dispatch; \\\n"
+    "  } while (0)\n"
+    "\n";
+
+static const char helpers[] =
+    "// load_mem_size(), inlined where the access is in bounds\n"
+    "static inline ullong load(emulstate s, int size, ullong address)\n"
+    "{\n"
+    "  if (address > MAX_MEMORY - size)\n"
+    "    return load_mem_size(s, size, address);\n"
+    "  const byte *from = s->memory + address;\n"
+    "  switch (size)\n"
+    "  {\n"
+    "  case 1:\n"
+    "    return *from;\n"
+    "  case 2:\n"
+    "  {\n"
+    "    unsigned short data;\n"
+    "    memcpy(&data, from, sizeof(data));\n"
+    "    return data;\n"
+    "  }\n"
+    "  case 4:\n"
+    "  {\n"
+    "    uint data;\n"
+    "    memcpy(&data, from, sizeof(data));\n"
+    "    return data;\n"
+    "  }\n"
+    "  default:\n"
+    "  {\n"
+    "    ullong data;\n"
+    "    memcpy(&data, from, sizeof(data));\n"
+    "    return data;\n"
+    "  }\n"
+    "  }\n"
+    "}\n"
+    "\n"
+    "// True if a store of `size` bytes at `address` changed translated code\n"
+    "static inline bool touches_code(ullong address, ullong size)\n"
+    "{\n"
+    "  for (ullong word = address / INSTR_SIZE; word <= (address + size - 1) / INSTR_SIZE && word < CODE_WORDS; word++)\n"
+    "  {\n"
+    "    if (translated[word])\n"
+    "      return true;\n"
+    "  }\n"
+    "  return false;\n"
+    "}\n"
+    "\n";
+
+static const char run_start[] =
+    "static void run(emulstate s)\n"
+    "{\n"
+    "  ullong x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15,\n"
+    "      x16, x17, x18, x19, x20, x21, x22, x23, x24, x25, x26, x27, x28, x29, x30, sp;\n"
+    "  bool n, z, c, v;\n";
+
+static const char ras_locals[] =
+    "  // Entries never pushed have no return site\n"
+    "  ullong ras_address[RAS_SIZE] = {0};\n"
+    "  ulong ras_site[RAS_SIZE] = {0};\n"
+    "  uint ras_top = 0;\n";
+
+static const char run_dispatch[] =
+    "  LOAD_REGS();\n"
+    "\n"
+    "dispatch:\n"
+    "  switch (s->pc)\n"
+    "  {\n";
+
+static const char run_exits[] =
+    "  default:\n"
+    "    goto interpret;\n"
+    "  }\n"
+    "interpret:\n"
+    "  // No block starts at the PC, or its instruction is not translated\n"
+    "  SAVE_REGS();\n"
+    "  if (!emulstep(s))\n"
+    "    return;\n"
+    "  // Such as an interrupt raised by the instruction, before translated code runs on\n"
+    "  if (s->insns >= s->next_event)\n"
+    "    events_run(s);\n"
+    "  LOAD_REGS();\n"
+    "  goto dispatch;\n"
+    "\n";
+
+static const char halt_exit[] =
+    "halt:\n"
+    "  SAVE_REGS();\n"
+    "  return;\n";
+
+static const char stale_exit[] =
+    "stale:\n"
+    "  // Translated code was overwritten, so the interpreter runs the rest of the program\n"
+    "  SAVE_REGS();\n"
+    "  while (emulstep(s))\n"
+    "  {\n"
+    "  }\n"
+    "  return;\n";
+
+static const char main_fn[] =
+    "}\n"
+    "\n"
+    "int main(int argc, char **argv)\n"
+    "{\n"
+    "  if (argc > 2)\n"
+    "  {\n"
+    "    fprintf(stderr, \"Usage: %s [<file out>]\\n\", argv[0]);\n"
+    "    return EXIT_FAILURE;\n"
+    "  }\n"
+    "  FILE *fout = stdout;\n"
+    "  if (argc == 2)\n"
+    "  {\n"
+    "    fout = fopen(argv[1], \"wb\");\n"
+    "    if (fout == NULL)\n"
+    "    {\n"
+    "      fprintf(stderr, \"Error: Could not open file %s\\n\", argv[1]);\n"
+    "      return EXIT_FAILURE;\n"
+    "    }\n"
+    "  }\n"
+    "\n"
+    "  emulstate s = emulstate_init();\n"
+    "  memcpy(s->memory, image, IMAGE_SIZE);\n"
+    "  invalidate_decoded(s, 0, IMAGE_SIZE);\n"
+    "  run(s);\n"
+    "  semihost_flush(s);\n"
+    "  fprint_emulstate(fout, s);\n"
+    "  fclose(fout);\n"
+    "  int status = s->exit_code;\n"
+    "  emulstate_free(s);\n"
+    "  return status;\n"
+    "}\n";
+
+static void emit_program(translation_t *t, ulong size)
+{
+  ulong code_words = 0;
+  for (ulong word = 0; word < t->words; word++)
+  {
+    if (t->translated[word])
+      code_words = word + 1;
+  }
+
+  fprintf(t->out, "// Generated by armv8-aot. Build with -O2, linked with libarmv8.a.\n");
+  fprintf(t->out, "%s", prelude);
+  fprintf(t->out, "#define IMAGE_SIZE %lu\n#define CODE_WORDS %lu\n\n", size, code_words);
+  emit_bytes(t, "static const byte image", size, t->image, NULL);
+  emit_bytes(t, "// Words translated into run()\nstatic const bool translated", code_words, NULL,
+             t->translated);
+  emit_copy_macro(t, "LOAD_REGS", false, true);
+  emit_copy_macro(t, "SAVE_REGS", true, true);
+  emit_copy_macro(t, "LOAD_FLAGS", false, false);
+  emit_copy_macro(t, "SAVE_FLAGS", true, false);
+  fprintf(t->out, "%s", helpers);
+
+  fprintf(t->out, "%s", run_start);
+  if (t->calls)
+    fprintf(t->out, "%s", ras_locals);
+  fprintf(t->out, "%s", run_dispatch);
+  for (ulong word = 0; word < t->words; word++)
+  {
+    if (t->leader[word])
+      fprintf(t->out, "  case %#lx:\n    goto L%lx;\n", word * INSTR_SIZE, word * INSTR_SIZE);
+  }
+  fprintf(t->out, "%s", run_exits);
+
+  for (ulong word = 0; word < t->words; word++)
+  {
+    if (!t->translated[word])
+      continue;
+    if (t->leader[word])
+      fprintf(t->out, "L%lx:\n", word * INSTR_SIZE);
+    flow_t flow = emit_instr(t, word);
+    bool falls_through = flow == FLOW_NEXT || flow == FLOW_BCOND;
+    if (falls_through && (word + 1 >= t->words || !t->translated[word + 1]))
+      fprintf(t->out, "  { s->pc = %#lxull; goto dispatch; }\n", (word + 1) * INSTR_SIZE);
+  }
+  if (t->returns)
+  {
+    fprintf(t->out, "ras_return:\n  // The return-address stack predicted the return, so its site is jumped to directly\n"
+                    "  switch (ras_site[ras_top %% RAS_SIZE])\n  {\n");
+    for (ulong site = 0; site < t->num_sites; site++)
+      fprintf(t->out, "  case %lu:\n    goto L%lx;\n", site + 1, t->sites[site] * INSTR_SIZE);
+    fprintf(t->out, "  }\n  goto dispatch;\n");
+  }
+  if (t->halts)
+    fprintf(t->out, "%s", halt_exit);
+  if (t->stores)
+    fprintf(t->out, "%s", stale_exit);
+  fprintf(t->out, "%s", main_fn);
+}
+
+void translate_image(FILE *out, const byte *image, ulong size)
+{
+  translation_t t = {out, image, size, (size + INSTR_SIZE - 1) / INSTR_SIZE, NULL, NULL, false, false,
+                     false, false, NULL, 0};
+  t.translated = calloc(t.words + 1, sizeof(bool));
+  t.leader = calloc(t.words + 1, sizeof(bool));
+  t.sites = calloc(t.words + 1, sizeof(ulong));
+  find_blocks(&t);
+  emit_program(&t, size);
+  free(t.translated);
+  free(t.leader);
+  free(t.sites);
+}
@@ -0,0 +1,25 @@
+#include <stdio.h>
+#include "emulator.h"
+
+#ifndef TRANSLATOR_H
+#define TRANSLATOR_H
+
+// Ahead-of-time translation of a guest image into a C program, see armv8-aot in the README.
+//
+// The code reachable from address 0 through direct branches (and the words after calls, B and
+// BR, where calls return to) is translated into basic blocks of C, with the semantics of the
+// instr_*.c handlers. Everything else runs on the interpreter of libarmv8, which the program
+// is linked with: instructions the translator leaves to it (floating point, atomic, system,
+// semihosting and unknown instructions), BR to addresses that start no block, and the rest of
+// the run after a store into translated code. Translated code does not count instructions, so
+// SYS_ELAPSED and the generic timer count the interpreted ones only, and interrupts are taken
+// after interpreted instructions only (see interrupt.h). The program prints the fprint_emulstate() dump
+// when it halts, and exits with the code of a semihosting exit call.
+//
+// BL and BLR push their return address on a return-address stack in the generated code. A RET
+// to the address on top jumps straight to the block after the call; other returns, and calls
+// deeper than the stack, go through the dispatch like BR.
+
+// Writes the C program running `size` bytes of guest `image` loaded at address 0.
+extern void translate_image(FILE *out, const byte *image, ulong size);
+#endif
@@ -0,0 +1,291 @@
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "uart.h"
+#include "scheduler.h"
+
+#define OUTPUT_RING_SIZE 65536
+#define INPUT_RING_SIZE 4096
+#define INPUT_CHUNK 256
+#define MAX_CORES 256 // see emulstate_init_core()
+// Registers, by offset
+#define UARTDR 0x000
+#define UARTFR 0x018
+// UARTFR bits
+#define FR_BUSY (1 << 3)
+#define FR_RXFE (1 << 4)
+#define FR_TXFF (1 << 5)
+#define FR_TXFE (1 << 7)
+
+// A ring of bytes, from tail to head. The counts only grow, and index the data modulo its size.
+typedef struct
+{
+  byte *data;
+  ulong size;
+  ullong head;
+  ullong tail;
+} ring_t;
+
+struct uart
+{
+  int out_fd;
+  int in_fd;
+  ring_t out;
+  ring_t in;
+  pthread_mutex_t lock;
+  pthread_cond_t out_ready; // output to write, for the output thread
+  pthread_cond_t out_space; // output was written
+  pthread_cond_t in_space;  // input was taken, for the input thread
+  int flushing;             // callers of uart_flush() waiting
+  bool closing;
+  bool reading;  // the input thread was started, by the first load of a register
+  bool in_ended; // the input thread read the end of the input, or failed
+  bool polling[MAX_CORES]; // by core: the last access was a load of UARTFR finding no input
+  waitlist_t waiting;      // cores waiting for input (scheduler.h)
+  pthread_t out_thread;
+  pthread_t in_thread;
+};
+
+static void ring_init(ring_t *ring, ulong size)
+{
+  ring->data = malloc(size);
+  assert(ring->data != NULL);
+  ring->size = size;
+  ring->head = 0;
+  ring->tail = 0;
+}
+
+static ulong ring_used(const ring_t *ring)
+{
+  return ring->head - ring->tail;
+}
+
+// Writes all of `len` bytes, dropping them if the file fails
+static void write_all(int fd, const byte *data, ulong len)
+{
+  while (len > 0)
+  {
+    ssize_t written = write(fd, data, len);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return;
+    data += written;
+    len -= written;
+  }
+}
+
+// Writes output in batches, straight from the ring
+static void *drain_output(void *arg)
+{
+  uart_t uart = arg;
+  pthread_mutex_lock(&uart->lock);
+  while (true)
+  {
+    if (ring_used(&uart->out) == 0)
+    {
+      if (uart->closing)
+        break;
+      pthread_cond_wait(&uart->out_ready, &uart->lock);
+      continue;
+    }
+    // Lets a batch gather, unless the ring fills up or output is waited for
+    if (ring_used(&uart->out) < uart->out.size / 2 && uart->flushing == 0 && !uart->closing)
+    {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += UART_DRAIN_MS * 1000000L;
+      deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+      deadline.tv_nsec %= 1000000000L;
+      pthread_cond_timedwait(&uart->out_ready, &uart->lock, &deadline);
+    }
+    // Stores only fill the ring past the head, so the bytes up to it are written unlocked
+    ulong start = uart->out.tail % uart->out.size;
+    ulong len = ring_used(&uart->out);
+    if (len > uart->out.size - start)
+      len = uart->out.size - start;
+    pthread_mutex_unlock(&uart->lock);
+    write_all(uart->out_fd, uart->out.data + start, len);
+    pthread_mutex_lock(&uart->lock);
+    uart->out.tail += len;
+    pthread_cond_broadcast(&uart->out_space);
+  }
+  pthread_mutex_unlock(&uart->lock);
+  return NULL;
+}
+
+// Reads input into the ring, until the input ends or the UART is freed
+static void *read_input(void *arg)
+{
+  uart_t uart = arg;
+  byte chunk[INPUT_CHUNK];
+  while (true)
+  {
+    // read() is the only cancellation point, so the thread never stops holding the lock
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    ssize_t len = read(uart->in_fd, chunk, sizeof(chunk));
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    if (len < 0 && errno == EINTR)
+      continue;
+    if (len <= 0)
+    {
+      pthread_mutex_lock(&uart->lock);
+      uart->in_ended = true;
+      pthread_mutex_unlock(&uart->lock);
+      scheduler_wake(uart->waiting);
+      return NULL;
+    }
+    pthread_mutex_lock(&uart->lock);
+    for (ssize_t idx = 0; idx < len && !uart->closing; idx++)
+    {
+      while (ring_used(&uart->in) == uart->in.size && !uart->closing)
+      {
+        pthread_cond_wait(&uart->in_space, &uart->lock);
+      }
+      uart->in.data[uart->in.head++ % uart->in.size] = chunk[idx];
+    }
+    bool closing = uart->closing;
+    pthread_mutex_unlock(&uart->lock);
+    scheduler_wake(uart->waiting);
+    if (closing)
+      return NULL;
+  }
+}
+
+uart_t uart_init(int out_fd, int in_fd)
+{
+  uart_t uart = malloc(sizeof(struct uart));
+  assert(uart != NULL);
+  uart->out_fd = out_fd;
+  uart->in_fd = in_fd;
+  ring_init(&uart->out, OUTPUT_RING_SIZE);
+  ring_init(&uart->in, INPUT_RING_SIZE);
+  pthread_mutex_init(&uart->lock, NULL);
+  pthread_cond_init(&uart->out_ready, NULL);
+  pthread_cond_init(&uart->out_space, NULL);
+  pthread_cond_init(&uart->in_space, NULL);
+  uart->flushing = 0;
+  uart->closing = false;
+  uart->reading = false;
+  uart->in_ended = false;
+  for (uint core = 0; core < MAX_CORES; core++)
+  {
+    uart->polling[core] = false;
+  }
+  uart->waiting = waitlist_init();
+  if (pthread_create(&uart->out_thread, NULL, drain_output, uart) != 0)
+  {
+    fprintf(stderr, "Error: Could not create UART thread\n");
+    exit(EXIT_FAILURE);
+  }
+  return uart;
+}
+
+// Starts reading input at the first load of a register, so that a guest that never reads the
+// UART leaves the input file unread. Called with the lock held.
+static void start_input(uart_t uart)
+{
+  if (uart->reading || uart->in_fd < 0)
+    return;
+  uart->reading = true;
+  if (pthread_create(&uart->in_thread, NULL, read_input, uart) != 0)
+  {
+    fprintf(stderr, "Error: Could not create UART thread\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void uart_flush(uart_t uart)
+{
+  pthread_mutex_lock(&uart->lock);
+  uart->flushing++;
+  pthread_cond_signal(&uart->out_ready);
+  while (ring_used(&uart->out) > 0)
+  {
+    pthread_cond_wait(&uart->out_space, &uart->lock);
+  }
+  uart->flushing--;
+  pthread_mutex_unlock(&uart->lock);
+}
+
+void uart_free(uart_t uart)
+{
+  pthread_mutex_lock(&uart->lock);
+  uart->closing = true;
+  pthread_cond_signal(&uart->out_ready);
+  pthread_cond_broadcast(&uart->in_space);
+  pthread_mutex_unlock(&uart->lock);
+  pthread_join(uart->out_thread, NULL);
+  if (uart->reading)
+  {
+    pthread_cancel(uart->in_thread);
+    pthread_join(uart->in_thread, NULL);
+  }
+  waitlist_free(uart->waiting);
+  pthread_cond_destroy(&uart->out_ready);
+  pthread_cond_destroy(&uart->out_space);
+  pthread_cond_destroy(&uart->in_space);
+  pthread_mutex_destroy(&uart->lock);
+  free(uart->out.data);
+  free(uart->in.data);
+  free(uart);
+}
+
+ullong uart_load(uart_t uart, uint core, ulong offset)
+{
+  ullong value = 0;
+  bool polled = false;
+  pthread_mutex_lock(&uart->lock);
+  start_input(uart);
+  bool waiting = uart->reading && !uart->in_ended && ring_used(&uart->in) == 0;
+  switch (offset)
+  {
+  case UARTDR:
+    if (ring_used(&uart->in) > 0)
+    {
+      value = uart->in.data[uart->in.tail++ % uart->in.size];
+      pthread_cond_signal(&uart->in_space);
+    }
+    break;
+  case UARTFR:
+    if (ring_used(&uart->in) == 0)
+      value |= FR_RXFE;
+    if (ring_used(&uart->out) == uart->out.size)
+      value |= FR_TXFF;
+    value |= ring_used(&uart->out) == 0 ? FR_TXFE : FR_BUSY;
+    // Polled twice with no output pending: the core can only be waiting for input. A single
+    // load is not enough, as writing a byte checks TXFF first.
+    polled = waiting && ring_used(&uart->out) == 0;
+    waiting = polled && uart->polling[core];
+    break;
+  default:
+    waiting = false;
+  }
+  uart->polling[core] = polled;
+  // Under the lock, so that input read from now on wakes the core
+  if (waiting)
+    scheduler_wait(uart->waiting);
+  pthread_mutex_unlock(&uart->lock);
+  return value;
+}
+
+void uart_store(uart_t uart, uint core, ulong offset, ullong value)
+{
+  if (offset != UARTDR)
+    return;
+  pthread_mutex_lock(&uart->lock);
+  uart->polling[core] = false;
+  while (ring_used(&uart->out) == uart->out.size)
+  {
+    pthread_cond_signal(&uart->out_ready);
+    pthread_cond_wait(&uart->out_space, &uart->lock);
+  }
+  uart->out.data[uart->out.head++ % uart->out.size] = value & 0xff;
+  // Wakes the output thread to gather a batch for UART_DRAIN_MS, or to write a full half now
+  if (ring_used(&uart->out) == 1 || ring_used(&uart->out) == uart->out.size / 2)
+    pthread_cond_signal(&uart->out_ready);
+  pthread_mutex_unlock(&uart->lock);
+}
@@ -0,0 +1,42 @@
+#include <stdbool.h>
+#include "emulator.h"
+
+#ifndef UART_H
+#define UART_H
+
+// A PL011-style UART, mapped at a guest address past the end of memory, where loads and stores
+// would otherwise fail (see load_mem() and store_mem()), so that memory accesses cost nothing
+// more.
+//
+// Bytes the guest stores to UARTDR go into an output ring, and a host thread writes them out
+// straight from the ring, a write() per batch. The thread is woken by the first byte stored into
+// an empty ring, and writes what was stored UART_DRAIN_MS later, or as soon as the ring is half
+// full, so output a byte at a time makes no system call per byte. A store into a full ring waits
+// for the thread. From the first load of a register, another host thread reads input into an
+// input ring, which loads of UARTDR take bytes from; until then the input is left unread. UARTFR
+// reports TXFF, RXFE, TXFE and BUSY from the rings, the other registers read as 0 and ignore
+// writes, and there is no UART interrupt. The cores of a machine share its UART.
+//
+// A core run by a scheduler that waits for input, loading UARTDR from an empty input ring or
+// polling UARTFR while nothing is left to write, is parked until input arrives or ends (see
+// scheduler_wait()), so that it leaves its host thread to the other cores. The load still
+// returns, and the core finds the input when it loads again.
+
+#define UART_DEFAULT_BASE 0x09000000 // as on the QEMU virt board
+#define UART_SIZE 0x1000             // bytes of registers
+#define UART_DRAIN_MS 10
+
+// UART ADT
+typedef struct uart *uart_t;
+
+// Creates a UART writing to file descriptor `out_fd`, and reading `in_fd` unless it is -1.
+extern uart_t uart_init(int out_fd, int in_fd);
+// Writes the output left, stops the host threads and frees the UART.
+extern void uart_free(uart_t uart);
+// Waits until the output stored so far is written.
+extern void uart_flush(uart_t uart);
+// Returns the register at byte `offset`, for core number `core`.
+extern ullong uart_load(uart_t uart, uint core, ulong offset);
+// Writes the register at byte `offset`, for core number `core`.
+extern void uart_store(uart_t uart, uint core, ulong offset, ullong value);
+#endif